@@ -19,7 +19,22 @@
 #include <intrin.h>
 #endif
 
+#ifdef USE_ALLOCATION_TRACE
+#include "offsetAllocatorTrace.hpp"
+#define TRACE(...) do { if (m_trace) m_trace->push({__VA_ARGS__}); } while (0)
+#else
+#define TRACE(...)
+#endif
+
+#ifdef USE_ALLOCATOR_STATS
+#define STAT(...) do { __VA_ARGS__; } while (0)
+#else
+#define STAT(...)
+#endif
+
 #include <cstring>
+#include <new>
+#include <vector>
 
 namespace OffsetAllocator
 {
@@ -45,15 +60,43 @@ namespace OffsetAllocator
 #endif
     }
 
+    inline uint32 lzcnt_nonzero(uint64 v)
+    {
+#ifdef _MSC_VER
+        unsigned long retVal;
+        _BitScanReverse64(&retVal, v);
+        return 63 - retVal;
+#else
+        return __builtin_clzll(v);
+#endif
+    }
+
+    inline uint32 tzcnt_nonzero(uint64 v)
+    {
+#ifdef _MSC_VER
+        unsigned long retVal;
+        _BitScanForward64(&retVal, v);
+        return retVal;
+#else
+        return __builtin_ctzll(v);
+#endif
+    }
+
+    // Index of the highest set bit
+    template<typename T>
+    inline uint32 highestSetBit_nonzero(T v)
+    {
+        return sizeof(T) * 8 - 1 - lzcnt_nonzero(v);
+    }
+
     namespace SmallFloat
     {
-        static constexpr uint32 MANTISSA_BITS = 3;
         static constexpr uint32 MANTISSA_VALUE = 1 << MANTISSA_BITS;
         static constexpr uint32 MANTISSA_MASK = MANTISSA_VALUE - 1;
     
         // Bin sizes follow floating point (exponent + mantissa) distribution (piecewise linear log approx)
         // This ensures that for each size class, the average overhead percentage stays the same
-        uint32 uintToFloatRoundUp(uint32 size)
+        uint32 uintToFloatRoundUp(Offset size)
         {
             uint32 exp = 0;
             uint32 mantissa = 0;
@@ -66,14 +109,13 @@ namespace OffsetAllocator
             else
             {
                 // Normalized: Hidden high bit always 1. Not stored. Just like float.
-                uint32 leadingZeros = lzcnt_nonzero(size);
-                uint32 highestSetBit = 31 - leadingZeros;
+                uint32 highestSetBit = highestSetBit_nonzero(size);
                 
                 uint32 mantissaStartBit = highestSetBit - MANTISSA_BITS;
                 exp = mantissaStartBit + 1;
                 mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
                 
-                uint32 lowBitsMask = (1 << mantissaStartBit) - 1;
+                Offset lowBitsMask = ((Offset)1 << mantissaStartBit) - 1;
                 
                 // Round up!
                 if ((size & lowBitsMask) != 0)
@@ -83,7 +125,7 @@ namespace OffsetAllocator
             return (exp << MANTISSA_BITS) + mantissa; // + allows mantissa->exp overflow for round up
         }
 
-        uint32 uintToFloatRoundDown(uint32 size)
+        uint32 uintToFloatRoundDown(Offset size)
         {
             uint32 exp = 0;
             uint32 mantissa = 0;
@@ -96,8 +138,7 @@ namespace OffsetAllocator
             else
             {
                 // Normalized: Hidden high bit always 1. Not stored. Just like float.
-                uint32 leadingZeros = lzcnt_nonzero(size);
-                uint32 highestSetBit = 31 - leadingZeros;
+                uint32 highestSetBit = highestSetBit_nonzero(size);
                 
                 uint32 mantissaStartBit = highestSetBit - MANTISSA_BITS;
                 exp = mantissaStartBit + 1;
@@ -107,7 +148,7 @@ namespace OffsetAllocator
             return (exp << MANTISSA_BITS) | mantissa;
         }
     
-        uint32 floatToUint(uint32 floatValue)
+        Offset floatToUint(uint32 floatValue)
         {
             uint32 exponent = floatValue >> MANTISSA_BITS;
             uint32 mantissa = floatValue & MANTISSA_MASK;
@@ -118,35 +159,264 @@ namespace OffsetAllocator
             }
             else
             {
-                return (mantissa | MANTISSA_VALUE) << (exponent - 1);
+                return (Offset)(mantissa | MANTISSA_VALUE) << (exponent - 1);
             }
         }
     }
 
     // Utility functions
-    uint32 findLowestSetBitAfter(uint32 bitMask, uint32 startBitIndex)
+    static constexpr uint32 NO_BIN = 0xffffffff;
+
+    uint32 findLowestSetBitAfter(TopBinMask bitMask, uint32 startBitIndex)
     {
-        uint32 maskBeforeStartIndex = (1 << startBitIndex) - 1;
-        uint32 maskAfterStartIndex = ~maskBeforeStartIndex;
-        uint32 bitsAfter = bitMask & maskAfterStartIndex;
-        if (bitsAfter == 0) return Allocation::NO_SPACE;
+        TopBinMask maskBeforeStartIndex = ((TopBinMask)1 << startBitIndex) - 1;
+        TopBinMask maskAfterStartIndex = ~maskBeforeStartIndex;
+        TopBinMask bitsAfter = bitMask & maskAfterStartIndex;
+        if (bitsAfter == 0) return NO_BIN;
         return tzcnt_nonzero(bitsAfter);
     }
 
+    // Node metadata arrays are cache line aligned
+    static constexpr std::align_val_t NODE_ARRAY_ALIGNMENT = std::align_val_t(64);
+
+    template<typename T>
+    T* allocateNodeArray(uint32 count)
+    {
+        return (T*)::operator new[](sizeof(T) * count, NODE_ARRAY_ALIGNMENT);
+    }
+
+    void freeNodeArray(void* array)
+    {
+        if (array) ::operator delete[](array, NODE_ARRAY_ALIGNMENT);
+    }
+
+    inline uint32 clampMaxAllocs(uint32 maxAllocs)
+    {
+        return maxAllocs < Allocator::MIN_MAX_ALLOCS ? Allocator::MIN_MAX_ALLOCS : maxAllocs;
+    }
+
+    inline size_t alignNodeArraySize(size_t bytes)
+    {
+        return (bytes + (size_t)NODE_ARRAY_ALIGNMENT - 1) & ~((size_t)NODE_ARRAY_ALIGNMENT - 1);
+    }
+
     // Allocator...
-    Allocator::Allocator(uint32 size, uint32 maxAllocs) :
+    Allocator::Allocator(Offset size, uint32 maxAllocs) :
         m_size(size),
-        m_maxAllocs(maxAllocs),
+        m_maxAllocs(clampMaxAllocs(maxAllocs)),
         m_nodes(nullptr),
-        m_freeNodes(nullptr)
+        m_freeNodes(nullptr),
+        m_ownsMemory(true),
+        m_allocationPolicy(AllocationPolicy::BinHead)
+    {
+        if (sizeof(NodeIndex) == 2)
+        {
+            ASSERT(maxAllocs <= 65536);
+        }
+
+        m_nodes = allocateNodeArray<Node>(m_maxAllocs);
+        m_freeNodes = allocateNodeArray<NodeIndex>(m_maxAllocs);
+        reset();
+    }
+
+    Allocator::Allocator(Offset size, uint32 maxAllocs, void* memory) :
+        m_size(size),
+        m_maxAllocs(clampMaxAllocs(maxAllocs)),
+        m_ownsMemory(false),
+        m_allocationPolicy(AllocationPolicy::BinHead)
     {
         if (sizeof(NodeIndex) == 2)
         {
             ASSERT(maxAllocs <= 65536);
         }
+        assignNodeMemory(memory);
         reset();
     }
 
+    Allocator::Allocator() :
+        m_size(0),
+        m_maxAllocs(0),
+        m_freeStorage(0),
+        m_usedBinsTop(0),
+        m_nodes(nullptr),
+        m_freeNodes(nullptr),
+        m_freeOffset(0),
+        m_lazyFreeNodes(0),
+        m_ownsMemory(false),
+        m_allocationPolicy(AllocationPolicy::BinHead),
+        m_deferredFenceStart(0),
+        m_deferredFenceCount(0),
+        m_deferredHead(Node::unused),
+        m_deferredTail(Node::unused),
+        m_lastNode(Node::unused),
+        m_defragmentCursor(Node::unused)
+    {
+        for (uint32 i = 0 ; i < NUM_TOP_BINS; i++)
+            m_usedBins[i] = 0;
+        for (uint32 i = 0 ; i < NUM_LEAF_BINS; i++)
+        {
+            m_binIndices[i] = Node::unused;
+            m_binCounts[i] = 0;
+        }
+    }
+
+    void Allocator::assignNodeMemory(void* memory)
+    {
+        ASSERT(((size_t)memory & ((size_t)NODE_ARRAY_ALIGNMENT - 1)) == 0);
+
+        // Same layout as requiredMemorySize: [nodes][freelist], each array 64 byte aligned
+        uint8* ptr = (uint8*)memory;
+        m_nodes = (Node*)ptr;
+        ptr += alignNodeArraySize(sizeof(Node) * m_maxAllocs);
+        m_freeNodes = (NodeIndex*)ptr;
+    }
+
+    size_t Allocator::requiredMemorySize(uint32 maxAllocs)
+    {
+        maxAllocs = clampMaxAllocs(maxAllocs);
+        size_t size = alignNodeArraySize(sizeof(Node) * maxAllocs);
+        size += alignNodeArraySize(sizeof(NodeIndex) * maxAllocs);
+        return size;
+    }
+
+    // Snapshot blob: [SnapshotHeader, 64 byte aligned][node arrays in requiredMemorySize layout]
+    static constexpr uint32 SNAPSHOT_MAGIC = 0x4e53414f; // "OASN"
+    static constexpr uint32 SNAPSHOT_VERSION = 3;
+
+    // Compile time options that change the blob layout
+    static constexpr uint32 SNAPSHOT_CONFIG = sizeof(Offset) | (sizeof(NodeIndex) << 8) | (MANTISSA_BITS << 16);
+
+    struct SnapshotHeader
+    {
+        uint32 magic;
+        uint32 version;
+        uint32 config;
+        uint32 maxAllocs;
+        uint64 size;
+        uint64 freeStorage;
+        uint64 usedBinsTop;
+        uint32 freeOffset;
+        uint32 lazyFreeNodes;
+        uint32 allocationPolicy;
+        uint32 deferredFenceStart;
+        uint32 deferredFenceCount;
+        uint32 deferredHead;
+        uint32 deferredTail;
+        uint32 lastNode;
+        uint32 defragmentCursor;
+        Allocator::DeferredFence deferredFences[Allocator::MAX_DEFERRED_FENCES];
+        LeafBinMask usedBins[NUM_TOP_BINS];
+        NodeIndex binIndices[NUM_LEAF_BINS];
+        uint32 binCounts[NUM_LEAF_BINS];
+    };
+
+    size_t Allocator::snapshotSize() const
+    {
+        return alignNodeArraySize(sizeof(SnapshotHeader)) + requiredMemorySize(m_maxAllocs);
+    }
+
+    void Allocator::saveSnapshot(void* memory) const
+    {
+        ASSERT(((size_t)memory & ((size_t)NODE_ARRAY_ALIGNMENT - 1)) == 0);
+
+        SnapshotHeader& header = *(SnapshotHeader*)memory;
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.config = SNAPSHOT_CONFIG;
+        header.maxAllocs = m_maxAllocs;
+        header.size = m_size;
+        header.freeStorage = m_freeStorage;
+        header.usedBinsTop = m_usedBinsTop;
+        header.freeOffset = m_freeOffset;
+        header.lazyFreeNodes = m_lazyFreeNodes;
+        header.allocationPolicy = (uint32)m_allocationPolicy;
+        header.deferredFenceStart = m_deferredFenceStart;
+        header.deferredFenceCount = m_deferredFenceCount;
+        header.deferredHead = m_deferredHead;
+        header.deferredTail = m_deferredTail;
+        header.lastNode = m_lastNode;
+        header.defragmentCursor = m_defragmentCursor;
+        memcpy(header.deferredFences, m_deferredFences, sizeof(DeferredFence) * MAX_DEFERRED_FENCES);
+        memcpy(header.usedBins, m_usedBins, sizeof(LeafBinMask) * NUM_TOP_BINS);
+        memcpy(header.binIndices, m_binIndices, sizeof(NodeIndex) * NUM_LEAF_BINS);
+        memcpy(header.binCounts, m_binCounts, sizeof(uint32) * NUM_LEAF_BINS);
+
+        // Node arrays as is. Freelist entries below m_lazyFreeNodes were never written: Copied as garbage, never read.
+        uint8* ptr = (uint8*)memory + alignNodeArraySize(sizeof(SnapshotHeader));
+        memcpy(ptr, m_nodes, sizeof(Node) * m_maxAllocs);
+        ptr += alignNodeArraySize(sizeof(Node) * m_maxAllocs);
+        memcpy(ptr, m_freeNodes, sizeof(NodeIndex) * m_maxAllocs);
+    }
+
+    bool Allocator::isValidSnapshot(const void* memory, size_t size)
+    {
+        if (size < sizeof(SnapshotHeader)) return false;
+
+        const SnapshotHeader& header = *(const SnapshotHeader*)memory;
+        if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.config != SNAPSHOT_CONFIG) return false;
+        return size >= alignNodeArraySize(sizeof(SnapshotHeader)) + requiredMemorySize(header.maxAllocs);
+    }
+
+    bool Allocator::loadSnapshot(const void* memory, size_t size)
+    {
+        if (!m_nodes || !isValidSnapshot(memory, size)) return false;
+
+        const SnapshotHeader& header = *(const SnapshotHeader*)memory;
+        if (header.maxAllocs != m_maxAllocs) return false;
+
+        m_size = (Offset)header.size;
+        m_freeStorage = (Offset)header.freeStorage;
+        m_usedBinsTop = (TopBinMask)header.usedBinsTop;
+        m_freeOffset = header.freeOffset;
+        m_lazyFreeNodes = header.lazyFreeNodes;
+        m_allocationPolicy = (AllocationPolicy)header.allocationPolicy;
+        m_deferredFenceStart = header.deferredFenceStart;
+        m_deferredFenceCount = header.deferredFenceCount;
+        m_deferredHead = header.deferredHead;
+        m_deferredTail = header.deferredTail;
+        m_lastNode = header.lastNode;
+        m_defragmentCursor = header.defragmentCursor;
+        memcpy(m_deferredFences, header.deferredFences, sizeof(DeferredFence) * MAX_DEFERRED_FENCES);
+        memcpy(m_usedBins, header.usedBins, sizeof(LeafBinMask) * NUM_TOP_BINS);
+        memcpy(m_binIndices, header.binIndices, sizeof(NodeIndex) * NUM_LEAF_BINS);
+        memcpy(m_binCounts, header.binCounts, sizeof(uint32) * NUM_LEAF_BINS);
+
+        const uint8* ptr = (const uint8*)memory + alignNodeArraySize(sizeof(SnapshotHeader));
+        memcpy(m_nodes, ptr, sizeof(Node) * m_maxAllocs);
+        ptr += alignNodeArraySize(sizeof(Node) * m_maxAllocs);
+        memcpy(m_freeNodes, ptr, sizeof(NodeIndex) * m_maxAllocs);
+        return true;
+    }
+
+    Allocator Allocator::restoreSnapshotInPlace(void* memory, size_t size)
+    {
+        Allocator allocator;
+        if (!isValidSnapshot(memory, size)) return allocator;
+
+        // Header state is tiny: Copy it. Node arrays stay in the snapshot memory.
+        const SnapshotHeader& header = *(const SnapshotHeader*)memory;
+        allocator.m_size = (Offset)header.size;
+        allocator.m_maxAllocs = header.maxAllocs;
+        allocator.m_freeStorage = (Offset)header.freeStorage;
+        allocator.m_usedBinsTop = (TopBinMask)header.usedBinsTop;
+        allocator.m_freeOffset = header.freeOffset;
+        allocator.m_lazyFreeNodes = header.lazyFreeNodes;
+        allocator.m_allocationPolicy = (AllocationPolicy)header.allocationPolicy;
+        allocator.m_deferredFenceStart = header.deferredFenceStart;
+        allocator.m_deferredFenceCount = header.deferredFenceCount;
+        allocator.m_deferredHead = header.deferredHead;
+        allocator.m_deferredTail = header.deferredTail;
+        allocator.m_lastNode = header.lastNode;
+        allocator.m_defragmentCursor = header.defragmentCursor;
+        memcpy(allocator.m_deferredFences, header.deferredFences, sizeof(DeferredFence) * MAX_DEFERRED_FENCES);
+        memcpy(allocator.m_usedBins, header.usedBins, sizeof(LeafBinMask) * NUM_TOP_BINS);
+        memcpy(allocator.m_binIndices, header.binIndices, sizeof(NodeIndex) * NUM_LEAF_BINS);
+        memcpy(allocator.m_binCounts, header.binCounts, sizeof(uint32) * NUM_LEAF_BINS);
+
+        allocator.assignNodeMemory((uint8*)memory + alignNodeArraySize(sizeof(SnapshotHeader)));
+        return allocator;
+    }
+
     Allocator::Allocator(Allocator &&other) :
         m_size(other.m_size),
         m_maxAllocs(other.m_maxAllocs),
@@ -154,131 +424,333 @@ namespace OffsetAllocator
         m_usedBinsTop(other.m_usedBinsTop),
         m_nodes(other.m_nodes),
         m_freeNodes(other.m_freeNodes),
-        m_freeOffset(other.m_freeOffset)
+        m_freeOffset(other.m_freeOffset),
+        m_lazyFreeNodes(other.m_lazyFreeNodes),
+        m_ownsMemory(other.m_ownsMemory),
+        m_allocationPolicy(other.m_allocationPolicy),
+        m_deferredFenceStart(other.m_deferredFenceStart),
+        m_deferredFenceCount(other.m_deferredFenceCount),
+        m_deferredHead(other.m_deferredHead),
+        m_deferredTail(other.m_deferredTail),
+        m_lastNode(other.m_lastNode),
+        m_defragmentCursor(other.m_defragmentCursor)
     {
-        memcpy(m_usedBins, other.m_usedBins, sizeof(uint8) * NUM_TOP_BINS);
+        memcpy(m_usedBins, other.m_usedBins, sizeof(LeafBinMask) * NUM_TOP_BINS);
         memcpy(m_binIndices, other.m_binIndices, sizeof(NodeIndex) * NUM_LEAF_BINS);
+        memcpy(m_binCounts, other.m_binCounts, sizeof(uint32) * NUM_LEAF_BINS);
+        memcpy(m_deferredFences, other.m_deferredFences, sizeof(DeferredFence) * MAX_DEFERRED_FENCES);
+#ifdef USE_ALLOCATION_TRACE
+        m_trace = other.m_trace;
+        other.m_trace = nullptr;
+#endif
+#ifdef USE_ALLOCATOR_STATS
+        m_stats = other.m_stats;
+#endif
 
         other.m_nodes = nullptr;
         other.m_freeNodes = nullptr;
         other.m_freeOffset = 0;
+        other.m_lazyFreeNodes = 0;
         other.m_maxAllocs = 0;
         other.m_usedBinsTop = 0;
+        other.m_deferredFenceCount = 0;
+        other.m_deferredHead = Node::unused;
+        other.m_deferredTail = Node::unused;
+        other.m_lastNode = Node::unused;
+        other.m_defragmentCursor = Node::unused;
     }
 
     void Allocator::reset()
     {
+        TRACE(.op = TraceOp::Reset);
+
         m_freeStorage = 0;
         m_usedBinsTop = 0;
-        m_freeOffset = m_maxAllocs - 1;
+        m_freeOffset = m_maxAllocs != 0 ? m_maxAllocs - 1 : 0;
+
+        // Freelist is a stack. Nodes in inverse order so that [0] pops first.
+        // Entries are not written here: popFreeNode derives the initial value of untouched entries.
+        m_lazyFreeNodes = m_maxAllocs;
+
+        m_deferredFenceStart = 0;
+        m_deferredFenceCount = 0;
+        m_deferredHead = Node::unused;
+        m_deferredTail = Node::unused;
+        m_lastNode = Node::unused;
+        m_defragmentCursor = Node::unused;
 
         for (uint32 i = 0 ; i < NUM_TOP_BINS; i++)
             m_usedBins[i] = 0;
         
         for (uint32 i = 0 ; i < NUM_LEAF_BINS; i++)
+        {
             m_binIndices[i] = Node::unused;
+            m_binCounts[i] = 0;
+        }
         
-        if (m_nodes) delete[] m_nodes;
-        if (m_freeNodes) delete[] m_freeNodes;
-
-        m_nodes = new Node[m_maxAllocs];
-        m_freeNodes = new NodeIndex[m_maxAllocs];
-        
-        // Freelist is a stack. Nodes in inverse order so that [0] pops first.
-        for (uint32 i = 0; i < m_maxAllocs; i++)
+        // Moved-from / default constructed: No nodes, every allocate fails
+        ASSERT(m_maxAllocs >= MIN_MAX_ALLOCS || m_nodes == nullptr);
+        if (m_maxAllocs < MIN_MAX_ALLOCS)
         {
-            m_freeNodes[i] = m_maxAllocs - i - 1;
+            m_lazyFreeNodes = 0;
+            return;
         }
-        
+
         // Start state: Whole storage as one big node
         // Algorithm will split remainders and push them back as smaller nodes
-        insertNodeIntoBin(m_size, 0);
+        m_lastNode = insertNodeIntoBin(m_size, 0);
     }
 
     Allocator::~Allocator()
     {        
-        delete[] m_nodes;
-        delete[] m_freeNodes;
+        if (!m_ownsMemory) return;
+
+        freeNodeArray(m_nodes);
+        freeNodeArray(m_freeNodes);
     }
-    
-    Allocation Allocator::allocate(uint32 size)
+
+    inline uint32 Allocator::popFreeNode()
     {
-        // Out of allocations?
-        if (m_freeOffset == 0)
+        // Entries below m_lazyFreeNodes were never written after reset: they still hold the initial stack
+        // Pushes always write above the stack top, so the untouched entries are exactly [0, m_lazyFreeNodes)
+        uint32 nodeIndex;
+        if (m_freeOffset < m_lazyFreeNodes)
         {
-            return {.offset = Allocation::NO_SPACE, .metadata = Allocation::NO_SPACE};
+            nodeIndex = m_maxAllocs - m_freeOffset - 1;
+            m_lazyFreeNodes = m_freeOffset;
         }
-        
+        else
+        {
+            nodeIndex = m_freeNodes[m_freeOffset];
+        }
+        m_freeOffset--;
+        return nodeIndex;
+    }
+    
+    uint32 Allocator::findFreeBin(Offset size) const
+    {
         // Round up to bin index to ensure that alloc >= bin
         // Gives us min bin index that fits the size
-        uint32 minBinIndex = SmallFloat::uintToFloatRoundUp(size);
-        
+        return findFreeBinFrom(SmallFloat::uintToFloatRoundUp(size));
+    }
+
+    inline uint32 Allocator::roundUpBin(Offset size)
+    {
+#ifdef USE_BIN_CACHE
+        // Fibonacci hash: Sizes of one workload differ in the low bits, the multiply spreads them to the top bits
+        uint32 cacheIndex = ((uint32)size * 0x9E3779B1u) >> (32 - BIN_CACHE_BITS);
+        if (m_binCacheSizes[cacheIndex] == size)
+        {
+            STAT(m_stats.binCacheHits++);
+            return m_binCacheBins[cacheIndex];
+        }
+        uint32 binIndex = SmallFloat::uintToFloatRoundUp(size);
+        m_binCacheSizes[cacheIndex] = size;
+        m_binCacheBins[cacheIndex] = (uint16)binIndex;
+        return binIndex;
+#else
+        return SmallFloat::uintToFloatRoundUp(size);
+#endif
+    }
+
+    uint32 Allocator::findFreeBinFrom(uint32 minBinIndex) const
+    {
         uint32 minTopBinIndex = minBinIndex >> TOP_BINS_INDEX_SHIFT;
         uint32 minLeafBinIndex = minBinIndex & LEAF_BINS_INDEX_MASK;
         
         uint32 topBinIndex = minTopBinIndex;
-        uint32 leafBinIndex = Allocation::NO_SPACE;
+        uint32 leafBinIndex = NO_BIN;
 
-        // If top bin exists, scan its leaf bin. This can fail (NO_SPACE).
-        if (m_usedBinsTop & (1 << topBinIndex))
+        // If top bin exists, scan its leaf bin. This can fail (NO_BIN).
+        if (m_usedBinsTop & ((TopBinMask)1 << topBinIndex))
         {
             leafBinIndex = findLowestSetBitAfter(m_usedBins[topBinIndex], minLeafBinIndex);
         }
     
         // If we didn't find space in top bin, we search top bin from +1
-        if (leafBinIndex == Allocation::NO_SPACE)
+        if (leafBinIndex == NO_BIN)
         {
             topBinIndex = findLowestSetBitAfter(m_usedBinsTop, minTopBinIndex + 1);
             
             // Out of space?
-            if (topBinIndex == Allocation::NO_SPACE)
+            if (topBinIndex == NO_BIN)
             {
-                return {.offset = Allocation::NO_SPACE, .metadata = Allocation::NO_SPACE};
+                return NO_BIN;
             }
 
             // All leaf bins here fit the alloc, since the top bin was rounded up. Start leaf search from bit 0.
             // NOTE: This search can't fail since at least one leaf bit was set because the top bit was set.
-            leafBinIndex = tzcnt_nonzero(m_usedBins[topBinIndex]);
+            leafBinIndex = tzcnt_nonzero((uint32)m_usedBins[topBinIndex]);
         }
                 
-        uint32 binIndex = (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
-        
-        // Pop the top node of the bin. Bin top = node.next.
+        return (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
+    }
+
+    uint32 Allocator::scanBin(uint32 binIndex, Offset minSize) const
+    {
+        // Bounded scan of the bin list: Tightest fit (BestFit) or lowest offset (LowestAddress)
+        uint32 bestNodeIndex = Node::unused;
+        Offset bestValue = ~(Offset)0;
         uint32 nodeIndex = m_binIndices[binIndex];
+        for (uint32 i = 0; i < POLICY_SCAN_LIMIT && nodeIndex != Node::unused; i++)
+        {
+            const Node& node = m_nodes[nodeIndex];
+            if (node.dataSize >= minSize)
+            {
+                Offset value = m_allocationPolicy == AllocationPolicy::BestFit ? (Offset)node.dataSize : node.dataOffset;
+                if (value < bestValue)
+                {
+                    bestValue = value;
+                    bestNodeIndex = nodeIndex;
+
+                    // Exact fit: Can't do better
+                    if (node.dataSize == minSize && m_allocationPolicy == AllocationPolicy::BestFit) break;
+                }
+            }
+            nodeIndex = m_nodes[nodeIndex].binListNext;
+        }
+        return bestNodeIndex;
+    }
+
+    void Allocator::setAllocationPolicy(AllocationPolicy policy)
+    {
+        TRACE(.op = TraceOp::SetPolicy, .arg = (uint16)policy);
+        m_allocationPolicy = policy;
+    }
+
+#ifdef USE_ALLOCATION_TRACE
+    void Allocator::setTrace(TraceRing* trace)
+    {
+        m_trace = trace;
+        TRACE(.op = TraceOp::Begin, .arg = (uint16)m_allocationPolicy, .metadata = m_maxAllocs, .size = m_size);
+    }
+#endif
+
+#ifdef USE_ALLOCATOR_STATS
+    void Allocator::resetStats()
+    {
+        m_stats = {};
+    }
+#endif
+
+    Allocation Allocator::allocate(Offset size)
+    {
+        Allocation allocation = allocateFromBin(size);
+        TRACE(.op = TraceOp::Allocate, .metadata = allocation.metadata, .offset = allocation.offset, .size = size);
+        STAT(if (allocation.offset == Allocation::NO_SPACE) m_stats.failedAllocations++);
+        return allocation;
+    }
+
+    Allocation Allocator::allocate(Offset size, Offset alignment)
+    {
+        Allocation allocation = allocateAligned(size, alignment);
+        TRACE(.op = TraceOp::Allocate, .arg = (uint16)(tzcnt_nonzero(alignment) + 1), .metadata = allocation.metadata, .offset = allocation.offset, .size = size);
+        STAT(if (allocation.offset == Allocation::NO_SPACE) m_stats.failedAllocations++);
+        return allocation;
+    }
+
+    Allocation Allocator::allocateHigh(Offset size)
+    {
+        Allocation allocation = allocateFromTail(size);
+        TRACE(.op = TraceOp::AllocateHigh, .metadata = allocation.metadata, .offset = allocation.offset, .size = size);
+        STAT(if (allocation.offset == Allocation::NO_SPACE) m_stats.failedAllocations++);
+        return allocation;
+    }
+
+    Allocation Allocator::allocateFromBin(Offset size)
+    {
+        // Out of allocations?
+        if (m_freeOffset == 0)
+        {
+            return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+        }
+        
+        uint32 minBin = roundUpBin(size);
+#ifdef USE_BIN_CACHE
+        // Fast path: The size's own bin is non-empty. Same result as the full search (lowest bin >= min bin).
+        uint32 binIndex = minBin < NUM_LEAF_BINS && ((m_usedBins[minBin >> TOP_BINS_INDEX_SHIFT] >> (minBin & LEAF_BINS_INDEX_MASK)) & 1) ?
+            minBin : findFreeBinFrom(minBin);
+#else
+        uint32 binIndex = findFreeBinFrom(minBin);
+#endif
+        STAT(if (binIndex == minBin) m_stats.minBinHits++);
+        uint32 nodeIndex = Node::unused;
+
+        if (m_allocationPolicy == AllocationPolicy::BestFit)
+        {
+            // Exact fit bin: Nodes in the bin the size rounds down to can still be large enough
+            uint32 exactBinIndex = SmallFloat::uintToFloatRoundDown(size);
+            if (exactBinIndex != binIndex && m_binIndices[exactBinIndex] != Node::unused)
+            {
+                nodeIndex = scanBin(exactBinIndex, size);
+                if (nodeIndex != Node::unused) binIndex = exactBinIndex;
+            }
+        }
+        
+        // Out of space?
+        if (binIndex == NO_BIN)
+        {
+            return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+        }
+
+        // Every node in the bin fits: Pop the top node (head) unless the policy scans for a better one
+        if (nodeIndex == Node::unused)
+        {
+            nodeIndex = m_allocationPolicy == AllocationPolicy::BinHead ? m_binIndices[binIndex] : scanBin(binIndex, size);
+        }
+
+        uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
+        uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
+        STAT(m_stats.allocations++, m_stats.binAllocations[binIndex]++);
+        STAT(if (topBinIndex > (minBin >> TOP_BINS_INDEX_SHIFT)) m_stats.topBinFallbacks++);
+        
+        // Remove the node from the bin. Bin top = node.next.
         Node& node = m_nodes[nodeIndex];
-        uint32 nodeTotalSize = node.dataSize;
+        Offset nodeTotalSize = node.dataSize;
         node.dataSize = size;
         node.used = true;
-        m_binIndices[binIndex] = node.binListNext;
-        if (node.binListNext != Node::unused) m_nodes[node.binListNext].binListPrev = Node::unused;
+        if (node.binListPrev != Node::unused)
+        {
+            // Scanned node from the middle of the list. Bin stays non-empty.
+            m_nodes[node.binListPrev].binListNext = node.binListNext;
+            if (node.binListNext != Node::unused) m_nodes[node.binListNext].binListPrev = node.binListPrev;
+        }
+        else
+        {
+            m_binIndices[binIndex] = node.binListNext;
+            if (node.binListNext != Node::unused) m_nodes[node.binListNext].binListPrev = Node::unused;
+        }
+        m_binCounts[binIndex]--;
         m_freeStorage -= nodeTotalSize;
 #ifdef DEBUG_VERBOSE
-        printf("Free storage: %u (-%u) (allocate)\n", m_freeStorage, nodeTotalSize);
+        printf("Free storage: %llu (-%llu) (allocate)\n", (uint64)m_freeStorage, (uint64)nodeTotalSize);
 #endif
 
         // Bin empty?
         if (m_binIndices[binIndex] == Node::unused)
         {
             // Remove a leaf bin mask bit
-            m_usedBins[topBinIndex] &= ~(1 << leafBinIndex);
+            m_usedBins[topBinIndex] &= ~((LeafBinMask)1 << leafBinIndex);
             
             // All leaf bins empty?
             if (m_usedBins[topBinIndex] == 0)
             {
                 // Remove a top bin mask bit
-                m_usedBinsTop &= ~(1 << topBinIndex);
+                m_usedBinsTop &= ~((TopBinMask)1 << topBinIndex);
             }
         }
         
         // Push back reminder N elements to a lower bin
-        uint32 reminderSize = nodeTotalSize - size;
+        Offset reminderSize = nodeTotalSize - size;
         if (reminderSize > 0)
         {
+            STAT(m_stats.splits++);
             uint32 newNodeIndex = insertNodeIntoBin(reminderSize, node.dataOffset + size);
             
             // Link nodes next to each other so that we can merge them later if both are free
             // And update the old next neighbor to point to the new node (in middle)
             if (node.neighborNext != Node::unused) m_nodes[node.neighborNext].neighborPrev = newNodeIndex;
+            else m_lastNode = newNodeIndex;
             m_nodes[newNodeIndex].neighborPrev = nodeIndex;
             m_nodes[newNodeIndex].neighborNext = node.neighborNext;
             node.neighborNext = newNodeIndex;
@@ -286,21 +758,192 @@ namespace OffsetAllocator
         
         return {.offset = node.dataOffset, .metadata = nodeIndex};
     }
+
+    Allocation Allocator::allocateAligned(Offset size, Offset alignment)
+    {
+        ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        if (alignment <= 1) return allocateFromBin(size);
+
+        // Out of allocations? Worst case needs two new nodes: padding + remainder
+        if (m_freeOffset < 2)
+        {
+            return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+        }
+
+        Offset alignmentMask = alignment - 1;
+
+        // First try the smallest bin that fits the size. Its top node might have enough room for the padding too.
+        uint32 binIndex = findFreeBin(size);
+        if (binIndex == NO_BIN)
+        {
+            return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+        }
+
+        uint32 nodeIndex = m_binIndices[binIndex];
+        Offset nodeOffset = m_nodes[nodeIndex].dataOffset;
+        Offset nodeTotalSize = m_nodes[nodeIndex].dataSize;
+        Offset alignedOffset = (nodeOffset + alignmentMask) & ~alignmentMask;
+        
+        if (alignedOffset - nodeOffset > nodeTotalSize - size)
+        {
+            // Didn't fit. Any node in the bin of (size + alignment - 1) fits regardless of its offset.
+            if (size > Allocation::NO_SPACE - alignmentMask)
+            {
+                return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+            }
+
+            binIndex = findFreeBin(size + alignmentMask);
+            if (binIndex == NO_BIN)
+            {
+                return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+            }
+
+            nodeIndex = m_binIndices[binIndex];
+            nodeOffset = m_nodes[nodeIndex].dataOffset;
+            nodeTotalSize = m_nodes[nodeIndex].dataSize;
+            alignedOffset = (nodeOffset + alignmentMask) & ~alignmentMask;
+        }
+
+        Offset paddingSize = alignedOffset - nodeOffset;
+        Offset reminderSize = nodeTotalSize - paddingSize - size;
+        STAT(m_stats.allocations++, m_stats.binAllocations[binIndex]++);
+        STAT(if ((binIndex >> TOP_BINS_INDEX_SHIFT) > (SmallFloat::uintToFloatRoundUp(size) >> TOP_BINS_INDEX_SHIFT)) m_stats.topBinFallbacks++);
+        uint32 neighborPrev = m_nodes[nodeIndex].neighborPrev;
+        uint32 neighborNext = m_nodes[nodeIndex].neighborNext;
+
+        // Take the whole free node out. Split into: [padding (free)] [allocation (used)] [reminder (free)]
+        removeNodeFromBin(nodeIndex);
+
+        // Leading padding goes back to a bin as its own free node. Merges back on free.
+        if (paddingSize > 0)
+        {
+            STAT(m_stats.splits++);
+            uint32 paddingNodeIndex = insertNodeIntoBin(paddingSize, nodeOffset);
+            if (neighborPrev != Node::unused) m_nodes[neighborPrev].neighborNext = paddingNodeIndex;
+            m_nodes[paddingNodeIndex].neighborPrev = neighborPrev;
+            neighborPrev = paddingNodeIndex;
+        }
+
+        uint32 usedNodeIndex = popFreeNode();
+#ifdef DEBUG_VERBOSE
+        printf("Getting node %u from freelist[%u] (allocate aligned)\n", usedNodeIndex, m_freeOffset + 1);
+#endif
+        m_nodes[usedNodeIndex] = {.dataOffset = alignedOffset, .dataSize = size, .neighborPrev = (NodeIndex)neighborPrev, .neighborNext = (NodeIndex)neighborNext,
+            .used = true, .alignmentLog2 = (uint8)tzcnt_nonzero(alignment)};
+        if (neighborPrev != Node::unused) m_nodes[neighborPrev].neighborNext = usedNodeIndex;
+        if (neighborNext != Node::unused) m_nodes[neighborNext].neighborPrev = usedNodeIndex;
+        else m_lastNode = usedNodeIndex;
+
+        // Push back reminder N elements to a lower bin
+        if (reminderSize > 0)
+        {
+            STAT(m_stats.splits++);
+            uint32 newNodeIndex = insertNodeIntoBin(reminderSize, alignedOffset + size);
+            
+            // Link nodes next to each other so that we can merge them later if both are free
+            if (neighborNext != Node::unused) m_nodes[neighborNext].neighborPrev = newNodeIndex;
+            else m_lastNode = newNodeIndex;
+            m_nodes[newNodeIndex].neighborPrev = usedNodeIndex;
+            m_nodes[newNodeIndex].neighborNext = neighborNext;
+            m_nodes[usedNodeIndex].neighborNext = newNodeIndex;
+        }
+
+        return {.offset = alignedOffset, .metadata = (NodeIndex)usedNodeIndex};
+    }
+
+    Allocation Allocator::allocateFromTail(Offset size)
+    {
+        // Out of allocations? (The node taken out of the bin goes back to the freelist first)
+        if (m_freeOffset == 0 || m_usedBinsTop == 0)
+        {
+            return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+        }
+
+        // Highest free node that fits among the last POLICY_SCAN_LIMIT nodes (walk back from the end of the storage)
+        uint32 nodeIndex = Node::unused;
+        for (uint32 i = 0, scanIndex = m_lastNode; i < POLICY_SCAN_LIMIT && scanIndex != Node::unused; i++)
+        {
+            if (m_nodes[scanIndex].used == false && m_nodes[scanIndex].dataSize >= size)
+            {
+                nodeIndex = scanIndex;
+                break;
+            }
+            scanIndex = m_nodes[scanIndex].neighborPrev;
+        }
+
+        uint32 binIndex;
+        if (nodeIndex != Node::unused)
+        {
+            binIndex = SmallFloat::uintToFloatRoundDown(m_nodes[nodeIndex].dataSize);
+        }
+        else
+        {
+            // Fallback: Highest used bin. Every node in it fits if the bin is at least the rounded up size.
+            uint32 topBinIndex = sizeof(TopBinMask) * 8 - 1 - lzcnt_nonzero(m_usedBinsTop);
+            uint32 leafBinIndex = 31 - lzcnt_nonzero((uint32)m_usedBins[topBinIndex]);
+            binIndex = (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
+            if (binIndex < SmallFloat::uintToFloatRoundUp(size))
+            {
+                return {.offset = Allocation::NO_SPACE, .metadata = Node::unused};
+            }
+
+            // Highest offset among the first POLICY_SCAN_LIMIT nodes of the bin
+            nodeIndex = m_binIndices[binIndex];
+            for (uint32 i = 1, scanIndex = m_nodes[nodeIndex].binListNext; i < POLICY_SCAN_LIMIT && scanIndex != Node::unused; i++)
+            {
+                if (m_nodes[scanIndex].dataOffset > m_nodes[nodeIndex].dataOffset) nodeIndex = scanIndex;
+                scanIndex = m_nodes[scanIndex].binListNext;
+            }
+        }
+
+        Offset nodeOffset = m_nodes[nodeIndex].dataOffset;
+        Offset headSize = m_nodes[nodeIndex].dataSize - size;
+        Offset tailOffset = nodeOffset + headSize;
+        STAT(m_stats.allocations++, m_stats.binAllocations[binIndex]++);
+        uint32 neighborPrev = m_nodes[nodeIndex].neighborPrev;
+        uint32 neighborNext = m_nodes[nodeIndex].neighborNext;
+
+        // Take the whole free node out. Split into: [head (free)] [allocation (used)]
+        removeNodeFromBin(nodeIndex);
+
+        if (headSize > 0)
+        {
+            STAT(m_stats.splits++);
+            uint32 headNodeIndex = insertNodeIntoBin(headSize, nodeOffset);
+            if (neighborPrev != Node::unused) m_nodes[neighborPrev].neighborNext = headNodeIndex;
+            m_nodes[headNodeIndex].neighborPrev = neighborPrev;
+            neighborPrev = headNodeIndex;
+        }
+
+        uint32 usedNodeIndex = popFreeNode();
+#ifdef DEBUG_VERBOSE
+        printf("Getting node %u from freelist[%u] (allocate high)\n", usedNodeIndex, m_freeOffset + 1);
+#endif
+        m_nodes[usedNodeIndex] = {.dataOffset = tailOffset, .dataSize = size, .neighborPrev = (NodeIndex)neighborPrev, .neighborNext = (NodeIndex)neighborNext, .used = true};
+        if (neighborPrev != Node::unused) m_nodes[neighborPrev].neighborNext = usedNodeIndex;
+        if (neighborNext != Node::unused) m_nodes[neighborNext].neighborPrev = usedNodeIndex;
+        else m_lastNode = usedNodeIndex;
+
+        return {.offset = tailOffset, .metadata = (NodeIndex)usedNodeIndex};
+    }
     
     void Allocator::free(Allocation allocation)
     {
-        ASSERT(allocation.metadata != Allocation::NO_SPACE);
+        ASSERT(allocation.metadata != Node::unused);
         if (!m_nodes) return;
+        TRACE(.op = TraceOp::Free, .metadata = allocation.metadata, .offset = allocation.offset);
+        STAT(m_stats.frees++);
         
         uint32 nodeIndex = allocation.metadata;
         Node& node = m_nodes[nodeIndex];
         
-        // Double delete check
+        // Double delete check (also: already deferred)
         ASSERT(node.used == true);
+        ASSERT(node.binListPrev != nodeIndex);
         
         // Merge with neighbors...
-        uint32 offset = node.dataOffset;
-        uint32 size = node.dataSize;
+        Offset offset = node.dataOffset;
+        Offset size = node.dataSize;
         
         if ((node.neighborPrev != Node::unused) && (m_nodes[node.neighborPrev].used == false))
         {
@@ -311,6 +954,7 @@ namespace OffsetAllocator
             
             // Remove node from the bin linked list and put it in the freelist
             removeNodeFromBin(node.neighborPrev);
+            STAT(m_stats.merges++);
             
             ASSERT(prevNode.neighborNext == nodeIndex);
             node.neighborPrev = prevNode.neighborPrev;
@@ -324,6 +968,7 @@ namespace OffsetAllocator
             
             // Remove node from the bin linked list and put it in the freelist
             removeNodeFromBin(node.neighborNext);
+            STAT(m_stats.merges++);
             
             ASSERT(nextNode.neighborPrev == nodeIndex);
             node.neighborNext = nextNode.neighborNext;
@@ -337,6 +982,7 @@ namespace OffsetAllocator
         printf("Putting node %u into freelist[%u] (free)\n", nodeIndex, m_freeOffset + 1);
 #endif
         m_freeNodes[++m_freeOffset] = nodeIndex;
+        if (m_defragmentCursor == nodeIndex) m_defragmentCursor = Node::unused;
 
         // Insert the (combined) free node to bin
         uint32 combinedNodeIndex = insertNodeIntoBin(size, offset);
@@ -347,6 +993,10 @@ namespace OffsetAllocator
             m_nodes[combinedNodeIndex].neighborNext = neighborNext;
             m_nodes[neighborNext].neighborPrev = combinedNodeIndex;
         }
+        else
+        {
+            m_lastNode = combinedNodeIndex;
+        }
         if (neighborPrev != Node::unused)
         {
             m_nodes[combinedNodeIndex].neighborPrev = neighborPrev;
@@ -354,7 +1004,418 @@ namespace OffsetAllocator
         }
     }
 
-    uint32 Allocator::insertNodeIntoBin(uint32 size, uint32 dataOffset)
+    bool Allocator::tryGrow(Allocation allocation, Offset newSize)
+    {
+        ASSERT(allocation.metadata != Node::unused);
+        if (!m_nodes) return false;
+
+        uint32 nodeIndex = allocation.metadata;
+        Node& node = m_nodes[nodeIndex];
+        ASSERT(node.used == true);
+        ASSERT(node.binListPrev != nodeIndex);
+
+        bool grown = newSize <= node.dataSize;
+        uint32 nextIndex = node.neighborNext;
+        if (!grown && nextIndex != Node::unused && m_nodes[nextIndex].used == false &&
+            m_nodes[nextIndex].dataSize >= newSize - node.dataSize)
+        {
+            // Take the next free node out, the rest of it goes back to a bin as a new free node
+            Offset restSize = m_nodes[nextIndex].dataSize - (newSize - node.dataSize);
+            uint32 neighborNext = m_nodes[nextIndex].neighborNext;
+            removeNodeFromBin(nextIndex);
+            node.dataSize = newSize;
+            node.neighborNext = neighborNext;
+            if (neighborNext != Node::unused) m_nodes[neighborNext].neighborPrev = nodeIndex;
+            else m_lastNode = nodeIndex;
+
+            if (restSize > 0)
+            {
+                STAT(m_stats.splits++);
+                uint32 restNodeIndex = insertNodeIntoBin(restSize, node.dataOffset + newSize);
+                if (neighborNext != Node::unused) m_nodes[neighborNext].neighborPrev = restNodeIndex;
+                else m_lastNode = restNodeIndex;
+                m_nodes[restNodeIndex].neighborPrev = nodeIndex;
+                m_nodes[restNodeIndex].neighborNext = neighborNext;
+                node.neighborNext = restNodeIndex;
+            }
+            grown = true;
+        }
+
+        TRACE(.op = TraceOp::Grow, .arg = (uint16)grown, .metadata = allocation.metadata, .offset = allocation.offset, .size = newSize);
+        return grown;
+    }
+
+    bool Allocator::shrink(Allocation allocation, Offset newSize)
+    {
+        ASSERT(allocation.metadata != Node::unused);
+        if (!m_nodes) return false;
+
+        uint32 nodeIndex = allocation.metadata;
+        Node& node = m_nodes[nodeIndex];
+        ASSERT(node.used == true);
+        ASSERT(node.binListPrev != nodeIndex);
+
+        bool shrunk = newSize >= node.dataSize;
+        uint32 nextIndex = node.neighborNext;
+        bool nextFree = nextIndex != Node::unused && m_nodes[nextIndex].used == false;
+        if (!shrunk && (nextFree || m_freeOffset > 0))
+        {
+            // Freed tail, merged with the next free node
+            Offset tailSize = node.dataSize - newSize;
+            uint32 neighborNext = nextIndex;
+            if (nextFree)
+            {
+                tailSize += m_nodes[nextIndex].dataSize;
+                neighborNext = m_nodes[nextIndex].neighborNext;
+                removeNodeFromBin(nextIndex);
+                STAT(m_stats.merges++);
+            }
+            else
+            {
+                STAT(m_stats.splits++);
+            }
+            node.dataSize = newSize;
+
+            uint32 tailNodeIndex = insertNodeIntoBin(tailSize, node.dataOffset + newSize);
+            if (neighborNext != Node::unused) m_nodes[neighborNext].neighborPrev = tailNodeIndex;
+            else m_lastNode = tailNodeIndex;
+            m_nodes[tailNodeIndex].neighborPrev = nodeIndex;
+            m_nodes[tailNodeIndex].neighborNext = neighborNext;
+            node.neighborNext = tailNodeIndex;
+            shrunk = true;
+        }
+
+        TRACE(.op = TraceOp::Shrink, .arg = (uint16)shrunk, .metadata = allocation.metadata, .offset = allocation.offset, .size = newSize);
+        return shrunk;
+    }
+
+    bool Allocator::growStorage(Offset additionalSize)
+    {
+        if (!m_nodes) return false;
+
+        Offset newSize = m_size + additionalSize;
+        bool grown = newSize >= m_size;
+        if (grown && additionalSize > 0)
+        {
+            uint32 lastIndex = m_lastNode;
+            ASSERT(lastIndex != Node::unused);
+
+            if (m_nodes[lastIndex].used == false)
+            {
+                // Free last node: Reinsert it with the new storage appended (bin changes with the size)
+                Offset dataOffset = m_nodes[lastIndex].dataOffset;
+                Offset dataSize = m_nodes[lastIndex].dataSize + additionalSize;
+                uint32 neighborPrev = m_nodes[lastIndex].neighborPrev;
+                removeNodeFromBin(lastIndex);
+
+                uint32 nodeIndex = insertNodeIntoBin(dataSize, dataOffset);
+                m_nodes[nodeIndex].neighborPrev = neighborPrev;
+                if (neighborPrev != Node::unused) m_nodes[neighborPrev].neighborNext = nodeIndex;
+                m_lastNode = nodeIndex;
+                STAT(m_stats.merges++);
+            }
+            else if (m_freeOffset > 0)
+            {
+                // Used (or deferred) last node: The new storage is a new free node after it
+                uint32 nodeIndex = insertNodeIntoBin(additionalSize, m_size);
+                m_nodes[nodeIndex].neighborPrev = lastIndex;
+                m_nodes[lastIndex].neighborNext = nodeIndex;
+                m_lastNode = nodeIndex;
+            }
+            else
+            {
+                grown = false;
+            }
+        }
+        if (grown) m_size = newSize;
+
+        TRACE(.op = TraceOp::GrowStorage, .arg = (uint16)grown, .size = additionalSize);
+        return grown;
+    }
+
+    bool Allocator::growNodes(uint32 newMaxAllocs)
+    {
+        if (!m_nodes) return false;
+
+        bool grown = newMaxAllocs <= m_maxAllocs || (m_ownsMemory && (sizeof(NodeIndex) != 2 || newMaxAllocs <= 65536));
+        if (grown && newMaxAllocs > m_maxAllocs)
+        {
+            // Node indices don't change: Copy the old arrays as is. Nodes on the implicit part of the freelist
+            // [unpopped, m_maxAllocs) were never written: Not copied.
+            uint32 lazyFreeNodes = m_lazyFreeNodes > 0 ? m_lazyFreeNodes : 1;
+            uint32 unpopped = m_maxAllocs - lazyFreeNodes;
+            Node* nodes = allocateNodeArray<Node>(newMaxAllocs);
+            memcpy(nodes, m_nodes, sizeof(Node) * unpopped);
+            freeNodeArray(m_nodes);
+            m_nodes = nodes;
+
+            // New nodes [m_maxAllocs - 1, newMaxAllocs - 1) go to the bottom of the stack (popped last).
+            // The implicit entry formula at newMaxAllocs gives exactly them below the old implicit entries,
+            // which keep their values one stack slot per new node higher. Only written entries are copied.
+            uint32 addedNodes = newMaxAllocs - m_maxAllocs;
+            NodeIndex* freeNodes = allocateNodeArray<NodeIndex>(newMaxAllocs);
+            for (uint32 i = lazyFreeNodes; i <= m_freeOffset; i++)
+                freeNodes[i + addedNodes] = m_freeNodes[i];
+            freeNodeArray(m_freeNodes);
+            m_freeNodes = freeNodes;
+
+            m_freeOffset += addedNodes;
+            m_lazyFreeNodes = lazyFreeNodes + addedNodes;
+            m_maxAllocs = newMaxAllocs;
+        }
+
+        TRACE(.op = TraceOp::GrowNodes, .arg = (uint16)grown, .size = newMaxAllocs);
+        return grown;
+    }
+
+    bool Allocator::allocateBatch(std::span<const Offset> sizes, Allocation* out)
+    {
+        uint32 count = (uint32)sizes.size();
+        if (count == 0) return true;
+
+        // Sum can't overflow: Stop when it exceeds the storage size
+        Offset totalSize = 0;
+        bool fitsStorage = true;
+        for (uint32 i = 0; i < count && fitsStorage; i++)
+        {
+            fitsStorage = sizes[i] <= m_size - totalSize;
+            totalSize += sizes[i];
+        }
+
+        // Fast path: Allocate the whole batch as one range, then split it into nodes without touching the bins again.
+        // Needs count-1 extra nodes for the items + allocateFromBin() takes one for the remainder.
+        bool success = false;
+        if (fitsStorage && m_freeOffset >= count)
+        {
+            Allocation first = allocateFromBin(totalSize);
+            if (first.offset != Allocation::NO_SPACE)
+            {
+                uint32 prevIndex = first.metadata;
+                Offset offset = first.offset + sizes[0];
+                m_nodes[prevIndex].dataSize = sizes[0];
+                out[0] = first;
+
+                for (uint32 i = 1; i < count; i++)
+                {
+                    // Link the new used node between the previous item and the remainder (or old next neighbor)
+                    uint32 nodeIndex = popFreeNode();
+#ifdef DEBUG_VERBOSE
+                    printf("Getting node %u from freelist[%u] (allocateBatch)\n", nodeIndex, m_freeOffset + 1);
+#endif
+                    Node& prevNode = m_nodes[prevIndex];
+                    m_nodes[nodeIndex] = {.dataOffset = offset, .dataSize = sizes[i], .neighborPrev = (NodeIndex)prevIndex, .neighborNext = prevNode.neighborNext, .used = true};
+                    if (prevNode.neighborNext != Node::unused) m_nodes[prevNode.neighborNext].neighborPrev = nodeIndex;
+                    else m_lastNode = nodeIndex;
+                    prevNode.neighborNext = nodeIndex;
+
+                    out[i] = {.offset = offset, .metadata = (NodeIndex)nodeIndex};
+                    offset += sizes[i];
+                    prevIndex = nodeIndex;
+                }
+                STAT(m_stats.allocations += count - 1);
+                success = true;
+            }
+        }
+
+        // Slow path: No single free node fits the whole batch
+        if (!success)
+        {
+            success = true;
+            for (uint32 i = 0; i < count; i++)
+            {
+                out[i] = allocateFromBin(sizes[i]);
+                if (out[i].offset == Allocation::NO_SPACE) success = false;
+            }
+        }
+
+        STAT(for (uint32 i = 0; i < count; i++) if (out[i].offset == Allocation::NO_SPACE) m_stats.failedAllocations++);
+        TRACE(.op = TraceOp::AllocateBatch, .metadata = count);
+        for (uint32 i = 0; i < count; i++)
+            TRACE(.op = TraceOp::Allocate, .metadata = out[i].metadata, .offset = out[i].offset, .size = sizes[i]);
+        return success;
+    }
+
+    void Allocator::freeBatch(std::span<const Allocation> allocations)
+    {
+        if (!m_nodes) return;
+
+#ifdef USE_ALLOCATION_TRACE
+        TRACE(.op = TraceOp::FreeBatch, .metadata = (uint32)allocations.size());
+        for (const Allocation& allocation : allocations)
+            TRACE(.op = TraceOp::Free, .metadata = allocation.metadata, .offset = allocation.offset);
+#endif
+
+        // Mark all nodes free first. Pending nodes (freed, but not yet in a bin) have binListPrev pointing to themselves.
+        // A node inside a bin list can never be its own predecessor, so this doesn't collide with the bin lists.
+        for (const Allocation& allocation : allocations)
+        {
+            if (allocation.offset == Allocation::NO_SPACE) continue;
+
+            Node& node = m_nodes[allocation.metadata];
+
+            // Double delete check
+            ASSERT(node.used == true);
+            node.used = false;
+            m_nodes[allocation.metadata].binListPrev = allocation.metadata;
+            STAT(m_stats.frees++);
+        }
+
+        for (const Allocation& allocation : allocations)
+        {
+            if (allocation.offset == Allocation::NO_SPACE) continue;
+
+            // Already consumed by a run found from an earlier item?
+            if (m_nodes[allocation.metadata].binListPrev != allocation.metadata) continue;
+
+            freePendingRun(allocation.metadata);
+        }
+    }
+
+    void Allocator::freePendingRun(uint32 nodeIndex)
+    {
+        // Find the start of the free run. Contains pending nodes and at most one binned free node per gap.
+        uint32 startIndex = nodeIndex;
+        while (m_nodes[startIndex].neighborPrev != Node::unused && m_nodes[m_nodes[startIndex].neighborPrev].used == false)
+            startIndex = m_nodes[startIndex].neighborPrev;
+
+        Offset offset = m_nodes[startIndex].dataOffset;
+        Offset size = 0;
+        uint32 neighborPrev = m_nodes[startIndex].neighborPrev;
+
+        // Sweep the whole run once. Binned nodes leave their bins, other pending nodes go straight to the freelist.
+        uint32 i = startIndex;
+        while (i != Node::unused && m_nodes[i].used == false)
+        {
+            Node& node = m_nodes[i];
+            uint32 neighborNext = node.neighborNext;
+            size += node.dataSize;
+            STAT(if (i != startIndex) m_stats.merges++);
+
+            if (node.binListPrev == i)
+            {
+                node.binListPrev = Node::unused;
+                if (i != nodeIndex)
+                {
+#ifdef DEBUG_VERBOSE
+                    printf("Putting node %u into freelist[%u] (freePendingRun)\n", i, m_freeOffset + 1);
+#endif
+                    m_freeNodes[++m_freeOffset] = i;
+                    if (m_defragmentCursor == i) m_defragmentCursor = Node::unused;
+                }
+            }
+            else
+            {
+                removeNodeFromBin(i);
+            }
+            i = neighborNext;
+        }
+        uint32 neighborNext = i;
+
+        // The combined run reuses nodeIndex. No freelist pops: Freelisted pending nodes keep their links
+        // intact until the caller is done iterating its pending set (freeBatch items, deferred list).
+        linkNodeIntoBin(nodeIndex, size, offset);
+
+        // Connect neighbors with the new combined node
+        if (neighborNext != Node::unused)
+        {
+            m_nodes[nodeIndex].neighborNext = neighborNext;
+            m_nodes[neighborNext].neighborPrev = nodeIndex;
+        }
+        else
+        {
+            m_lastNode = nodeIndex;
+        }
+        if (neighborPrev != Node::unused)
+        {
+            m_nodes[nodeIndex].neighborPrev = neighborPrev;
+            m_nodes[neighborPrev].neighborNext = nodeIndex;
+        }
+    }
+
+    void Allocator::freeDeferred(Allocation allocation, uint64 fence)
+    {
+        if (allocation.offset == Allocation::NO_SPACE || !m_nodes) return;
+        TRACE(.op = TraceOp::FreeDeferred, .metadata = allocation.metadata, .offset = allocation.offset, .size = fence);
+        STAT(m_stats.frees++);
+
+        uint32 nodeIndex = allocation.metadata;
+        Node& node = m_nodes[nodeIndex];
+
+        // Double delete check. Deferred nodes stay used (neighbors can't merge) and point binListPrev to themselves.
+        ASSERT(node.used == true);
+        ASSERT(node.binListPrev != nodeIndex);
+        node.binListPrev = nodeIndex;
+        node.binListNext = Node::unused;
+
+        // Append to the FIFO
+        if (m_deferredTail != Node::unused) m_nodes[m_deferredTail].binListNext = nodeIndex;
+        else m_deferredHead = nodeIndex;
+        m_deferredTail = nodeIndex;
+
+        if (m_deferredFenceCount > 0)
+        {
+            DeferredFence& newest = m_deferredFences[(m_deferredFenceStart + m_deferredFenceCount - 1) % MAX_DEFERRED_FENCES];
+            ASSERT(fence >= newest.fence);
+            if (fence == newest.fence || m_deferredFenceCount == MAX_DEFERRED_FENCES)
+            {
+                newest.fence = fence;
+                newest.lastNodeIndex = nodeIndex;
+                return;
+            }
+        }
+        m_deferredFences[(m_deferredFenceStart + m_deferredFenceCount) % MAX_DEFERRED_FENCES] = {.fence = fence, .lastNodeIndex = nodeIndex};
+        m_deferredFenceCount++;
+    }
+
+    void Allocator::retire(uint64 completedFence)
+    {
+        TRACE(.op = TraceOp::Retire, .size = completedFence);
+
+        // Completed segments are at the front of the ring
+        uint32 lastNodeIndex = Node::unused;
+        while (m_deferredFenceCount > 0 && m_deferredFences[m_deferredFenceStart].fence <= completedFence)
+        {
+            lastNodeIndex = m_deferredFences[m_deferredFenceStart].lastNodeIndex;
+            m_deferredFenceStart = (m_deferredFenceStart + 1) % MAX_DEFERRED_FENCES;
+            m_deferredFenceCount--;
+        }
+        if (lastNodeIndex == Node::unused) return;
+
+        uint32 firstNodeIndex = m_deferredHead;
+        m_deferredHead = m_nodes[lastNodeIndex].binListNext;
+        if (m_deferredHead == Node::unused) m_deferredTail = Node::unused;
+
+        // Same two passes as freeBatch: Mark all free (pending), then coalesce each run once
+        for (uint32 i = firstNodeIndex; ; i = m_nodes[i].binListNext)
+        {
+            m_nodes[i].used = false;
+            if (i == lastNodeIndex) break;
+        }
+
+        uint32 i = firstNodeIndex;
+        for (;;)
+        {
+            // freePendingRun reuses i for the combined run: Read the list link first
+            uint32 next = m_nodes[i].binListNext;
+            bool last = i == lastNodeIndex;
+            if (m_nodes[i].binListPrev == i) freePendingRun(i);
+            if (last) break;
+            i = next;
+        }
+    }
+
+    uint32 Allocator::insertNodeIntoBin(Offset size, Offset dataOffset)
+    {
+        // Take a freelist node and insert on top of the bin linked list
+        uint32 nodeIndex = popFreeNode();
+#ifdef DEBUG_VERBOSE
+        printf("Getting node %u from freelist[%u]\n", nodeIndex, m_freeOffset + 1);
+#endif
+        linkNodeIntoBin(nodeIndex, size, dataOffset);
+        return nodeIndex;
+    }
+
+    void Allocator::linkNodeIntoBin(uint32 nodeIndex, Offset size, Offset dataOffset)
     {
         // Round down to bin index to ensure that bin >= alloc
         uint32 binIndex = SmallFloat::uintToFloatRoundDown(size);
@@ -366,32 +1427,33 @@ namespace OffsetAllocator
         if (m_binIndices[binIndex] == Node::unused)
         {
             // Set bin mask bits
-            m_usedBins[topBinIndex] |= 1 << leafBinIndex;
-            m_usedBinsTop |= 1 << topBinIndex;
+            m_usedBins[topBinIndex] |= (LeafBinMask)1 << leafBinIndex;
+            m_usedBinsTop |= (TopBinMask)1 << topBinIndex;
         }
         
-        // Take a freelist node and insert on top of the bin linked list (next = old top)
+        // Insert on top of the bin linked list (next = old top)
         uint32 topNodeIndex = m_binIndices[binIndex];
-        uint32 nodeIndex = m_freeNodes[m_freeOffset--];
-#ifdef DEBUG_VERBOSE
-        printf("Getting node %u from freelist[%u]\n", nodeIndex, m_freeOffset + 1);
-#endif
-        m_nodes[nodeIndex] = {.dataOffset = dataOffset, .dataSize = size, .binListNext = topNodeIndex};
+        m_nodes[nodeIndex] = {.dataOffset = dataOffset, .dataSize = size, .binListNext = (NodeIndex)topNodeIndex};
         if (topNodeIndex != Node::unused) m_nodes[topNodeIndex].binListPrev = nodeIndex;
         m_binIndices[binIndex] = nodeIndex;
+        m_binCounts[binIndex]++;
+        STAT(m_stats.binInserts[binIndex]++);
+        STAT(if (m_binCounts[binIndex] > m_stats.binPeakDepth[binIndex]) m_stats.binPeakDepth[binIndex] = m_binCounts[binIndex]);
         
         m_freeStorage += size;
 #ifdef DEBUG_VERBOSE
-        printf("Free storage: %u (+%u) (insertNodeIntoBin)\n", m_freeStorage, size);
+        printf("Free storage: %llu (+%llu) (insertNodeIntoBin)\n", (uint64)m_freeStorage, (uint64)size);
 #endif
-
-        return nodeIndex;
     }
     
     void Allocator::removeNodeFromBin(uint32 nodeIndex)
     {
         Node &node = m_nodes[nodeIndex];
         
+        // Round down to bin index to ensure that bin >= alloc
+        uint32 binIndex = SmallFloat::uintToFloatRoundDown(node.dataSize);
+        m_binCounts[binIndex]--;
+        
         if (node.binListPrev != Node::unused)
         {
             // Easy case: We have previous node. Just remove this node from the middle of the list.
@@ -400,11 +1462,7 @@ namespace OffsetAllocator
         }
         else
         {
-            // Hard case: We are the first node in a bin. Find the bin.
-            
-            // Round down to bin index to ensure that bin >= alloc
-            uint32 binIndex = SmallFloat::uintToFloatRoundDown(node.dataSize);
-            
+            // Hard case: We are the first node in a bin
             uint32 topBinIndex = binIndex >> TOP_BINS_INDEX_SHIFT;
             uint32 leafBinIndex = binIndex & LEAF_BINS_INDEX_MASK;
             
@@ -415,13 +1473,13 @@ namespace OffsetAllocator
             if (m_binIndices[binIndex] == Node::unused)
             {
                 // Remove a leaf bin mask bit
-                m_usedBins[topBinIndex] &= ~(1 << leafBinIndex);
+                m_usedBins[topBinIndex] &= ~((LeafBinMask)1 << leafBinIndex);
                 
                 // All leaf bins empty?
                 if (m_usedBins[topBinIndex] == 0)
                 {
                     // Remove a top bin mask bit
-                    m_usedBinsTop &= ~(1 << topBinIndex);
+                    m_usedBinsTop &= ~((TopBinMask)1 << topBinIndex);
                 }
             }
         }
@@ -431,16 +1489,136 @@ namespace OffsetAllocator
         printf("Putting node %u into freelist[%u] (removeNodeFromBin)\n", nodeIndex, m_freeOffset + 1);
 #endif
         m_freeNodes[++m_freeOffset] = nodeIndex;
+        if (m_defragmentCursor == nodeIndex) m_defragmentCursor = Node::unused;
 
         m_freeStorage -= node.dataSize;
 #ifdef DEBUG_VERBOSE
-        printf("Free storage: %u (-%u) (removeNodeFromBin)\n", m_freeStorage, node.dataSize);
+        printf("Free storage: %llu (-%llu) (removeNodeFromBin)\n", (uint64)m_freeStorage, (uint64)node.dataSize);
 #endif
     }
 
-    uint32 Allocator::allocationSize(Allocation allocation) const
+    uint32 Allocator::defragment(std::span<Relocation> relocations, Offset byteBudget)
     {
-        if (allocation.metadata == Allocation::NO_SPACE) return 0;
+        // No free nodes: Nothing to compact
+        if (!m_nodes || m_usedBinsTop == 0)
+        {
+            TRACE(.op = TraceOp::Defragment, .metadata = (uint32)relocations.size(), .offset = 0, .size = byteBudget);
+            return 0;
+        }
+
+        // Resume at the gap the previous call stopped at. No cursor: From the lowest gap.
+        uint32 freeIndex = m_defragmentCursor;
+        bool fromStart = freeIndex == Node::unused;
+        if (fromStart) freeIndex = findLowestFreeNode();
+
+        uint32 count = 0;
+        Offset movedBytes = 0;
+        while (count < relocations.size())
+        {
+            // Next gap at or after freeIndex
+            while (freeIndex != Node::unused && m_nodes[freeIndex].used)
+                freeIndex = m_nodes[freeIndex].neighborNext;
+
+            // End of the storage: Start over once from the lowest gap (gaps freed below the cursor)
+            uint32 usedIndex = freeIndex != Node::unused ? m_nodes[freeIndex].neighborNext : Node::unused;
+            if (usedIndex == Node::unused)
+            {
+                freeIndex = Node::unused;
+                if (fromStart) break;
+                fromStart = true;
+                freeIndex = findLowestFreeNode();
+                continue;
+            }
+
+            // Deferred frees can't move (the GPU may still read them). Aligned allocations only move to an offset
+            // of their alignment. Both stay: Continue from the next gap after them.
+            Offset alignmentMask = ((Offset)1 << m_nodes[usedIndex].alignmentLog2) - 1;
+            if (m_nodes[usedIndex].binListPrev == usedIndex || (m_nodes[freeIndex].dataOffset & alignmentMask) != 0)
+            {
+                freeIndex = usedIndex;
+                continue;
+            }
+
+            Node& freeNode = m_nodes[freeIndex];
+            Node& usedNode = m_nodes[usedIndex];
+            ASSERT(freeNode.used == false);
+            ASSERT(usedNode.used == true);
+
+            Offset size = usedNode.dataSize;
+            if (count > 0 && (movedBytes >= byteBudget || size > byteBudget - movedBytes)) break;
+            movedBytes += size;
+
+            // Swap [free][used] -> [used][free]. Free node size is unchanged: It stays in its bin.
+            Offset oldOffset = usedNode.dataOffset;
+            Offset newOffset = freeNode.dataOffset;
+            usedNode.dataOffset = newOffset;
+            freeNode.dataOffset = newOffset + size;
+            relocations[count++] = {.oldOffset = oldOffset, .newOffset = newOffset, .size = size,
+                .allocation = {.offset = newOffset, .metadata = (NodeIndex)usedIndex}};
+
+#ifdef DEBUG_VERBOSE
+            printf("Moving node %u from %llu to %llu (defragment)\n", usedIndex, (uint64)oldOffset, (uint64)newOffset);
+#endif
+
+            uint32 neighborPrev = m_nodes[freeIndex].neighborPrev;
+            uint32 neighborNext = m_nodes[usedIndex].neighborNext;
+            m_nodes[usedIndex].neighborPrev = neighborPrev;
+            m_nodes[usedIndex].neighborNext = freeIndex;
+            m_nodes[freeIndex].neighborPrev = usedIndex;
+            m_nodes[freeIndex].neighborNext = neighborNext;
+            if (neighborPrev != Node::unused)
+                m_nodes[neighborPrev].neighborNext = usedIndex;
+            if (neighborNext != Node::unused)
+                m_nodes[neighborNext].neighborPrev = freeIndex;
+            else
+                m_lastNode = freeIndex;
+
+            if ((neighborNext != Node::unused) && (m_nodes[neighborNext].used == false))
+            {
+                // Next (contiguous) free node: Merge like free() does
+                Offset combinedOffset = freeNode.dataOffset;
+                Offset combinedSize = freeNode.dataSize + m_nodes[neighborNext].dataSize;
+                uint32 neighborNextNext = m_nodes[neighborNext].neighborNext;
+
+                removeNodeFromBin(neighborNext);
+                removeNodeFromBin(freeIndex);
+                freeIndex = insertNodeIntoBin(combinedSize, combinedOffset);
+
+                m_nodes[freeIndex].neighborPrev = usedIndex;
+                m_nodes[usedIndex].neighborNext = freeIndex;
+                if (neighborNextNext != Node::unused)
+                {
+                    m_nodes[freeIndex].neighborNext = neighborNextNext;
+                    m_nodes[neighborNextNext].neighborPrev = freeIndex;
+                }
+                else
+                {
+                    m_lastNode = freeIndex;
+                }
+            }
+        }
+
+        m_defragmentCursor = freeIndex;
+        TRACE(.op = TraceOp::Defragment, .metadata = (uint32)relocations.size(), .offset = count, .size = byteBudget);
+        return count;
+    }
+
+    uint32 Allocator::findLowestFreeNode() const
+    {
+        // Walk back from any binned node to the start of the storage, then forward
+        uint32 topBinIndex = tzcnt_nonzero(m_usedBinsTop);
+        uint32 leafBinIndex = tzcnt_nonzero((uint32)m_usedBins[topBinIndex]);
+        uint32 nodeIndex = m_binIndices[(topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex];
+        while (m_nodes[nodeIndex].neighborPrev != Node::unused)
+            nodeIndex = m_nodes[nodeIndex].neighborPrev;
+        while (m_nodes[nodeIndex].used)
+            nodeIndex = m_nodes[nodeIndex].neighborNext;
+        return nodeIndex;
+    }
+
+    Offset Allocator::allocationSize(Allocation allocation) const
+    {
+        if (allocation.metadata == Node::unused) return 0;
         if (!m_nodes) return 0;
         
         return m_nodes[allocation.metadata].dataSize;
@@ -448,8 +1626,8 @@ namespace OffsetAllocator
 
     StorageReport Allocator::storageReport() const
     {
-        uint32 largestFreeRegion = 0;
-        uint32 freeStorage = 0;
+        Offset largestFreeRegion = 0;
+        Offset freeStorage = 0;
         
         // Out of allocations? -> Zero free space
         if (m_freeOffset > 0)
@@ -457,8 +1635,8 @@ namespace OffsetAllocator
             freeStorage = m_freeStorage;
             if (m_usedBinsTop)
             {
-                uint32 topBinIndex = 31 - lzcnt_nonzero(m_usedBinsTop);
-                uint32 leafBinIndex = 31 - lzcnt_nonzero(m_usedBins[topBinIndex]);
+                uint32 topBinIndex = highestSetBit_nonzero(m_usedBinsTop);
+                uint32 leafBinIndex = highestSetBit_nonzero((uint32)m_usedBins[topBinIndex]);
                 largestFreeRegion = SmallFloat::floatToUint((topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex);
                 ASSERT(freeStorage >= largestFreeRegion);
             }
@@ -469,18 +1647,117 @@ namespace OffsetAllocator
 
     StorageReportFull Allocator::storageReportFull() const
     {
+        // Bin counts are maintained by insertNodeIntoBin/removeNodeFromBin/allocate: No list walks
         StorageReportFull report;
         for (uint32 i = 0; i < NUM_LEAF_BINS; i++)
         {
-            uint32 count = 0;
-            uint32 nodeIndex = m_binIndices[i];
-            while (nodeIndex != Node::unused)
+            report.freeRegions[i] = { .size = SmallFloat::floatToUint(i), .count = m_binCounts[i] };
+        }
+        return report;
+    }
+
+    const char* Allocator::validate() const
+    {
+        if (!m_nodes) return nullptr;
+        if (m_freeOffset >= m_maxAllocs) return "freelist offset out of range";
+        if (m_lazyFreeNodes == 0 || m_lazyFreeNodes > m_freeOffset + 1) return "implicit freelist entries above the stack top";
+
+        // Freelist nodes are stale. freelist[0] (node m_maxAllocs - 1) is never popped.
+        enum : uint8 { LIVE, STALE, VISITED };
+        std::vector<uint8> state(m_maxAllocs, LIVE);
+        state[m_maxAllocs - 1] = STALE;
+        for (uint32 i = 1; i <= m_freeOffset; i++)
+        {
+            uint32 nodeIndex = i < m_lazyFreeNodes ? m_maxAllocs - i - 1 : m_freeNodes[i];
+            if (nodeIndex >= m_maxAllocs || state[nodeIndex] != LIVE) return "freelist entry out of range or duplicated";
+            state[nodeIndex] = STALE;
+        }
+
+        // Neighbor chain: From offset 0 to m_size without gaps, through every live node
+        uint32 head = Node::unused;
+        uint32 liveCount = 0;
+        for (uint32 i = 0; i < m_maxAllocs; i++)
+        {
+            if (state[i] != LIVE) continue;
+            liveCount++;
+            if (m_nodes[i].neighborPrev == Node::unused)
             {
-                nodeIndex = m_nodes[nodeIndex].binListNext;
-                count++;
+                if (head != Node::unused) return "several nodes without a previous neighbor";
+                head = i;
             }
-            report.freeRegions[i] = { .size = SmallFloat::floatToUint(i), .count = count };
         }
-        return report;
+        if (head == Node::unused) return "no first node";
+
+        Offset offset = 0;
+        Offset freeStorage = 0;
+        uint32 freeCount = 0;
+        uint32 prevIndex = Node::unused;
+        for (uint32 nodeIndex = head; nodeIndex != Node::unused; nodeIndex = m_nodes[nodeIndex].neighborNext)
+        {
+            if (nodeIndex >= m_maxAllocs || state[nodeIndex] != LIVE) return "neighbor link to a stale or visited node";
+            state[nodeIndex] = VISITED;
+            liveCount--;
+
+            const Node& node = m_nodes[nodeIndex];
+            if (m_nodes[nodeIndex].neighborPrev != prevIndex) return "neighborPrev doesn't match neighborNext";
+            if (node.dataOffset != offset) return "neighbor ranges aren't contiguous";
+            if (node.used == false)
+            {
+                if (prevIndex != Node::unused && m_nodes[prevIndex].used == false) return "free neighbors not merged";
+                freeStorage += node.dataSize;
+                freeCount++;
+            }
+            offset += node.dataSize;
+            prevIndex = nodeIndex;
+        }
+        if (offset != m_size) return "neighbor ranges don't end at the storage size";
+        if (prevIndex != m_lastNode) return "m_lastNode isn't the last neighbor";
+        if (liveCount != 0) return "live nodes outside the neighbor chain";
+        if (freeStorage != m_freeStorage) return "m_freeStorage doesn't match the free nodes";
+
+        // Bins: Free nodes of the bin size, prev links, counts and masks
+        uint32 binnedCount = 0;
+        for (uint32 topBinIndex = 0; topBinIndex < NUM_TOP_BINS; topBinIndex++)
+        {
+            bool topBinUsed = ((m_usedBinsTop >> topBinIndex) & 1) != 0;
+            if (topBinUsed != (m_usedBins[topBinIndex] != 0)) return "top bin mask doesn't match the leaf bin masks";
+
+            for (uint32 leafBinIndex = 0; leafBinIndex < BINS_PER_LEAF; leafBinIndex++)
+            {
+                uint32 binIndex = (topBinIndex << TOP_BINS_INDEX_SHIFT) | leafBinIndex;
+                uint32 count = 0;
+                uint32 binPrevIndex = Node::unused;
+                for (uint32 nodeIndex = m_binIndices[binIndex]; nodeIndex != Node::unused; nodeIndex = m_nodes[nodeIndex].binListNext)
+                {
+                    if (nodeIndex >= m_maxAllocs || state[nodeIndex] != VISITED) return "bin list links a stale node";
+                    if (m_nodes[nodeIndex].used) return "used node in a bin";
+                    if (SmallFloat::uintToFloatRoundDown(m_nodes[nodeIndex].dataSize) != binIndex) return "free node in the wrong bin";
+                    if (m_nodes[nodeIndex].binListPrev != binPrevIndex) return "binListPrev doesn't match binListNext";
+                    if (++count > freeCount) return "bin list cycle";
+                    binPrevIndex = nodeIndex;
+                }
+
+                bool leafBinUsed = ((m_usedBins[topBinIndex] >> leafBinIndex) & 1) != 0;
+                if (count != m_binCounts[binIndex]) return "bin count doesn't match the bin list";
+                if (leafBinUsed != (count > 0)) return "leaf bin mask doesn't match the bin list";
+                binnedCount += count;
+            }
+        }
+        if (binnedCount != freeCount) return "free nodes missing from the bins";
+
+        // Deferred FIFO: Used nodes pointing binListPrev to themselves
+        uint32 deferredCount = 0;
+        uint32 lastIndex = Node::unused;
+        for (uint32 nodeIndex = m_deferredHead; nodeIndex != Node::unused; nodeIndex = m_nodes[nodeIndex].binListNext)
+        {
+            if (nodeIndex >= m_maxAllocs || state[nodeIndex] != VISITED) return "deferred list links a stale node";
+            if (m_nodes[nodeIndex].used == false || m_nodes[nodeIndex].binListPrev != nodeIndex) return "deferred list links a node that isn't deferred";
+            if (++deferredCount > m_maxAllocs) return "deferred list cycle";
+            lastIndex = nodeIndex;
+        }
+        if (lastIndex != m_deferredTail) return "deferred list doesn't end at the tail";
+        if ((m_deferredFenceCount == 0) != (m_deferredHead == Node::unused)) return "deferred fences don't match the deferred list";
+
+        return nullptr;
     }
 }
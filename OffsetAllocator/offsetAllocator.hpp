@@ -1,13 +1,24 @@
 // (C) Sebastian Aaltonen 2023
 // MIT License (see file: LICENSE)
 
+#pragma once
+
 //#define USE_16_BIT_OFFSETS
+//#define USE_64_BIT_OFFSETS
+//#define USE_MANTISSA_BITS 4
+//#define USE_ALLOCATION_TRACE
+//#define USE_ALLOCATOR_STATS
+//#define USE_BIN_CACHE
+
+#include <cstddef>
+#include <span>
 
 namespace OffsetAllocator
 {
     typedef unsigned char uint8;
     typedef unsigned short uint16;
     typedef unsigned int uint32;
+    typedef unsigned long long uint64;
 
     // 16 bit offsets mode will halve the metadata storage cost
     // But it only supports up to 65536 maximum allocation count
@@ -17,79 +28,301 @@ namespace OffsetAllocator
     typedef uint32 NodeIndex;
 #endif
 
+    // 64 bit offsets mode supports storage sizes above 4GB
+    // Doubles the node offset/size metadata and the top bin count (64 top bins, 512 leaf bins)
+#ifdef USE_64_BIT_OFFSETS
+    typedef uint64 Offset;
+    typedef uint64 TopBinMask;
+    static constexpr uint32 NUM_TOP_BINS = 64;
+#else
+    typedef uint32 Offset;
+    typedef uint32 TopBinMask;
     static constexpr uint32 NUM_TOP_BINS = 32;
-    static constexpr uint32 BINS_PER_LEAF = 8;
-    static constexpr uint32 TOP_BINS_INDEX_SHIFT = 3;
-    static constexpr uint32 LEAF_BINS_INDEX_MASK = 0x7;
+#endif
+
+    // Bin geometry: Top bin = exponent, leaf bin = mantissa. Each top bin has 2^MANTISSA_BITS leaf bins.
+    // Default 3 bits: 8 leaf bins, up to 12.5% size class rounding. 4 bits: 6.25%, 5 bits: 3.125%.
+    // More bins = less rounding waste, but larger bin arrays and wider leaf masks to scan.
+#ifdef USE_MANTISSA_BITS
+    static constexpr uint32 MANTISSA_BITS = USE_MANTISSA_BITS;
+#else
+    static constexpr uint32 MANTISSA_BITS = 3;
+#endif
+    static_assert(MANTISSA_BITS >= 3 && MANTISSA_BITS <= 5, "Supported mantissa bits: 3, 4, 5 (leaf bin mask is at most 32 bits)");
+
+#if defined(USE_MANTISSA_BITS) && USE_MANTISSA_BITS == 5
+    typedef uint32 LeafBinMask;
+#elif defined(USE_MANTISSA_BITS) && USE_MANTISSA_BITS == 4
+    typedef uint16 LeafBinMask;
+#else
+    typedef uint8 LeafBinMask;
+#endif
+
+    static constexpr uint32 BINS_PER_LEAF = 1 << MANTISSA_BITS;
+    static constexpr uint32 TOP_BINS_INDEX_SHIFT = MANTISSA_BITS;
+    static constexpr uint32 LEAF_BINS_INDEX_MASK = BINS_PER_LEAF - 1;
     static constexpr uint32 NUM_LEAF_BINS = NUM_TOP_BINS * BINS_PER_LEAF;
 
     struct Allocation
     {
-        static constexpr uint32 NO_SPACE = 0xffffffff;
+        static constexpr Offset NO_SPACE = ~(Offset)0;
         
-        uint32 offset = NO_SPACE;
-        NodeIndex metadata = NO_SPACE; // internal: node index
+        Offset offset = NO_SPACE;
+        NodeIndex metadata = (NodeIndex)NO_SPACE; // internal: node index
+    };
+
+    struct Relocation
+    {
+        Offset oldOffset;
+        Offset newOffset;
+        Offset size;
+        Allocation allocation; // Updated handle (newOffset, same metadata)
     };
 
     struct StorageReport
     {
-        uint32 totalFreeSpace;
-        uint32 largestFreeRegion;
+        Offset totalFreeSpace;
+        Offset largestFreeRegion;
+
+        // 0 = all free space in one region, close to 1 = scattered in small regions.
+        // largestFreeRegion is rounded down to its bin: a single region reports up to 1 / 2^MANTISSA_BITS
+        // (12.5% with the default 3 bits, 3.125% with 5).
+        float fragmentation() const
+        {
+            return totalFreeSpace ? 1.0f - (float)largestFreeRegion / (float)totalFreeSpace : 0.0f;
+        }
     };
 
     struct StorageReportFull
     {
         struct Region
         {
-            uint32 size;
+            Offset size;
             uint32 count;
         };
         
         Region freeRegions[NUM_LEAF_BINS];
     };
 
+    // Node selection inside the chosen bin
+    // BinHead: Pop the bin list head (default, fastest)
+    // BestFit: Tightest node among the first POLICY_SCAN_LIMIT nodes. Also tries the exact fit bin (sizes rounded down).
+    // LowestAddress: Lowest offset among the first POLICY_SCAN_LIMIT nodes. Keeps the heap packed toward offset 0.
+    enum class AllocationPolicy : uint8
+    {
+        BinHead,
+        BestFit,
+        LowestAddress,
+    };
+
+#ifdef USE_ALLOCATION_TRACE
+    class TraceRing;
+#endif
+
+#ifdef USE_ALLOCATOR_STATS
+    // Instrumentation counters (compile with USE_ALLOCATOR_STATS). Cumulative since construction or resetStats().
+    // The current free list depth of a bin is m_binCounts.
+    struct AllocatorStats
+    {
+        uint64 allocations;                     // Handles returned (batch items included)
+        uint64 failedAllocations;               // NO_SPACE results of allocate. Batch items count one each.
+        uint64 frees;                           // free, freeBatch items, freeDeferred
+        uint64 splits;                          // Free nodes split off a chosen node (remainder, alignment padding)
+        uint64 merges;                          // Free neighbors coalesced on free, freeBatch and retire
+        uint64 topBinFallbacks;                 // Bin searches served by a higher top bin than the size's own
+        uint64 binCacheHits;                    // allocate sizes found in the size -> bin cache (USE_BIN_CACHE)
+        uint64 minBinHits;                      // allocate bin searches served by the size's own round up bin
+        uint64 binAllocations[NUM_LEAF_BINS];   // Bin searches served per bin (a batch fast path is one)
+        uint64 binInserts[NUM_LEAF_BINS];       // Free nodes inserted per bin
+        uint32 binPeakDepth[NUM_LEAF_BINS];     // Peak free list depth per bin
+    };
+#endif
+
     class Allocator
     {
     public:
-        Allocator(uint32 size, uint32 maxAllocs = 128 * 1024);
+        static constexpr uint32 POLICY_SCAN_LIMIT = 16;
+
+        // maxAllocs counts nodes: The initial free node plus one per split remainder. Smaller values are clamped to
+        // MIN_MAX_ALLOCS (the freelist offset would wrap).
+        static constexpr uint32 MIN_MAX_ALLOCS = 2;
+
+        Allocator(Offset size, uint32 maxAllocs = 128 * 1024);
         Allocator(Allocator &&other);
+
+        // Caller provided metadata memory (64 byte aligned, at least requiredMemorySize bytes). Never touches the heap.
+        // Memory must outlive the allocator.
+        Allocator(Offset size, uint32 maxAllocs, void* memory);
+        static size_t requiredMemorySize(uint32 maxAllocs);
+
+        // Snapshot: Versioned binary blob of the whole allocator state (snapshotSize bytes, 64 byte aligned memory).
+        // Header (counters, bins) + the node arrays as is: No per node encoding. Same compile time options required.
+        size_t snapshotSize() const;
+        void saveSnapshot(void* memory) const;
+        static bool isValidSnapshot(const void* memory, size_t size);
+
+        // Copies the snapshot into this allocator. maxAllocs must match. Returns false for incompatible blobs.
+        bool loadSnapshot(const void* memory, size_t size);
+
+        // In place restore: Uses the snapshot node arrays directly (e.g. copy-on-write memory mapped file), no copies.
+        // Memory must stay writable and outlive the allocator. Invalid blobs give an empty allocator (all allocations fail).
+        static Allocator restoreSnapshotInPlace(void* memory, size_t size);
         ~Allocator();
         void reset();
+
+        // Affects allocate(size) and allocateBatch. Aligned allocations always use BinHead.
+        void setAllocationPolicy(AllocationPolicy policy);
+
+#ifdef USE_ALLOCATION_TRACE
+        // Records every operation into the ring (offsetAllocatorTrace.hpp), nullptr = off.
+        // Starts the trace with a Begin record. Attach to an empty allocator to get a replayable trace.
+        void setTrace(TraceRing* trace);
+#endif
+
+#ifdef USE_ALLOCATOR_STATS
+        const AllocatorStats& stats() const { return m_stats; }
+        void resetStats();
+#endif
         
-        Allocation allocate(uint32 size);
+        Allocation allocate(Offset size);
         void free(Allocation allocation);
 
-        uint32 allocationSize(Allocation allocation) const;
+        // Offset is a multiple of alignment (power of two). Leading padding stays behind as a free node.
+        Allocation allocate(Offset size, Offset alignment);
+
+        // Double-ended placement: Carves the tail of the highest free node that fits. Short-lived data grows down from
+        // the end while allocate fills up from 0. Walks back over the last POLICY_SCAN_LIMIT nodes of the storage.
+        // If none of them fits: Tail of the largest free node (highest used bin, highest offset among its first
+        // POLICY_SCAN_LIMIT nodes), which may be below a smaller fitting node. O(1) like allocate.
+        // Ignores the allocation policy. Free with free as usual.
+        Allocation allocateHigh(Offset size);
+
+        // In place resize: The offset and the handle stay the same, nothing moves.
+        // tryGrow absorbs the free next neighbor (the unused rest of it stays free). Fails if the next neighbor
+        // is used or too small. newSize <= current size succeeds without changes.
+        // shrink returns the tail to the bins, merged with a free next neighbor. Fails only when out of nodes
+        // (the tail needs a new free node). newSize >= current size succeeds without changes.
+        // Not for deferred frees.
+        bool tryGrow(Allocation allocation, Offset newSize);
+        bool shrink(Allocation allocation, Offset newSize);
+
+        // Growable heap: Start small and scale up under load. Live allocations and node indices stay valid.
+        // growStorage appends [size, size + additionalSize) as free storage, merged with a free last node.
+        // Fails on size overflow, or when out of nodes and the last node is used. O(1): The last node is tracked.
+        // growNodes reallocates the node arrays to newMaxAllocs (newMaxAllocs <= maxAllocs succeeds without changes).
+        // Fails for caller provided memory and in place snapshots: The allocator doesn't own the node arrays.
+        bool growStorage(Offset additionalSize);
+        bool growNodes(uint32 newMaxAllocs);
+
+        // Batch API: Carves all sizes from one free node (one bin search, one remainder insert).
+        // Falls back to per-item allocate if no single node fits the sum. Failed items get NO_SPACE, placed items stay allocated.
+        // Returns true if every item was allocated. Free the batch with freeBatch (NO_SPACE items are skipped).
+        bool allocateBatch(std::span<const Offset> sizes, Allocation* out);
+        void freeBatch(std::span<const Allocation> allocations);
+
+        // Deferred free: The allocation stays used until retire(completedFence) with completedFence >= fence.
+        // Fence values must be monotonically increasing. No memory allocations: Pending nodes are linked
+        // through their (unused) bin list links. retire frees everything up to the fence in one batched pass.
+        void freeDeferred(Allocation allocation, uint64 fence);
+        void retire(uint64 completedFence);
+
+        // Compaction: Slides used ranges down into the lowest free gap, one relocation per moved allocation.
+        // The new layout is committed immediately. Caller copies the data in relocation order (ranges may
+        // overlap: memmove semantics) before using it. Old handles stay valid for free (same metadata).
+        // Deferred frees are not moved (the GPU may still read them). Compaction continues after them.
+        // Stops when the relocation span is full or the next move would exceed byteBudget (the first move
+        // of a call always fits). Returns the relocation count, 0 = fully compacted.
+        // Aligned allocations only move to an offset of the alignment they were allocated with, else they stay.
+        // Each call resumes at the gap the previous one stopped at, a full pass walks the storage once.
+        uint32 defragment(std::span<Relocation> relocations, Offset byteBudget = ~(Offset)0);
+
+        Offset allocationSize(Allocation allocation) const;
         StorageReport storageReport() const;
         StorageReportFull storageReportFull() const;
+
+        // Invariant check for tests and fuzzing. O(maxAllocs), allocates a temporary node state array.
+        // Neighbor links cover [0, size) in order and end at the tracked last node, free neighbors are merged, every free node is in the bin of its
+        // size, bin lists, counts and masks agree, m_freeStorage = free node sizes, freelist and deferred list hold
+        // the right nodes. Returns nullptr if valid, else the first broken invariant.
+        const char* validate() const;
         
 //    private:
-        uint32 insertNodeIntoBin(uint32 size, uint32 dataOffset);
+        Allocator();
+        void assignNodeMemory(void* memory);
+        Allocation allocateFromBin(Offset size);
+        Allocation allocateAligned(Offset size, Offset alignment);
+        Allocation allocateFromTail(Offset size);
+        uint32 findFreeBin(Offset size) const;
+        uint32 findFreeBinFrom(uint32 minBinIndex) const;
+        uint32 roundUpBin(Offset size);
+        uint32 scanBin(uint32 binIndex, Offset minSize) const;
+        uint32 popFreeNode();
+        uint32 findLowestFreeNode() const;
+        uint32 insertNodeIntoBin(Offset size, Offset dataOffset);
+        void linkNodeIntoBin(uint32 nodeIndex, Offset size, Offset dataOffset);
         void removeNodeFromBin(uint32 nodeIndex);
+        void freePendingRun(uint32 nodeIndex);
 
         struct Node
         {
             static constexpr NodeIndex unused = 0xffffffff;
             
-            uint32 dataOffset = 0;
-            uint32 dataSize = 0;
+            Offset dataOffset = 0;
+            Offset dataSize = 0;
             NodeIndex binListPrev = unused;
             NodeIndex binListNext = unused;
             NodeIndex neighborPrev = unused;
             NodeIndex neighborNext = unused;
             bool used = false; // TODO: Merge as bit flag
+            uint8 alignmentLog2 = 0;    // allocate(size, alignment) of a used node: defragment keeps the alignment
         };
     
-        uint32 m_size;
+        Offset m_size;
         uint32 m_maxAllocs;
-        uint32 m_freeStorage;
+        Offset m_freeStorage;
 
-        uint32 m_usedBinsTop;
-        uint8 m_usedBins[NUM_TOP_BINS];
+        TopBinMask m_usedBinsTop;
+        LeafBinMask m_usedBins[NUM_TOP_BINS];
         NodeIndex m_binIndices[NUM_LEAF_BINS];
+        uint32 m_binCounts[NUM_LEAF_BINS];      // Free node count per bin
                 
-        Node* m_nodes;
+        Node* m_nodes;                  // 64 byte aligned
         NodeIndex* m_freeNodes;
         uint32 m_freeOffset;
+        uint32 m_lazyFreeNodes;         // Freelist entries [0, m_lazyFreeNodes) are implicit (not written since reset)
+        bool m_ownsMemory;
+        AllocationPolicy m_allocationPolicy;
+
+        // Deferred frees: FIFO node list (binListNext) split into fence segments. Segment = last node with that fence.
+        // Ring overflow merges into the newest segment: Its nodes get freed at the later fence (always safe).
+        static constexpr uint32 MAX_DEFERRED_FENCES = 16;
+        struct DeferredFence
+        {
+            uint64 fence;
+            uint32 lastNodeIndex;
+        };
+        DeferredFence m_deferredFences[MAX_DEFERRED_FENCES];
+        uint32 m_deferredFenceStart;
+        uint32 m_deferredFenceCount;
+        uint32 m_deferredHead;
+        uint32 m_deferredTail;
+
+        uint32 m_lastNode;              // Node ending at m_size (growStorage appends after it)
+        uint32 m_defragmentCursor;      // Live node defragment resumes at. Dropped when the node goes to the freelist.
+
+#ifdef USE_BIN_CACHE
+        // Recent allocate sizes -> round up bin. Direct mapped by a size hash. The mapping is a pure function of
+        // the size: Entries never go stale (reset, grow and snapshots keep them). Zero initialized = size 0 -> bin 0.
+        static constexpr uint32 BIN_CACHE_BITS = 4;
+        static constexpr uint32 BIN_CACHE_SIZE = 1 << BIN_CACHE_BITS;
+        Offset m_binCacheSizes[BIN_CACHE_SIZE] = {};
+        uint16 m_binCacheBins[BIN_CACHE_SIZE] = {};
+#endif
+#ifdef USE_ALLOCATION_TRACE
+        TraceRing* m_trace = nullptr;
+#endif
+#ifdef USE_ALLOCATOR_STATS
+        AllocatorStats m_stats = {};
+#endif
     };
 }
@@ -0,0 +1,845 @@
+// MIT License (see file: LICENSE)
+
+// Google Benchmark suite. Every workload runs against three allocators:
+// - OffsetAllocator::Allocator
+// - Malloc: plain malloc/free of the same sizes (no offset semantics, general purpose heap baseline)
+// - FirstFit: naive first-fit offset allocator (address ordered free list, linear search)
+// Churn also runs against HeapPool (quarter size heaps, grown on demand) and SlabAllocator (1/16 of the nodes).
+//
+// Benchmark argument 0 is maxAllocs (1K - 1M). Heaps hold maxAllocs / 2 live allocations.
+// Build with -DUSE_MANTISSA_BITS=4/5 to compare bin geometries (BM_FillUntilFull reports the size class waste).
+// Build with -DUSE_BIN_CACHE to compare the size -> bin cache (BM_RepeatedSizes, hit rates with USE_ALLOCATOR_STATS).
+// p99_ns counters sample every 16th operation with steady_clock (includes ~20ns timer overhead).
+
+#include "offsetAllocator.hpp"
+#include "offsetAllocatorConcurrent.hpp"
+#include "offsetAllocatorPartitioned.hpp"
+#include "offsetAllocatorPool.hpp"
+#include "offsetAllocatorSlab.hpp"
+#include "offsetAllocatorTrace.hpp"
+#include "offsetAllocatorWorkload.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <vector>
+
+using namespace OffsetAllocator;
+using namespace OffsetAllocator::Workload;
+
+namespace
+{
+    template<AllocationPolicy Policy = AllocationPolicy::BinHead>
+    struct OffsetAllocatorPolicy
+    {
+        typedef Allocation Handle;
+
+        OffsetAllocatorPolicy(Offset size, uint32 maxAllocs) : allocator(size, maxAllocs)
+        {
+            allocator.setAllocationPolicy(Policy);
+        }
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            handle = allocator.allocate(size);
+            return handle.offset != Allocation::NO_SPACE;
+        }
+        void free(Handle handle) { allocator.free(handle); }
+        void reset() { allocator.reset(); }
+        double fragmentation() const { return allocator.storageReport().fragmentation(); }
+
+        Allocator allocator;
+    };
+
+#ifdef USE_ALLOCATION_TRACE
+    // Tracing on. The ring is drained inline every 1024 allocations (stand-in for the consumer thread).
+    struct TracedOffsetAllocatorPolicy : OffsetAllocatorPolicy<>
+    {
+        TracedOffsetAllocatorPolicy(Offset size, uint32 maxAllocs) : OffsetAllocatorPolicy(size, maxAllocs), ring(4096)
+        {
+            allocator.setTrace(&ring);
+        }
+        ~TracedOffsetAllocatorPolicy() { allocator.setTrace(nullptr); }
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            if ((++allocations & 1023) == 0)
+            {
+                drained.clear();
+                ring.drain(drained);
+            }
+            return OffsetAllocatorPolicy::allocate(size, handle);
+        }
+
+        TraceRing ring;
+        std::vector<TraceRecord> drained;
+        uint32 allocations = 0;
+    };
+#endif
+
+    // Same total size and maxAllocs split into quarter heaps: Routing + summary overhead of HeapPool
+    struct HeapPoolPolicy
+    {
+        typedef PoolAllocation Handle;
+
+        HeapPoolPolicy(Offset size, uint32 maxAllocs) : pool(size / 4, maxAllocs / 4) {}
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            handle = pool.allocate(size);
+            return handle.heap != PoolAllocation::NO_HEAP;
+        }
+        void free(Handle handle) { pool.free(handle); }
+        double fragmentation() const { return pool.storageReport().fragmentation(); }
+
+        HeapPool pool;
+    };
+
+    // 4 partitions of a quarter each, requests rotate over the partitions (affinity of 4 nodes). Stealing on NO_SPACE.
+    struct PartitionedAllocatorPolicy
+    {
+        typedef PartitionAllocation Handle;
+
+        PartitionedAllocatorPolicy(Offset size, uint32 maxAllocs) :
+            descs{{size / 4, maxAllocs / 4}, {size / 4, maxAllocs / 4}, {size / 4, maxAllocs / 4}, {size / 4, maxAllocs / 4}},
+            partitions(descs) {}
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            handle = partitions.allocate(next++ & 3, size);
+            return handle.partition != PartitionAllocation::NO_PARTITION;
+        }
+        void free(Handle handle) { partitions.free(handle); }
+        double fragmentation() const { return partitions.storageReport().fragmentation(); }
+
+        PartitionDesc descs[4];
+        PartitionedAllocator partitions;
+        uint32 next = 0;
+    };
+
+    // Tiny sizes through slabs: The parent gets 1/16 of maxAllocs (slabs of 64 blocks need few nodes)
+    struct SlabAllocatorPolicy
+    {
+        typedef SlabAllocation Handle;
+
+        SlabAllocatorPolicy(Offset size, uint32 maxAllocs) : parent(size, maxAllocs / 16), slabs(parent, maxAllocs / 16) {}
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            handle = slabs.allocate(size);
+            return handle.allocation.offset != Allocation::NO_SPACE;
+        }
+        void free(Handle handle) { slabs.free(handle); }
+        double fragmentation() const { return parent.storageReport().fragmentation(); }
+
+        Allocator parent;
+        SlabAllocator slabs;
+    };
+
+    struct MallocPolicy
+    {
+        typedef void* Handle;
+
+        MallocPolicy(Offset, uint32) {}
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            handle = malloc(size);
+            return handle != nullptr;
+        }
+        void free(Handle handle) { ::free(handle); }
+    };
+
+    struct FirstFitPolicy
+    {
+        struct Handle
+        {
+            Offset offset;
+            Offset size;
+        };
+
+        FirstFitPolicy(Offset size, uint32) : m_size(size) { reset(); }
+
+        bool allocate(uint32 size, Handle& handle)
+        {
+            for (auto iter = m_freeRanges.begin(); iter != m_freeRanges.end(); ++iter)
+            {
+                if (iter->second < size) continue;
+
+                handle = {.offset = iter->first, .size = size};
+                Offset remainder = iter->second - size;
+                m_freeRanges.erase(iter);
+                if (remainder > 0) m_freeRanges.emplace(handle.offset + size, remainder);
+                return true;
+            }
+            return false;
+        }
+
+        void free(Handle handle)
+        {
+            Offset offset = handle.offset;
+            Offset size = handle.size;
+
+            // Merge with the next and the previous free range
+            auto next = m_freeRanges.lower_bound(offset);
+            if (next != m_freeRanges.end() && next->first == offset + size)
+            {
+                size += next->second;
+                next = m_freeRanges.erase(next);
+            }
+            if (next != m_freeRanges.begin())
+            {
+                auto prev = std::prev(next);
+                if (prev->first + prev->second == offset)
+                {
+                    prev->second += size;
+                    return;
+                }
+            }
+            m_freeRanges.emplace_hint(next, offset, size);
+        }
+
+        void reset()
+        {
+            m_freeRanges.clear();
+            m_freeRanges.emplace(0, m_size);
+        }
+
+        double fragmentation() const
+        {
+            Offset total = 0;
+            Offset largest = 0;
+            for (auto& range : m_freeRanges)
+            {
+                total += range.second;
+                largest = std::max(largest, range.second);
+            }
+            return total ? 1.0 - (double)largest / (double)total : 0.0;
+        }
+
+        Offset m_size;
+        std::map<Offset, Offset> m_freeRanges;
+    };
+
+    struct LatencySampler
+    {
+        static constexpr uint32 SAMPLE_INTERVAL = 16;
+
+        std::vector<double> samples;
+
+        double p99() const
+        {
+            if (samples.empty()) return 0.0;
+            std::vector<double> sorted = samples;
+            size_t index = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+            std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+            return sorted[index];
+        }
+
+        void report(benchmark::State& state) const
+        {
+            state.counters["p99_ns"] = benchmark::Counter(p99());
+        }
+    };
+
+    template<typename Operation>
+    void runSampled(benchmark::State& state, LatencySampler& sampler, uint32 opsPerIteration, Operation&& operation)
+    {
+        uint64 iteration = 0;
+        for (auto _ : state)
+        {
+            if ((iteration++ % LatencySampler::SAMPLE_INTERVAL) == 0)
+            {
+                auto start = std::chrono::steady_clock::now();
+                operation();
+                auto end = std::chrono::steady_clock::now();
+                sampler.samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / opsPerIteration);
+            }
+            else
+            {
+                operation();
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * opsPerIteration);
+        sampler.report(state);
+    }
+
+    // Random alloc/free churn: free a random live allocation, allocate a new one. 1 iteration = 2 ops.
+    template<typename Policy, SizeDistribution Distribution>
+    void BM_Churn(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        Policy policy(heapSize(maxAllocs, Distribution), maxAllocs);
+        Random random;
+
+        std::vector<typename Policy::Handle> live(maxAllocs / 2);
+        for (auto& handle : live)
+        {
+            if (!policy.allocate(nextSize(random, Distribution), handle))
+            {
+                state.SkipWithError("Prefill out of space");
+                return;
+            }
+        }
+
+        LatencySampler sampler;
+        runSampled(state, sampler, 2, [&]()
+        {
+            uint32 slot = random.next() % live.size();
+            policy.free(live[slot]);
+            policy.allocate(nextSize(random, Distribution), live[slot]);
+        });
+
+        // External fragmentation of the steady state heap (1 - largest free / total free)
+        if constexpr (requires { policy.fragmentation(); })
+            state.counters["fragmentation"] = policy.fragmentation();
+
+        for (auto& handle : live)
+            policy.free(handle);
+    }
+
+    // ConcurrentAllocator scaling: Every benchmark thread churns 64 live allocations of [64, 1072] elements through its
+    // own thread index. One shared allocator per run, sized for the run's thread count. 1 iteration = 2 ops per thread.
+    ConcurrentAllocator* concurrentAllocator = nullptr;
+
+    void setupConcurrentChurn(const benchmark::State& state)
+    {
+        concurrentAllocator = new ConcurrentAllocator(1024 * 1024 * 1024, 1024 * 1024, (uint32)state.threads());
+    }
+
+    void teardownConcurrentChurn(const benchmark::State&)
+    {
+        delete concurrentAllocator;
+        concurrentAllocator = nullptr;
+    }
+
+    void BM_ConcurrentChurn(benchmark::State& state)
+    {
+        ConcurrentAllocator& allocator = *concurrentAllocator;
+        uint32 threadIndex = (uint32)state.thread_index();
+
+        Allocation live[64];
+        for (uint32 i = 0; i < 64; i++)
+            live[i] = allocator.allocate(threadIndex, 64 + i * 16);
+
+        uint32 i = 0;
+        for (auto _ : state)
+        {
+            uint32 slot = (i * 2654435761u) >> 26;
+            allocator.free(threadIndex, live[slot]);
+            live[slot] = allocator.allocate(threadIndex, 64 + ((i * 7919) % 64) * 16);
+            i++;
+        }
+        state.SetItemsProcessed(state.iterations() * 2);
+
+        for (Allocation allocation : live)
+            allocator.free(threadIndex, allocation);
+    }
+
+    // Repeated sizes:maxAllocs / 2 live allocations, slot i always holds size class i % 8 (constant buffers, draw
+    // data, fixed size pools). Free a random slot, allocate its size again. 1 iteration = 2 ops. Freed nodes of the
+    // 8 sizes stay in their bins: The next request of that size finds its own round up bin non-empty.
+    // With USE_ALLOCATOR_STATS: bin_cache_hit = allocations that found their size in the bin cache (USE_BIN_CACHE),
+    // min_bin_hit = allocations served by the size's own round up bin (the USE_BIN_CACHE fast path).
+    template<typename Policy>
+    void BM_RepeatedSizes(benchmark::State& state)
+    {
+        static constexpr uint32 SIZES[] = {16, 64, 96, 256, 48, 1024, 200, 4096};
+
+        uint32 maxAllocs = (uint32)state.range(0);
+        Policy policy((Offset)maxAllocs * 1024, maxAllocs);
+        Random random;
+
+        std::vector<typename Policy::Handle> live(maxAllocs / 2);
+        for (size_t i = 0; i < live.size(); i++)
+            policy.allocate(SIZES[i % 8], live[i]);
+
+#ifdef USE_ALLOCATOR_STATS
+        if constexpr (requires { policy.allocator.resetStats(); })
+            policy.allocator.resetStats();
+#endif
+
+        LatencySampler sampler;
+        runSampled(state, sampler, 2, [&]()
+        {
+            uint32 slot = random.next() % live.size();
+            policy.free(live[slot]);
+            policy.allocate(SIZES[slot % 8], live[slot]);
+        });
+
+#ifdef USE_ALLOCATOR_STATS
+        if constexpr (requires { policy.allocator.stats(); })
+        {
+            const AllocatorStats& stats = policy.allocator.stats();
+            double allocations = (double)std::max<uint64>(stats.allocations, 1);
+            state.counters["bin_cache_hit"] = (double)stats.binCacheHits / allocations;
+            state.counters["min_bin_hit"] = (double)stats.minBinHits / allocations;
+        }
+#endif
+
+        for (auto& handle : live)
+            policy.free(handle);
+    }
+
+    // LIFO: allocate a run of 64, free it in reverse order on top of a half full heap. 1 iteration = 128 ops.
+    // FIFO: ring of maxAllocs / 2 allocations, free the oldest and allocate the newest. 1 iteration = 2 ops.
+    template<typename Policy, bool Lifo>
+    void BM_Order(benchmark::State& state)
+    {
+        static constexpr uint32 RUN_LENGTH = 64;
+
+        uint32 maxAllocs = (uint32)state.range(0);
+        Policy policy(heapSize(maxAllocs), maxAllocs);
+        Random random;
+
+        std::vector<typename Policy::Handle> live(maxAllocs / 2);
+        for (auto& handle : live)
+            policy.allocate(nextSize(random, SizeDistribution::Random), handle);
+
+        LatencySampler sampler;
+        if constexpr (Lifo)
+        {
+            typename Policy::Handle run[RUN_LENGTH];
+            runSampled(state, sampler, RUN_LENGTH * 2, [&]()
+            {
+                for (uint32 i = 0; i < RUN_LENGTH; i++)
+                    policy.allocate(nextSize(random, SizeDistribution::Random), run[i]);
+                for (uint32 i = RUN_LENGTH; i > 0; i--)
+                    policy.free(run[i - 1]);
+            });
+        }
+        else
+        {
+            size_t oldest = 0;
+            runSampled(state, sampler, 2, [&]()
+            {
+                policy.free(live[oldest]);
+                policy.allocate(nextSize(random, SizeDistribution::Random), live[oldest]);
+                oldest = (oldest + 1) % live.size();
+            });
+        }
+
+        for (auto& handle : live)
+            policy.free(handle);
+    }
+
+    // Batch API vs the scalar loop: 4096 items of [64, 4159] elements allocated and freed per iteration.
+    // Batch = one allocateBatch + one freeBatch, Scalar = allocate / free per item. 1 iteration = 8192 ops.
+    template<bool Batch>
+    void BM_Batch(benchmark::State& state)
+    {
+        static constexpr uint32 BATCH_SIZE = 4096;
+
+        Allocator allocator(1024 * 1024 * 256);
+        std::vector<Offset> sizes(BATCH_SIZE);
+        for (uint32 i = 0; i < BATCH_SIZE; i++)
+            sizes[i] = 64 + (i * 7919) % 4096;
+        std::vector<Allocation> allocations(BATCH_SIZE);
+
+        for (auto _ : state)
+        {
+            if constexpr (Batch)
+            {
+                allocator.allocateBatch(sizes, allocations.data());
+                allocator.freeBatch(allocations);
+            }
+            else
+            {
+                for (uint32 i = 0; i < BATCH_SIZE; i++)
+                    allocations[i] = allocator.allocate(sizes[i]);
+                for (uint32 i = 0; i < BATCH_SIZE; i++)
+                    allocator.free(allocations[i]);
+            }
+            benchmark::DoNotOptimize(allocator.m_freeStorage);
+        }
+        state.SetItemsProcessed(state.iterations() * BATCH_SIZE * 2);
+    }
+
+    // Worst case fragmentation: Checkerboard of 16 element allocations and 16 element holes.
+    // Requests of 32 elements fit none of the holes and must be served from the end of the heap.
+    template<typename Policy>
+    void BM_Fragmented(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        Policy policy(heapSize(maxAllocs), maxAllocs);
+
+        std::vector<typename Policy::Handle> handles(maxAllocs / 2);
+        for (auto& handle : handles)
+            policy.allocate(16, handle);
+        for (size_t i = 0; i < handles.size(); i += 2)
+            policy.free(handles[i]);
+
+        LatencySampler sampler;
+        runSampled(state, sampler, 2, [&]()
+        {
+            typename Policy::Handle handle;
+            policy.allocate(32, handle);
+            policy.free(handle);
+        });
+
+        for (size_t i = 1; i < handles.size(); i += 2)
+            policy.free(handles[i]);
+    }
+
+    // Size class waste: Random churn that grows the live set until the first allocation failure.
+    // utilization = live elements / storage size at the failure. Depends on the bin geometry (USE_MANTISSA_BITS).
+    template<typename Policy, SizeDistribution Distribution>
+    void BM_FillUntilFull(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        Offset size = (Offset)maxAllocs * 64;
+        double utilization = 0.0;
+
+        for (auto _ : state)
+        {
+            Policy policy(size, maxAllocs);
+            Random random;
+            std::vector<std::pair<typename Policy::Handle, uint32>> live;
+            Offset liveSize = 0;
+
+            for (uint32 i = 0; live.size() < maxAllocs * 3 / 4; i++)
+            {
+                if (i % 3 == 2)
+                {
+                    uint32 slot = random.next() % live.size();
+                    policy.free(live[slot].first);
+                    liveSize -= live[slot].second;
+                    live[slot] = live.back();
+                    live.pop_back();
+                    continue;
+                }
+
+                uint32 allocationSize = nextSize(random, Distribution);
+                typename Policy::Handle handle;
+                if (!policy.allocate(allocationSize, handle)) break;
+                live.push_back({handle, allocationSize});
+                liveSize += allocationSize;
+            }
+            utilization = (double)liveSize / (double)size;
+
+            for (auto& allocation : live)
+                policy.free(allocation.first);
+        }
+        state.counters["utilization"] = utilization;
+    }
+
+    // Frames in flight: Every frame allocates 1024 transient ranges and frees them with the frame fence.
+    // The GPU completes frame N - 2. Deferred = built-in freeDeferred/retire, Vectors = ring of pending vectors + freeBatch.
+    template<bool BuiltIn>
+    void BM_DeferredFree(benchmark::State& state)
+    {
+        static constexpr uint32 FRAMES_IN_FLIGHT = 3;
+        static constexpr uint32 ALLOCS_PER_FRAME = 1024;
+
+        Allocator allocator(1024 * 1024 * 256);
+        Random random;
+        std::vector<Allocation> pending[FRAMES_IN_FLIGHT];
+        uint64 frame = 0;
+
+        for (auto _ : state)
+        {
+            frame++;
+            if (frame >= FRAMES_IN_FLIGHT)
+            {
+                if constexpr (BuiltIn)
+                {
+                    allocator.retire(frame - FRAMES_IN_FLIGHT + 1);
+                }
+                else
+                {
+                    std::vector<Allocation>& retired = pending[frame % FRAMES_IN_FLIGHT];
+                    allocator.freeBatch(retired);
+                    retired.clear();
+                }
+            }
+
+            for (uint32 i = 0; i < ALLOCS_PER_FRAME; i++)
+            {
+                Allocation allocation = allocator.allocate(nextSize(random, SizeDistribution::Random));
+                if constexpr (BuiltIn) allocator.freeDeferred(allocation, frame);
+                else pending[frame % FRAMES_IN_FLIGHT].push_back(allocation);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * ALLOCS_PER_FRAME * 2);
+    }
+
+    // Mixed lifetimes: maxAllocs / 4 persistent allocations, every frame allocates maxAllocs / 4 transient ones
+    // and frees them at the frame end. Every 16th transient allocation also replaces a random persistent one.
+    // Mixed = everything through allocate. Split = transient through allocateHigh (grows down from the end).
+    // fragmentation = average of 1 - largest free / total free right after the transient frees (persistent only).
+    // Heap = maxAllocs * 96: ~67% full at the frame peak. 1 iteration = 1 frame.
+    template<bool Split>
+    void BM_MixedLifetimes(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        Allocator allocator((Offset)maxAllocs * 96, maxAllocs);
+        Random random;
+
+        std::vector<Allocation> persistent(maxAllocs / 4);
+        for (Allocation& allocation : persistent)
+            allocation = allocator.allocate(nextSize(random, SizeDistribution::Random));
+
+        std::vector<Allocation> transient(maxAllocs / 4);
+        double fragmentation = 0.0;
+        uint64 failed = 0;
+        for (auto _ : state)
+        {
+            for (uint32 i = 0; i < transient.size(); i++)
+            {
+                Offset size = nextSize(random, SizeDistribution::Random);
+                transient[i] = Split ? allocator.allocateHigh(size) : allocator.allocate(size);
+                if (transient[i].offset == Allocation::NO_SPACE) failed++;
+
+                if ((i % 16) == 0)
+                {
+                    Allocation& allocation = persistent[random.next() % persistent.size()];
+                    if (allocation.offset != Allocation::NO_SPACE) allocator.free(allocation);
+                    allocation = allocator.allocate(nextSize(random, SizeDistribution::Random));
+                    if (allocation.offset == Allocation::NO_SPACE) failed++;
+                }
+            }
+
+            for (Allocation allocation : transient)
+            {
+                if (allocation.offset != Allocation::NO_SPACE) allocator.free(allocation);
+            }
+            fragmentation += allocator.storageReport().fragmentation();
+        }
+        state.SetItemsProcessed(state.iterations() * (transient.size() * 2 + transient.size() / 16 * 2));
+        state.counters["fragmentation"] = fragmentation / (double)state.iterations();
+        state.counters["failed"] = benchmark::Counter((double)failed, benchmark::Counter::kAvgIterations);
+
+        for (Allocation allocation : persistent)
+        {
+            if (allocation.offset != Allocation::NO_SPACE) allocator.free(allocation);
+        }
+    }
+
+    // Growing buffers: 1024 dynamic buffers, each iteration grows a random one by 1/8 (reset to 64 elements
+    // past 64K). InPlace tries tryGrow first, Move always allocates a new range and frees the old one.
+    // copied = elements a real streaming system would copy per iteration (old size of every moved buffer).
+    template<bool InPlace>
+    void BM_GrowBuffers(benchmark::State& state)
+    {
+        static constexpr uint32 BUFFERS = 1024;
+
+        Allocator allocator(BUFFERS * 64 * 1024 * 2, BUFFERS * 4);
+        Random random;
+        std::vector<Allocation> buffers(BUFFERS);
+        for (Allocation& buffer : buffers)
+            buffer = allocator.allocate(64);
+
+        uint64 copied = 0;
+        for (auto _ : state)
+        {
+            Allocation& buffer = buffers[random.next() % BUFFERS];
+            Offset size = allocator.allocationSize(buffer);
+            Offset newSize = size >= 64 * 1024 ? 64 : size + size / 8;
+            if (newSize < size)
+            {
+                allocator.shrink(buffer, newSize);
+                continue;
+            }
+            if (InPlace && allocator.tryGrow(buffer, newSize)) continue;
+
+            Allocation moved = allocator.allocate(newSize);
+            if (moved.offset == Allocation::NO_SPACE)
+            {
+                state.SkipWithError("Out of space");
+                return;
+            }
+            copied += size;
+            allocator.free(buffer);
+            buffer = moved;
+        }
+        state.counters["copied"] = benchmark::Counter((double)copied, benchmark::Counter::kAvgIterations);
+
+        for (Allocation buffer : buffers)
+            allocator.free(buffer);
+    }
+
+    // reset() of a heap with 64 live allocations. Only the reset is timed. It stays flat in maxAllocs because the freelist is rebuilt lazily.
+    template<typename Policy>
+    void BM_Reset(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        Policy policy(heapSize(maxAllocs), maxAllocs);
+        Random random;
+
+        for (auto _ : state)
+        {
+            typename Policy::Handle handle;
+            for (uint32 i = 0; i < 64; i++)
+                policy.allocate(nextSize(random, SizeDistribution::Random), handle);
+
+            auto start = std::chrono::steady_clock::now();
+            policy.reset();
+            auto end = std::chrono::steady_clock::now();
+            state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+        }
+    }
+
+    // storageReportFull() of a heap fragmented by random churn
+    void BM_StorageReportFull(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        OffsetAllocatorPolicy<> policy(heapSize(maxAllocs), maxAllocs);
+        Random random;
+
+        std::vector<Allocation> live(maxAllocs / 2);
+        for (auto& handle : live)
+            policy.allocate(nextSize(random, SizeDistribution::Random), handle);
+        for (size_t i = 0; i < live.size(); i += 3)
+        {
+            policy.free(live[i]);
+            live[i] = {};
+        }
+
+        for (auto _ : state)
+        {
+            StorageReportFull report = policy.allocator.storageReportFull();
+            benchmark::DoNotOptimize(report);
+        }
+
+        for (auto& handle : live)
+            if (handle.offset != Allocation::NO_SPACE) policy.free(handle);
+    }
+
+    // Startup: Rebuild a 2GB heap with maxAllocs / 2 live allocations
+    // Replay = allocate every live range again (no snapshot), Load = loadSnapshot copy, InPlace = restoreSnapshotInPlace
+    enum class RestoreMode
+    {
+        Replay,
+        Load,
+        InPlace,
+    };
+
+    template<RestoreMode Mode>
+    void BM_Restore(benchmark::State& state)
+    {
+        uint32 maxAllocs = (uint32)state.range(0);
+        Offset size = 2u * 1024 * 1024 * 1024;
+        Random random;
+
+        std::vector<Offset> sizes(maxAllocs / 2);
+        for (auto& allocationSize : sizes)
+            allocationSize = nextSize(random, SizeDistribution::Random) * 16;
+
+        Allocator source(size, maxAllocs);
+        for (Offset allocationSize : sizes)
+            source.allocate(allocationSize);
+
+        size_t snapshotSize = source.snapshotSize();
+        void* snapshot = ::operator new[](snapshotSize, std::align_val_t(64));
+        source.saveSnapshot(snapshot);
+
+        for (auto _ : state)
+        {
+            if constexpr (Mode == RestoreMode::InPlace)
+            {
+                Allocator restored = Allocator::restoreSnapshotInPlace(snapshot, snapshotSize);
+                benchmark::DoNotOptimize(restored.m_freeStorage);
+            }
+            else
+            {
+                Allocator restored(size, maxAllocs);
+                if constexpr (Mode == RestoreMode::Load)
+                {
+                    restored.loadSnapshot(snapshot, snapshotSize);
+                }
+                else
+                {
+                    for (Offset allocationSize : sizes)
+                        restored.allocate(allocationSize);
+                }
+                benchmark::DoNotOptimize(restored.m_freeStorage);
+            }
+        }
+        state.counters["snapshot_bytes"] = (double)snapshotSize;
+
+        ::operator delete[](snapshot, std::align_val_t(64));
+    }
+}
+
+#define MAX_ALLOCS_RANGE RangeMultiplier(4)->Range(1 << 10, 1 << 20)
+
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<>, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<MallocPolicy, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<FirstFitPolicy, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<HeapPoolPolicy, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<PartitionedAllocatorPolicy, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<SlabAllocatorPolicy, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_ConcurrentChurn)->Setup(setupConcurrentChurn)->Teardown(teardownConcurrentChurn)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->Threads(16)->Threads(32)->UseRealTime();
+
+#ifdef USE_ALLOCATION_TRACE
+BENCHMARK(BM_Churn<TracedOffsetAllocatorPolicy, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+#endif
+
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<>, SizeDistribution::Pow2>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<MallocPolicy, SizeDistribution::Pow2>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<FirstFitPolicy, SizeDistribution::Pow2>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<SlabAllocatorPolicy, SizeDistribution::Pow2>)->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<>, SizeDistribution::Odd>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<MallocPolicy, SizeDistribution::Odd>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<FirstFitPolicy, SizeDistribution::Odd>)->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_RepeatedSizes<OffsetAllocatorPolicy<>>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_RepeatedSizes<MallocPolicy>)->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_Order<OffsetAllocatorPolicy<>, true>)->Name("BM_Lifo<OffsetAllocatorPolicy>")->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Order<MallocPolicy, true>)->Name("BM_Lifo<MallocPolicy>")->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Order<FirstFitPolicy, true>)->Name("BM_Lifo<FirstFitPolicy>")->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Order<SlabAllocatorPolicy, true>)->Name("BM_Lifo<SlabAllocatorPolicy>")->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_Order<OffsetAllocatorPolicy<>, false>)->Name("BM_Fifo<OffsetAllocatorPolicy>")->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Order<MallocPolicy, false>)->Name("BM_Fifo<MallocPolicy>")->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Order<FirstFitPolicy, false>)->Name("BM_Fifo<FirstFitPolicy>")->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_Batch<false>)->Name("BM_Batch<Scalar>");
+BENCHMARK(BM_Batch<true>)->Name("BM_Batch<Batch>");
+
+BENCHMARK(BM_Fragmented<OffsetAllocatorPolicy<>>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Fragmented<MallocPolicy>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Fragmented<FirstFitPolicy>)->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_FillUntilFull<OffsetAllocatorPolicy<>, SizeDistribution::Random>)->Arg(1 << 16)->Iterations(1);
+BENCHMARK(BM_FillUntilFull<FirstFitPolicy, SizeDistribution::Random>)->Arg(1 << 16)->Iterations(1);
+BENCHMARK(BM_FillUntilFull<OffsetAllocatorPolicy<>, SizeDistribution::Clustered>)->Arg(1 << 16)->Iterations(1);
+BENCHMARK(BM_FillUntilFull<FirstFitPolicy, SizeDistribution::Clustered>)->Arg(1 << 16)->Iterations(1);
+
+// Allocation policies (AllocationPolicy::BestFit, LowestAddress): Churn latency/fragmentation and fill utilization
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<AllocationPolicy::BestFit>, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<AllocationPolicy::LowestAddress>, SizeDistribution::Random>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<AllocationPolicy::BestFit>, SizeDistribution::Clustered>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<AllocationPolicy::LowestAddress>, SizeDistribution::Clustered>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Churn<OffsetAllocatorPolicy<>, SizeDistribution::Clustered>)->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_FillUntilFull<OffsetAllocatorPolicy<AllocationPolicy::BestFit>, SizeDistribution::Random>)->Arg(1 << 16)->Iterations(1);
+BENCHMARK(BM_FillUntilFull<OffsetAllocatorPolicy<AllocationPolicy::LowestAddress>, SizeDistribution::Random>)->Arg(1 << 16)->Iterations(1);
+BENCHMARK(BM_FillUntilFull<OffsetAllocatorPolicy<AllocationPolicy::BestFit>, SizeDistribution::Clustered>)->Arg(1 << 16)->Iterations(1);
+BENCHMARK(BM_FillUntilFull<OffsetAllocatorPolicy<AllocationPolicy::LowestAddress>, SizeDistribution::Clustered>)->Arg(1 << 16)->Iterations(1);
+
+BENCHMARK(BM_MixedLifetimes<false>)->Name("BM_MixedLifetimes<Mixed>")->Arg(1 << 12)->Arg(1 << 16);
+BENCHMARK(BM_MixedLifetimes<true>)->Name("BM_MixedLifetimes<Split>")->Arg(1 << 12)->Arg(1 << 16);
+
+BENCHMARK(BM_GrowBuffers<true>)->Name("BM_GrowBuffers<InPlace>");
+BENCHMARK(BM_GrowBuffers<false>)->Name("BM_GrowBuffers<Move>");
+
+BENCHMARK(BM_DeferredFree<true>)->Name("BM_DeferredFree<BuiltIn>");
+BENCHMARK(BM_DeferredFree<false>)->Name("BM_DeferredFree<Vectors>");
+
+BENCHMARK(BM_Reset<OffsetAllocatorPolicy<>>)->UseManualTime()->MAX_ALLOCS_RANGE;
+BENCHMARK(BM_Reset<FirstFitPolicy>)->UseManualTime()->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_StorageReportFull)->MAX_ALLOCS_RANGE;
+
+BENCHMARK(BM_Restore<RestoreMode::Replay>)->Name("BM_Restore<Replay>")->Arg(1 << 19)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Restore<RestoreMode::Load>)->Name("BM_Restore<Load>")->Arg(1 << 19)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Restore<RestoreMode::InPlace>)->Name("BM_Restore<InPlace>")->Arg(1 << 19)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,264 @@
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocatorConcurrent.hpp"
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+namespace OffsetAllocator
+{
+    namespace SmallFloat
+    {
+        extern uint32 uintToFloatRoundUp(Offset size);
+        extern Offset floatToUint(uint32 floatValue);
+    }
+
+    // FreeQueue...
+    void ConcurrentAllocator::FreeQueue::init(Cell* cells, uint32 size)
+    {
+        ASSERT((size & (size - 1)) == 0);
+        m_cells = cells;
+        m_mask = size - 1;
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+        m_dequeuePos = 0;
+
+        // Cell sequence == position: free for the producer of that position
+        for (uint32 i = 0; i < size; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool ConcurrentAllocator::FreeQueue::push(Allocation allocation)
+    {
+        uint32 pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            uint32 sequence = cell.sequence.load(std::memory_order_acquire);
+            int diff = (int)(sequence - pos);
+            if (diff == 0)
+            {
+                // Claim the position. On failure pos is reloaded and we retry.
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.allocation = allocation;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Full: consumer hasn't popped this cell yet
+                return false;
+            }
+            else
+            {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool ConcurrentAllocator::FreeQueue::pop(Allocation& allocation)
+    {
+        Cell& cell = m_cells[m_dequeuePos & m_mask];
+        uint32 sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != m_dequeuePos + 1) return false;
+
+        allocation = cell.allocation;
+
+        // Cell is free again for the producer one lap later
+        cell.sequence.store(m_dequeuePos + m_mask + 1, std::memory_order_release);
+        m_dequeuePos++;
+        return true;
+    }
+
+    // ConcurrentAllocator...
+    ConcurrentAllocator::ConcurrentAllocator(Offset size, uint32 maxAllocs, uint32 threadCount) :
+        m_allocator(size, maxAllocs),
+        m_threadCount(threadCount)
+    {
+        ASSERT(threadCount < NodeOwner::NONE);
+
+        m_caches = new ThreadCache[threadCount];
+        m_queueCells = new FreeQueue::Cell[threadCount * REMOTE_FREE_QUEUE_SIZE + SHARED_FREE_QUEUE_SIZE];
+        m_nodeOwners = new NodeOwner[maxAllocs];
+
+        for (uint32 i = 0; i < threadCount; i++)
+        {
+            for (uint32 j = 0; j < NUM_CACHED_BINS; j++)
+                m_caches[i].counts[j] = 0;
+            m_caches[i].remoteFrees.init(m_queueCells + i * REMOTE_FREE_QUEUE_SIZE, REMOTE_FREE_QUEUE_SIZE);
+        }
+        m_sharedFrees.init(m_queueCells + threadCount * REMOTE_FREE_QUEUE_SIZE, SHARED_FREE_QUEUE_SIZE);
+    }
+
+    ConcurrentAllocator::~ConcurrentAllocator()
+    {
+        delete[] m_caches;
+        delete[] m_queueCells;
+        delete[] m_nodeOwners;
+    }
+
+    Allocation ConcurrentAllocator::allocate(uint32 threadIndex, Offset size)
+    {
+        ASSERT(threadIndex < m_threadCount);
+
+        // Round up to the size class (bin). Every range in the stack fits.
+        uint32 binIndex = SmallFloat::uintToFloatRoundUp(size);
+        if (binIndex >= NUM_CACHED_BINS) return allocateUncached(size);
+
+        ThreadCache& cache = m_caches[threadIndex];
+        if (cache.counts[binIndex] == 0)
+        {
+            // Ranges freed by other threads first, then the shared allocator
+            drainRemoteFrees(threadIndex);
+            if (cache.counts[binIndex] == 0) refill(threadIndex, binIndex);
+            if (cache.counts[binIndex] == 0) return {};
+        }
+
+        return cache.ranges[binIndex][--cache.counts[binIndex]];
+    }
+
+    void ConcurrentAllocator::free(uint32 threadIndex, Allocation allocation)
+    {
+        ASSERT(threadIndex < m_threadCount);
+        if (allocation.offset == Allocation::NO_SPACE) return;
+
+        NodeOwner owner = m_nodeOwners[allocation.metadata];
+        if (owner.threadIndex == threadIndex)
+        {
+            // Local free: No synchronization
+            pushToCache(threadIndex, owner.binIndex, allocation);
+        }
+        else if (owner.threadIndex != NodeOwner::NONE)
+        {
+            // Remote free: Owner drains its queue when it runs empty
+            if (!m_caches[owner.threadIndex].remoteFrees.push(allocation))
+                releaseRanges(&allocation, 1);
+        }
+        else
+        {
+            // Uncached: Next shared lock holder frees it
+            if (!m_sharedFrees.push(allocation))
+                releaseRanges(&allocation, 1);
+        }
+    }
+
+    void ConcurrentAllocator::flushCaches()
+    {
+        for (uint32 i = 0; i < m_threadCount; i++)
+        {
+            drainRemoteFrees(i);
+
+            ThreadCache& cache = m_caches[i];
+            for (uint32 j = 0; j < NUM_CACHED_BINS; j++)
+            {
+                if (cache.counts[j] > 0) releaseRanges(cache.ranges[j], cache.counts[j]);
+                cache.counts[j] = 0;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        drainSharedFreesLocked();
+    }
+
+    StorageReport ConcurrentAllocator::storageReport()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_allocator.storageReport();
+    }
+
+    Allocation ConcurrentAllocator::allocateUncached(Offset size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        drainSharedFreesLocked();
+
+        Allocation allocation = m_allocator.allocate(size);
+        if (allocation.offset != Allocation::NO_SPACE)
+            m_nodeOwners[allocation.metadata] = {.threadIndex = NodeOwner::NONE, .binIndex = NodeOwner::NONE};
+        return allocation;
+    }
+
+    void ConcurrentAllocator::refill(uint32 threadIndex, uint32 binIndex)
+    {
+        // Carve the whole refill from one free node: one bin search for CACHE_REFILL_COUNT ranges
+        Offset sizes[CACHE_REFILL_COUNT];
+        Offset binSize = SmallFloat::floatToUint(binIndex);
+        for (uint32 i = 0; i < CACHE_REFILL_COUNT; i++)
+            sizes[i] = binSize;
+
+        ThreadCache& cache = m_caches[threadIndex];
+        Allocation* ranges = cache.ranges[binIndex];
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            drainSharedFreesLocked();
+            m_allocator.allocateBatch(sizes, ranges);
+
+            for (uint32 i = 0; i < CACHE_REFILL_COUNT; i++)
+            {
+                if (ranges[i].offset != Allocation::NO_SPACE)
+                    m_nodeOwners[ranges[i].metadata] = {.threadIndex = (uint16)threadIndex, .binIndex = (uint16)binIndex};
+            }
+        }
+
+        // Compact partial refills (out of space)
+        uint32 count = 0;
+        for (uint32 i = 0; i < CACHE_REFILL_COUNT; i++)
+        {
+            if (ranges[i].offset != Allocation::NO_SPACE)
+                ranges[count++] = ranges[i];
+        }
+        cache.counts[binIndex] = count;
+    }
+
+    void ConcurrentAllocator::drainRemoteFrees(uint32 threadIndex)
+    {
+        ThreadCache& cache = m_caches[threadIndex];
+        Allocation allocation;
+        while (cache.remoteFrees.pop(allocation))
+        {
+            pushToCache(threadIndex, m_nodeOwners[allocation.metadata].binIndex, allocation);
+        }
+    }
+
+    void ConcurrentAllocator::pushToCache(uint32 threadIndex, uint32 binIndex, Allocation allocation)
+    {
+        ThreadCache& cache = m_caches[threadIndex];
+        uint32& count = cache.counts[binIndex];
+        if (count == CACHE_CAPACITY)
+        {
+            // Full: Give the oldest half back to the shared allocator in one batch
+            releaseRanges(cache.ranges[binIndex], CACHE_REFILL_COUNT);
+            for (uint32 i = CACHE_REFILL_COUNT; i < CACHE_CAPACITY; i++)
+                cache.ranges[binIndex][i - CACHE_REFILL_COUNT] = cache.ranges[binIndex][i];
+            count -= CACHE_REFILL_COUNT;
+        }
+        cache.ranges[binIndex][count++] = allocation;
+    }
+
+    void ConcurrentAllocator::releaseRanges(const Allocation* allocations, uint32 count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        drainSharedFreesLocked();
+        m_allocator.freeBatch({allocations, count});
+    }
+
+    void ConcurrentAllocator::drainSharedFreesLocked()
+    {
+        // Free in batches so that neighbors coalesce before they hit the bins
+        Allocation batch[64];
+        uint32 count = 0;
+        while (m_sharedFrees.pop(batch[count]))
+        {
+            if (++count == 64)
+            {
+                m_allocator.freeBatch({batch, count});
+                count = 0;
+            }
+        }
+        if (count > 0) m_allocator.freeBatch({batch, count});
+    }
+}
@@ -0,0 +1,99 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+
+#include <atomic>
+#include <mutex>
+
+namespace OffsetAllocator
+{
+    // Thread safe front-end for Allocator
+    //
+    // Each worker thread owns a ThreadCache with small stacks of pre-carved ranges per size class.
+    // Size classes are the allocator leaf bins (SmallFloat round up). Empty stacks are refilled in bulk
+    // with Allocator::allocateBatch, so the shared lock is taken once per CACHE_REFILL_COUNT allocations.
+    //
+    // Every cached range remembers the cache that carved it (owner). Frees from the owner thread go straight
+    // to its stack. Frees from other threads are pushed to the owner's lock-free MPSC queue and the owner
+    // drains them when its stack runs empty. Uncached (large) ranges go through a shared MPSC queue that is
+    // drained by the next thread taking the shared lock.
+    class ConcurrentAllocator
+    {
+    public:
+        // Bins [0, NUM_CACHED_BINS) are cached: sizes below 65536 elements (112 bins with 3 bit mantissa)
+        static constexpr uint32 NUM_CACHED_BINS = (17 - MANTISSA_BITS) << MANTISSA_BITS;
+        static constexpr uint32 CACHE_CAPACITY = 32;
+        static constexpr uint32 CACHE_REFILL_COUNT = CACHE_CAPACITY / 2;
+        static constexpr uint32 REMOTE_FREE_QUEUE_SIZE = 1024;
+        static constexpr uint32 SHARED_FREE_QUEUE_SIZE = 4096;
+
+        // threadCount = number of worker thread indices. maxAllocs is shared by all threads.
+        ConcurrentAllocator(Offset size, uint32 maxAllocs = 128 * 1024, uint32 threadCount = 64);
+        ~ConcurrentAllocator();
+
+        // threadIndex: [0, threadCount). Each index must only be used by one thread at a time.
+        // Any index can free any allocation.
+        Allocation allocate(uint32 threadIndex, Offset size);
+        void free(uint32 threadIndex, Allocation allocation);
+
+        // Returns every cached range and every queued free to the shared allocator.
+        // NOT thread safe: Call when no worker is using the allocator.
+        void flushCaches();
+
+        // Cached ranges count as used
+        StorageReport storageReport();
+
+//    private:
+        // Bounded lock-free MPSC queue (Vyukov). Push from any thread, pop from a single consumer.
+        struct FreeQueue
+        {
+            struct Cell
+            {
+                std::atomic<uint32> sequence;
+                Allocation allocation;
+            };
+
+            void init(Cell* cells, uint32 size);
+            bool push(Allocation allocation);
+            bool pop(Allocation& allocation);
+
+            Cell* m_cells = nullptr;
+            uint32 m_mask = 0;
+            alignas(64) std::atomic<uint32> m_enqueuePos = 0;
+            alignas(64) uint32 m_dequeuePos = 0;
+        };
+
+        struct alignas(64) ThreadCache
+        {
+            uint32 counts[NUM_CACHED_BINS];
+            Allocation ranges[NUM_CACHED_BINS][CACHE_CAPACITY];
+            FreeQueue remoteFrees;
+        };
+
+        struct NodeOwner
+        {
+            static constexpr uint16 NONE = 0xffff;
+
+            uint16 threadIndex;
+            uint16 binIndex;
+        };
+
+        Allocation allocateUncached(Offset size);
+        void refill(uint32 threadIndex, uint32 binIndex);
+        void drainRemoteFrees(uint32 threadIndex);
+        void pushToCache(uint32 threadIndex, uint32 binIndex, Allocation allocation);
+        void releaseRanges(const Allocation* allocations, uint32 count);
+        void drainSharedFreesLocked();
+
+        Allocator m_allocator;
+        std::mutex m_mutex;
+
+        uint32 m_threadCount;
+        ThreadCache* m_caches;
+        FreeQueue::Cell* m_queueCells;
+        NodeOwner* m_nodeOwners;        // Cache that carved the node (indexed by Allocation::metadata)
+        FreeQueue m_sharedFrees;        // Consumer = shared lock holder
+    };
+}
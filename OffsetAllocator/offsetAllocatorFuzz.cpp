@@ -0,0 +1,552 @@
+// MIT License (see file: LICENSE)
+
+// Differential fuzzer: Operation sequences decoded from the input bytes run against Allocator and a reference
+// allocator (ordered map of free ranges, eagerly coalesced). After every operation Allocator::validate must pass
+// and the results must agree with the reference:
+// - Allocated ranges are free in the reference (in bounds, no overlap) and aligned as requested
+// - allocate / allocateHigh fail only when out of nodes or no free range covers the round up bin of the size
+// - tryGrow succeeds iff the range after the allocation is free, shrink iff a node or a free neighbor is there
+// - Defragment relocations move used ranges into free space and keep their alignment, updated handles keep the node index
+// - m_freeStorage = reference free space, storageReport largest free region = bin of the largest free range
+//
+// Clang: libFuzzer target (cmake option OFFSET_ALLOCATOR_FUZZ, -fsanitize=fuzzer,address).
+//   offsetAllocatorFuzz corpus/
+// Other compilers: Standalone driver feeding random inputs. Files given on the command line are replayed instead.
+//   offsetAllocatorFuzz [--runs N] [--seed N] [--length N] [input files...]
+// A failure prints the broken invariant and aborts. The standalone driver saves the input to offsetAllocatorFuzz.crash.
+//
+// The allocator sources are compiled into the fuzzer with DEBUG: Internal ASSERTs are checked too.
+
+#include "offsetAllocator.hpp"
+#include "offsetAllocatorWorkload.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace OffsetAllocator;
+
+namespace OffsetAllocator
+{
+    namespace SmallFloat
+    {
+        extern uint32 uintToFloatRoundUp(Offset size);
+        extern uint32 uintToFloatRoundDown(Offset size);
+        extern Offset floatToUint(uint32 floatValue);
+    }
+}
+
+namespace
+{
+    // Current input: Saved by the standalone driver on failure
+    const uint8* s_input = nullptr;
+    size_t s_inputSize = 0;
+    const char* s_crashPath = nullptr;
+
+    [[noreturn]] void fail(const char* message, uint32 operation)
+    {
+        fprintf(stderr, "offsetAllocatorFuzz: %s (operation %u)\n", message, operation);
+        if (s_crashPath)
+        {
+            if (FILE* file = fopen(s_crashPath, "wb"))
+            {
+                fwrite(s_input, 1, s_inputSize, file);
+                fclose(file);
+                fprintf(stderr, "Input saved to %s\n", s_crashPath);
+            }
+        }
+        abort();
+    }
+
+    // Input bytes, zeros after the end
+    struct Input
+    {
+        const uint8* data;
+        size_t size;
+        size_t position = 0;
+
+        bool empty() const { return position >= size; }
+        uint8 u8() { return position < size ? data[position++] : 0; }
+        uint32 u32()
+        {
+            uint32 value = 0;
+            for (uint32 i = 0; i < 4; i++)
+                value |= (uint32)u8() << (i * 8);
+            return value;
+        }
+
+        // Mostly small sizes, up to 1MB
+        Offset size1()
+        {
+            uint32 bits = u8() % 21;
+            return 1 + u32() % (1u << bits);
+        }
+    };
+
+    // First fit free list: Free ranges keyed by offset, neighbors always coalesced
+    struct ReferenceAllocator
+    {
+        std::map<Offset, Offset> freeRanges;
+        Offset size = 0;
+        Offset freeStorage = 0;
+
+        void reset(Offset storageSize)
+        {
+            freeRanges.clear();
+            size = storageSize;
+            freeStorage = 0;
+            release(0, storageSize);
+        }
+
+        // [offset, offset + rangeSize) inside a single free range
+        bool isFree(Offset offset, Offset rangeSize) const
+        {
+            auto range = freeRanges.upper_bound(offset);
+            if (range == freeRanges.begin()) return false;
+            --range;
+            return offset + rangeSize <= range->first + range->second && offset + rangeSize >= offset;
+        }
+
+        void take(Offset offset, Offset rangeSize)
+        {
+            auto range = --freeRanges.upper_bound(offset);
+            Offset rangeOffset = range->first;
+            Offset rangeEnd = range->first + range->second;
+            freeRanges.erase(range);
+            if (offset > rangeOffset) freeRanges[rangeOffset] = offset - rangeOffset;
+            if (rangeEnd > offset + rangeSize) freeRanges[offset + rangeSize] = rangeEnd - (offset + rangeSize);
+            freeStorage -= rangeSize;
+        }
+
+        void release(Offset offset, Offset rangeSize)
+        {
+            if (rangeSize == 0) return;
+            freeStorage += rangeSize;
+
+            auto next = freeRanges.lower_bound(offset);
+            if (next != freeRanges.end() && next->first == offset + rangeSize)
+            {
+                rangeSize += next->second;
+                next = freeRanges.erase(next);
+            }
+            if (next != freeRanges.begin())
+            {
+                auto prev = std::prev(next);
+                if (prev->first + prev->second == offset)
+                {
+                    prev->second += rangeSize;
+                    return;
+                }
+            }
+            freeRanges[offset] = rangeSize;
+        }
+
+        Offset largest() const
+        {
+            Offset largestSize = 0;
+            for (auto& range : freeRanges)
+                largestSize = range.second > largestSize ? range.second : largestSize;
+            return largestSize;
+        }
+    };
+
+    struct LiveAllocation
+    {
+        Allocation allocation;
+        Offset size;
+        Offset alignment;
+    };
+
+    // Mirrors the allocator's deferred fence ring: Overflow merges into the newest segment
+    struct DeferredSegment
+    {
+        uint64 fence;
+        std::vector<LiveAllocation> allocations;
+    };
+
+    static constexpr uint32 MAX_DEFERRED_FENCES = 16;
+    static constexpr uint32 MAX_OPERATIONS = 4096;
+
+    class Fuzzer
+    {
+    public:
+        Fuzzer(const uint8* data, size_t size) :
+            m_input{.data = data, .size = size},
+            m_allocator(64 << (m_input.u8() % 14), 4 << (m_input.u8() % 9))
+        {
+            m_reference.reset(m_allocator.m_size);
+            m_allocator.setAllocationPolicy((AllocationPolicy)(m_input.u8() % 3));
+        }
+
+        void run()
+        {
+            check();
+            while (!m_input.empty() && m_operation < MAX_OPERATIONS)
+            {
+                m_operation++;
+                step();
+                check();
+            }
+
+            // Everything back: validate requires free neighbors merged, so one free node covering the storage
+            releaseAll();
+            check();
+        }
+
+    private:
+        void step()
+        {
+            uint32 operation = m_input.u8() % 24;
+            switch (operation)
+            {
+            case 0: case 1: case 2: case 3:
+                allocate(m_input.size1());
+                break;
+            case 4:
+            {
+                Offset size = m_input.size1();
+                allocateAligned(size, (Offset)1 << (m_input.u8() % 10));
+                break;
+            }
+            case 5:
+                allocateHigh(m_input.size1());
+                break;
+            case 6: case 7: case 8:
+                if (!m_live.empty()) free(takeLive());
+                break;
+            case 9:
+                if (!m_live.empty()) freeDeferred(takeLive());
+                break;
+            case 10:
+                retire(m_completedFence + m_input.u8() % 4);
+                break;
+            case 11:
+                allocateBatch(1 + m_input.u8() % 8);
+                break;
+            case 12:
+                freeBatch(1 + m_input.u8() % 8);
+                break;
+            case 13: case 14:
+                if (!m_live.empty())
+                {
+                    uint32 index = m_input.u32() % (uint32)m_live.size();
+                    if (operation == 13) tryGrow(index, m_input.size1());
+                    else shrink(index, m_input.u32());
+                }
+                break;
+            case 15:
+            {
+                uint32 count = 1 + m_input.u8() % 8;
+                defragment(count, m_input.u8() < 128 ? ~(Offset)0 : m_input.size1());
+                break;
+            }
+            case 16:
+                growStorage(m_input.u32() % 4096);
+                break;
+            case 17:
+                growNodes(4 + m_input.u32() % 2048);
+                break;
+            case 18:
+                m_allocator.setAllocationPolicy((AllocationPolicy)(m_input.u8() % 3));
+                break;
+            case 19: case 20: case 21: case 22:
+                allocate(1 + m_input.u8() % 64);
+                break;
+            default:
+                if (m_input.u8() < 16) reset();
+                break;
+            }
+        }
+
+        void check()
+        {
+            if (const char* error = m_allocator.validate()) fail(error, m_operation);
+            if (m_allocator.m_size != m_reference.size) fail("storage size differs from the reference", m_operation);
+            if (m_allocator.m_freeStorage != m_reference.freeStorage) fail("free storage differs from the reference", m_operation);
+
+            // Out of nodes reports zero free space
+            StorageReport report = m_allocator.storageReport();
+            Offset largest = m_reference.largest();
+            Offset expected = m_allocator.m_freeOffset == 0 || largest == 0 ? 0 : SmallFloat::floatToUint(SmallFloat::uintToFloatRoundDown(largest));
+            if (report.largestFreeRegion != expected) fail("largest free region differs from the reference", m_operation);
+        }
+
+        // Result of a successful allocate of size bytes: Must be free in the reference
+        void accept(Allocation allocation, Offset size, Offset alignment = 1)
+        {
+            if (allocation.offset % alignment != 0) fail("misaligned allocation", m_operation);
+            if (!m_reference.isFree(allocation.offset, size)) fail("allocation overlaps a used range or the end", m_operation);
+            if (m_allocator.allocationSize(allocation) != size) fail("allocation size differs", m_operation);
+            m_reference.take(allocation.offset, size);
+            m_live.push_back({.allocation = allocation, .size = size, .alignment = alignment});
+        }
+
+        // allocate / allocateHigh: A free range of the round up bin size or more always fits
+        bool mustFit(Offset size, bool nodesAvailable) const
+        {
+            uint32 binIndex = SmallFloat::uintToFloatRoundUp(size);
+            return nodesAvailable && binIndex < NUM_LEAF_BINS && m_reference.largest() >= SmallFloat::floatToUint(binIndex);
+        }
+
+        void allocate(Offset size)
+        {
+            bool nodesAvailable = m_allocator.m_freeOffset > 0;
+            Allocation allocation = m_allocator.allocate(size);
+            if (allocation.offset != Allocation::NO_SPACE) accept(allocation, size);
+            else if (mustFit(size, nodesAvailable)) fail("allocate failed with a fitting free range", m_operation);
+        }
+
+        void allocateAligned(Offset size, Offset alignment)
+        {
+            Allocation allocation = m_allocator.allocate(size, alignment);
+            if (allocation.offset != Allocation::NO_SPACE) accept(allocation, size, alignment);
+        }
+
+        void allocateHigh(Offset size)
+        {
+            bool nodesAvailable = m_allocator.m_freeOffset > 0;
+            Allocation allocation = m_allocator.allocateHigh(size);
+            if (allocation.offset != Allocation::NO_SPACE) accept(allocation, size);
+            else if (mustFit(size, nodesAvailable)) fail("allocateHigh failed with a fitting free range", m_operation);
+        }
+
+        LiveAllocation takeLive()
+        {
+            uint32 index = m_input.u32() % (uint32)m_live.size();
+            LiveAllocation live = m_live[index];
+            m_live[index] = m_live.back();
+            m_live.pop_back();
+            return live;
+        }
+
+        void free(LiveAllocation live)
+        {
+            m_allocator.free(live.allocation);
+            m_reference.release(live.allocation.offset, live.size);
+        }
+
+        void freeDeferred(LiveAllocation live)
+        {
+            m_fence += m_input.u8() % 2;
+            m_allocator.freeDeferred(live.allocation, m_fence);
+            if (!m_deferred.empty() && (m_deferred.back().fence == m_fence || m_deferred.size() == MAX_DEFERRED_FENCES))
+            {
+                m_deferred.back().fence = m_fence;
+                m_deferred.back().allocations.push_back(live);
+            }
+            else
+            {
+                m_deferred.push_back({.fence = m_fence, .allocations = {live}});
+            }
+        }
+
+        void retire(uint64 completedFence)
+        {
+            m_completedFence = completedFence > m_completedFence ? completedFence : m_completedFence;
+            m_allocator.retire(completedFence);
+            while (!m_deferred.empty() && m_deferred.front().fence <= completedFence)
+            {
+                for (LiveAllocation& live : m_deferred.front().allocations)
+                    m_reference.release(live.allocation.offset, live.size);
+                m_deferred.erase(m_deferred.begin());
+            }
+        }
+
+        void allocateBatch(uint32 count)
+        {
+            Offset sizes[8];
+            Allocation allocations[8];
+            for (uint32 i = 0; i < count; i++)
+            {
+                uint32 bits = m_input.u8() % 13;
+                sizes[i] = 1 + m_input.u32() % (1u << bits);
+            }
+
+            bool success = m_allocator.allocateBatch(std::span(sizes, count), allocations);
+            bool allAllocated = true;
+            for (uint32 i = 0; i < count; i++)
+            {
+                if (allocations[i].offset != Allocation::NO_SPACE) accept(allocations[i], sizes[i]);
+                else allAllocated = false;
+            }
+            if (success != allAllocated) fail("allocateBatch result doesn't match the items", m_operation);
+        }
+
+        void freeBatch(uint32 count)
+        {
+            Allocation allocations[8];
+            uint32 batchCount = 0;
+            for (; batchCount < count && !m_live.empty(); batchCount++)
+            {
+                LiveAllocation live = takeLive();
+                allocations[batchCount] = live.allocation;
+                m_reference.release(live.allocation.offset, live.size);
+            }
+            m_allocator.freeBatch(std::span(allocations, batchCount));
+        }
+
+        void tryGrow(uint32 index, Offset newSize)
+        {
+            LiveAllocation& live = m_live[index];
+            Offset end = live.allocation.offset + live.size;
+            bool expected = newSize <= live.size || m_reference.isFree(end, newSize - live.size);
+            if (m_allocator.tryGrow(live.allocation, newSize) != expected) fail("tryGrow result differs from the reference", m_operation);
+            if (expected && newSize > live.size)
+            {
+                m_reference.take(end, newSize - live.size);
+                live.size = newSize;
+            }
+        }
+
+        void shrink(uint32 index, uint32 random)
+        {
+            LiveAllocation& live = m_live[index];
+            Offset newSize = 1 + random % (live.size + 1);
+            Offset end = live.allocation.offset + live.size;
+            bool expected = newSize >= live.size || m_allocator.m_freeOffset > 0 || m_reference.isFree(end, 1);
+            if (m_allocator.shrink(live.allocation, newSize) != expected) fail("shrink result differs from the reference", m_operation);
+            if (expected && newSize < live.size)
+            {
+                m_reference.release(live.allocation.offset + newSize, live.size - newSize);
+                live.size = newSize;
+            }
+        }
+
+        void defragment(uint32 count, Offset byteBudget)
+        {
+            Relocation relocations[8];
+            uint32 relocationCount = m_allocator.defragment(std::span(relocations, count), byteBudget);
+            if (relocationCount > count) fail("defragment overflowed the relocation span", m_operation);
+
+            for (uint32 i = 0; i < relocationCount; i++)
+            {
+                const Relocation& relocation = relocations[i];
+                auto live = std::find_if(m_live.begin(), m_live.end(), [&](const LiveAllocation& item) {
+                    return item.allocation.metadata == relocation.allocation.metadata;
+                });
+                if (live == m_live.end() || live->allocation.offset != relocation.oldOffset || live->size != relocation.size)
+                    fail("relocation of an unknown or deferred allocation", m_operation);
+                if (relocation.allocation.offset != relocation.newOffset) fail("relocation handle differs from the new offset", m_operation);
+                if (relocation.newOffset % live->alignment != 0) fail("relocation loses the alignment", m_operation);
+
+                // In order, memmove semantics
+                m_reference.release(relocation.oldOffset, relocation.size);
+                if (!m_reference.isFree(relocation.newOffset, relocation.size)) fail("relocation into a used range", m_operation);
+                m_reference.take(relocation.newOffset, relocation.size);
+                live->allocation = relocation.allocation;
+            }
+        }
+
+        void growStorage(Offset additionalSize)
+        {
+            Offset size = m_reference.size;
+            bool expected = additionalSize == 0 || m_allocator.m_freeOffset > 0 || m_reference.isFree(size - 1, 1);
+            if (m_allocator.growStorage(additionalSize) != expected) fail("growStorage result differs from the reference", m_operation);
+            if (expected)
+            {
+                m_reference.size += additionalSize;
+                m_reference.release(size, additionalSize);
+            }
+        }
+
+        void growNodes(uint32 newMaxAllocs)
+        {
+            bool expected = sizeof(NodeIndex) != 2 || newMaxAllocs <= 65536 || newMaxAllocs <= m_allocator.m_maxAllocs;
+            if (m_allocator.growNodes(newMaxAllocs) != expected) fail("growNodes result differs", m_operation);
+        }
+
+        void reset()
+        {
+            m_allocator.reset();
+            m_reference.reset(m_reference.size);
+            m_live.clear();
+            m_deferred.clear();
+        }
+
+        void releaseAll()
+        {
+            while (!m_live.empty())
+                free(takeLive());
+            retire(~0ull);
+        }
+
+        Input m_input;
+        Allocator m_allocator;
+        ReferenceAllocator m_reference;
+        std::vector<LiveAllocation> m_live;
+        std::vector<DeferredSegment> m_deferred;
+        uint64 m_fence = 1;
+        uint64 m_completedFence = 0;
+        uint32 m_operation = 0;
+    };
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    s_input = data;
+    s_inputSize = size;
+    Fuzzer(data, size).run();
+    return 0;
+}
+
+#ifndef OFFSET_ALLOCATOR_LIBFUZZER
+int main(int argc, char** argv)
+{
+    uint32 runs = 1000;
+    uint32 seed = 0x12345678;
+    uint32 length = 4096;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(argv[i], "--runs") && value) runs = (uint32)strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--seed") && value) seed = (uint32)strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--length") && value) length = (uint32)strtoul(argv[++i], nullptr, 10);
+        else if (argv[i][0] != '-') files.push_back(argv[i]);
+        else
+        {
+            fprintf(stderr, "Usage: %s [--runs N] [--seed N (non-zero)] [--length N] [input files...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<uint8> input;
+    for (const char* path : files)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file)
+        {
+            fprintf(stderr, "Can't open %s\n", path);
+            return 1;
+        }
+        input.clear();
+        uint8 buffer[4096];
+        for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0; )
+            input.insert(input.end(), buffer, buffer + read);
+        fclose(file);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    if (!files.empty())
+    {
+        printf("%zu inputs passed\n", files.size());
+        return 0;
+    }
+
+    // Random inputs of random length: Short sequences hit the start states, long ones fragment
+    s_crashPath = "offsetAllocatorFuzz.crash";
+    Workload::Random random{.state = seed};
+    for (uint32 run = 0; run < runs; run++)
+    {
+        input.resize(1 + random.next() % length);
+        for (uint8& byte : input)
+            byte = (uint8)random.next();
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    printf("%u runs passed (seed %u)\n", runs, seed);
+    return 0;
+}
+#endif
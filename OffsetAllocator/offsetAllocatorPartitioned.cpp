@@ -0,0 +1,174 @@
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocatorPartitioned.hpp"
+
+#include <algorithm>
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+namespace OffsetAllocator
+{
+    namespace SmallFloat
+    {
+        extern uint32 uintToFloatRoundUp(Offset size);
+    }
+
+    PartitionedAllocator::PartitionedAllocator(std::span<const PartitionDesc> partitions, PartitionMemory* memory) :
+        m_partitions(partitions.size()),
+        m_memory(memory)
+    {
+        uint32 count = (uint32)partitions.size();
+        for (uint32 i = 0; i < count; i++)
+        {
+            Partition& partition = m_partitions[i];
+            const PartitionDesc& desc = partitions[i];
+            if (m_memory)
+            {
+                partition.metadataSize = Allocator::requiredMemorySize(desc.maxAllocs);
+                partition.metadata = m_memory->allocateMetadata(i, partition.metadataSize);
+                ASSERT(((size_t)partition.metadata & 63) == 0);
+            }
+
+            if (partition.metadata) partition.allocator.emplace(desc.size, desc.maxAllocs, partition.metadata);
+            else partition.allocator.emplace(desc.size, desc.maxAllocs);
+
+            // Default steal order: The next partitions round robin
+            for (uint32 j = 1; j < count; j++)
+                partition.stealOrder.push_back((i + j) % count);
+        }
+    }
+
+    PartitionedAllocator::~PartitionedAllocator()
+    {
+        for (uint32 i = 0; i < m_partitions.size(); i++)
+        {
+            Partition& partition = m_partitions[i];
+            partition.allocator.reset();
+            if (partition.metadata) m_memory->freeMetadata(i, partition.metadata, partition.metadataSize);
+        }
+    }
+
+    PartitionAllocation PartitionedAllocator::allocate(uint32 partition, Offset size)
+    {
+        return allocateRouted(partition, size, [size](Allocator& heap) { return heap.allocate(size); });
+    }
+
+    PartitionAllocation PartitionedAllocator::allocate(uint32 partition, Offset size, Offset alignment)
+    {
+        ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        if (size > Allocation::NO_SPACE - (alignment - 1))
+        {
+            ASSERT(partition < m_partitions.size());
+            m_partitions[partition].stats.failedAllocations++;
+            return {};
+        }
+        return allocateRouted(partition, size + alignment - 1, [size, alignment](Allocator& heap) { return heap.allocate(size, alignment); });
+    }
+
+    template<typename AllocateFunction>
+    PartitionAllocation PartitionedAllocator::allocateRouted(uint32 partitionIndex, Offset size, AllocateFunction&& allocateFunction)
+    {
+        ASSERT(partitionIndex < m_partitions.size());
+        Partition& local = m_partitions[partitionIndex];
+        Allocation allocation = allocateFunction(*local.allocator);
+        if (allocation.offset != Allocation::NO_SPACE)
+        {
+            local.stats.localAllocations++;
+            return {.partition = partitionIndex, .allocation = allocation};
+        }
+
+        // Steal: Only candidates with a free node in the size's top bin or above can fit (leaf bins may still miss)
+        uint32 topBinIndex = SmallFloat::uintToFloatRoundUp(size) >> TOP_BINS_INDEX_SHIFT;
+        if (topBinIndex < NUM_TOP_BINS)
+        {
+            for (uint32 victimIndex : local.stealOrder)
+            {
+                Allocator& victim = *m_partitions[victimIndex].allocator;
+                if ((victim.m_usedBinsTop >> topBinIndex) == 0) continue;
+
+                allocation = allocateFunction(victim);
+                if (allocation.offset != Allocation::NO_SPACE)
+                {
+                    local.stats.stolenAllocations++;
+                    return {.partition = victimIndex, .allocation = allocation};
+                }
+            }
+        }
+
+        local.stats.failedAllocations++;
+        return {};
+    }
+
+    void PartitionedAllocator::free(PartitionAllocation allocation)
+    {
+        if (allocation.partition == PartitionAllocation::NO_PARTITION) return;
+        ASSERT(allocation.partition < m_partitions.size());
+
+        m_partitions[allocation.partition].allocator->free(allocation.allocation);
+    }
+
+    void PartitionedAllocator::setDistances(std::span<const uint32> distances)
+    {
+        uint32 count = (uint32)m_partitions.size();
+        ASSERT(distances.size() == (size_t)count * count);
+
+        for (uint32 i = 0; i < count; i++)
+        {
+            const uint32* row = &distances[(size_t)i * count];
+            std::vector<uint32>& order = m_partitions[i].stealOrder;
+            order.clear();
+            for (uint32 j = 0; j < count; j++)
+            {
+                if (j != i && row[j] != UNREACHABLE) order.push_back(j);
+            }
+            std::stable_sort(order.begin(), order.end(), [row](uint32 a, uint32 b) { return row[a] < row[b]; });
+        }
+    }
+
+    void PartitionedAllocator::setStealOrder(uint32 partition, std::span<const uint32> order)
+    {
+        ASSERT(partition < m_partitions.size());
+        for (uint32 victimIndex : order)
+        {
+            ASSERT(victimIndex < m_partitions.size() && victimIndex != partition);
+            (void)victimIndex;
+        }
+        m_partitions[partition].stealOrder.assign(order.begin(), order.end());
+    }
+
+    std::span<const uint32> PartitionedAllocator::stealOrder(uint32 partition) const
+    {
+        ASSERT(partition < m_partitions.size());
+        return m_partitions[partition].stealOrder;
+    }
+
+    void PartitionedAllocator::reset()
+    {
+        for (Partition& partition : m_partitions)
+            partition.allocator->reset();
+    }
+
+    Offset PartitionedAllocator::allocationSize(PartitionAllocation allocation) const
+    {
+        if (allocation.partition == PartitionAllocation::NO_PARTITION) return 0;
+        return m_partitions[allocation.partition].allocator->allocationSize(allocation.allocation);
+    }
+
+    StorageReport PartitionedAllocator::storageReport() const
+    {
+        StorageReport report = {};
+        for (const Partition& partition : m_partitions)
+        {
+            StorageReport partitionReport = partition.allocator->storageReport();
+            report.totalFreeSpace += partitionReport.totalFreeSpace;
+            if (partitionReport.largestFreeRegion > report.largestFreeRegion)
+                report.largestFreeRegion = partitionReport.largestFreeRegion;
+        }
+        return report;
+    }
+}
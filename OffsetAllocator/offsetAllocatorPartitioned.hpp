@@ -0,0 +1,107 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace OffsetAllocator
+{
+    // Allocation of a PartitionedAllocator: Partition index + the allocation inside that partition's heap
+    struct PartitionAllocation
+    {
+        static constexpr uint32 NO_PARTITION = 0xffffffff;
+
+        uint32 partition = NO_PARTITION;
+        Allocation allocation = {};
+    };
+
+    // Metadata memory of the partitions, e.g. numa_alloc_onnode / VirtualAllocExNuma on the partition's NUMA node.
+    // size = Allocator::requiredMemorySize(maxAllocs). The memory must be 64 byte aligned.
+    // Only called from the PartitionedAllocator constructor (allocate) and destructor (free).
+    class PartitionMemory
+    {
+    public:
+        // nullptr: The partition's Allocator allocates its node arrays on the heap
+        virtual void* allocateMetadata(uint32 partition, size_t size) = 0;
+        virtual void freeMetadata(uint32 partition, void* memory, size_t size) = 0;
+
+    protected:
+        ~PartitionMemory() = default;
+    };
+
+    struct PartitionDesc
+    {
+        Offset size;
+        uint32 maxAllocs = 128 * 1024;
+    };
+
+    struct PartitionStats
+    {
+        uint64 localAllocations;        // Served by the requested partition
+        uint64 stolenAllocations;       // Requested partition out of space, served by its steal order
+        uint64 failedAllocations;       // No partition of the steal order had space
+    };
+
+    // One heap per device / NUMA node behind a single front-end
+    //
+    // Each partition is an independent Allocator over its own offset range. Its node arrays and freelist (the
+    // allocate / free metadata) come from PartitionMemory, so they can live on the partition's node. allocate(partition,
+    // size) goes to the requested partition first. On NO_SPACE it steals from the partition's steal order: By distance
+    // (setDistances, e.g. numa_distance or the device link topology), by default the next indices round robin.
+    // The top bin mask of a steal candidate skips it without an allocate when it has no free node large enough.
+    // An empty steal order disables stealing (e.g. device memory the other devices can't access).
+    //
+    // Single threaded like Allocator: One control thread makes every call. free is O(1): The handle has the partition.
+    class PartitionedAllocator
+    {
+    public:
+        static constexpr uint32 UNREACHABLE = 0xffffffff;
+
+        // memory = nullptr: Node arrays on the heap (no placement)
+        PartitionedAllocator(std::span<const PartitionDesc> partitions, PartitionMemory* memory = nullptr);
+        ~PartitionedAllocator();
+        PartitionedAllocator(const PartitionedAllocator&) = delete;
+        PartitionedAllocator& operator=(const PartitionedAllocator&) = delete;
+
+        PartitionAllocation allocate(uint32 partition, Offset size);
+        PartitionAllocation allocate(uint32 partition, Offset size, Offset alignment);
+        void free(PartitionAllocation allocation);
+
+        // partitionCount x partitionCount, row = requesting partition. Each steal order becomes the other partitions
+        // by ascending distance, lower index first on ties. UNREACHABLE partitions are never stolen from.
+        void setDistances(std::span<const uint32> distances);
+        void setStealOrder(uint32 partition, std::span<const uint32> order);
+        std::span<const uint32> stealOrder(uint32 partition) const;
+
+        // Resets every partition. Stats are kept.
+        void reset();
+
+        uint32 partitionCount() const { return (uint32)m_partitions.size(); }
+        const Allocator& partition(uint32 partitionIndex) const { return *m_partitions[partitionIndex].allocator; }
+        const PartitionStats& stats(uint32 partitionIndex) const { return m_partitions[partitionIndex].stats; }
+        Offset allocationSize(PartitionAllocation allocation) const;
+
+        // Sum over the partitions. largestFreeRegion is the largest of a single partition.
+        StorageReport storageReport() const;
+
+//    private:
+        struct Partition
+        {
+            std::optional<Allocator> allocator;
+            void* metadata = nullptr;           // From PartitionMemory. nullptr = node arrays owned by the allocator
+            size_t metadataSize = 0;
+            std::vector<uint32> stealOrder;
+            PartitionStats stats = {};
+        };
+
+        template<typename AllocateFunction>
+        PartitionAllocation allocateRouted(uint32 partitionIndex, Offset size, AllocateFunction&& allocateFunction);
+
+        std::vector<Partition> m_partitions;
+        PartitionMemory* m_memory;
+    };
+}
@@ -0,0 +1,188 @@
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocatorPool.hpp"
+
+#include <bit>
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+namespace OffsetAllocator
+{
+    namespace SmallFloat
+    {
+        extern uint32 uintToFloatRoundUp(Offset size);
+        extern Offset floatToUint(uint32 floatValue);
+    }
+
+    HeapPool::HeapPool(Offset heapSize, uint32 maxAllocsPerHeap, uint32 maxHeaps) :
+        m_heapSize(heapSize),
+        m_maxAllocsPerHeap(maxAllocsPerHeap),
+        m_maxHeaps(maxHeaps),
+        m_heaps(maxHeaps),
+        m_heapLevels(maxHeaps, 0),
+        m_emptySince(maxHeaps, 0)
+    {
+        ASSERT(maxHeaps <= MAX_HEAPS);
+        for (uint32 i = 0; i < NUM_TOP_BINS; i++)
+            m_levelHeaps[i] = 0;
+    }
+
+    PoolAllocation HeapPool::allocate(Offset size)
+    {
+        return allocateRouted(size, [size](Allocator& heap) { return heap.allocate(size); });
+    }
+
+    PoolAllocation HeapPool::allocate(Offset size, Offset alignment)
+    {
+        ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        if (size > Allocation::NO_SPACE - (alignment - 1)) return {};
+        return allocateRouted(size + alignment - 1, [size, alignment](Allocator& heap) { return heap.allocate(size, alignment); });
+    }
+
+    template<typename AllocateFunction>
+    PoolAllocation HeapPool::allocateRouted(Offset size, AllocateFunction&& allocateFunction)
+    {
+        // Round up bin above the largest Offset (sizes near the maximum): Its size wraps, no heap can hold it
+        uint32 minBinIndex = SmallFloat::uintToFloatRoundUp(size);
+        ASSERT(minBinIndex < NUM_LEAF_BINS);
+        Offset binSize = SmallFloat::floatToUint(minBinIndex);
+        if (binSize < size) return {};
+
+        // Heaps with a free node in the size's top bin or above. Heaps with only lower top bins can't fit.
+        uint64 candidates = m_levelHeaps[minBinIndex >> TOP_BINS_INDEX_SHIFT];
+
+        // Non-empty heaps first, lowest index first. Candidates in the size's own top bin may still miss (leaf bins).
+        for (uint64 mask : {candidates & ~m_emptyHeaps, candidates & m_emptyHeaps})
+        {
+            for (; mask; mask &= mask - 1)
+            {
+                uint32 heapIndex = (uint32)std::countr_zero(mask);
+                Allocation allocation = allocateFunction(*m_heaps[heapIndex]);
+                if (allocation.offset != Allocation::NO_SPACE)
+                {
+                    updateSummary(heapIndex);
+                    return {.heap = heapIndex, .allocation = allocation};
+                }
+            }
+        }
+
+        // No heap fits: New heap. Oversized requests get a heap of their bin size (an exact fit of that bin).
+        uint32 heapIndex = createHeap(binSize > m_heapSize ? binSize : m_heapSize);
+        if (heapIndex == PoolAllocation::NO_HEAP) return {};
+
+        // Can still fail (maxAllocsPerHeap < 3: no node for the remainder). The new empty heap is released later like any other.
+        Allocation allocation = allocateFunction(*m_heaps[heapIndex]);
+        updateSummary(heapIndex);
+        if (allocation.offset == Allocation::NO_SPACE) return {};
+        return {.heap = heapIndex, .allocation = allocation};
+    }
+
+    void HeapPool::free(PoolAllocation allocation)
+    {
+        if (allocation.heap == PoolAllocation::NO_HEAP) return;
+        ASSERT(allocation.heap < m_maxHeaps && m_heaps[allocation.heap]);
+
+        m_heaps[allocation.heap]->free(allocation.allocation);
+        updateSummary(allocation.heap);
+    }
+
+    void HeapPool::releaseEmptyHeaps(uint64 frame)
+    {
+        ASSERT(frame >= m_frame);
+        m_frame = frame;
+
+        for (uint64 mask = m_emptyHeaps; mask; mask &= mask - 1)
+        {
+            uint32 heapIndex = (uint32)std::countr_zero(mask);
+            if (frame - m_emptySince[heapIndex] >= m_releaseDelay)
+                releaseHeap(heapIndex);
+        }
+    }
+
+    void HeapPool::reset()
+    {
+        for (uint64 mask = m_liveHeaps; mask; mask &= mask - 1)
+            releaseHeap((uint32)std::countr_zero(mask));
+    }
+
+    uint32 HeapPool::heapCount() const
+    {
+        return (uint32)std::popcount(m_liveHeaps);
+    }
+
+    const Allocator* HeapPool::heap(uint32 heapIndex) const
+    {
+        if (heapIndex >= m_maxHeaps || !m_heaps[heapIndex]) return nullptr;
+        return &*m_heaps[heapIndex];
+    }
+
+    Offset HeapPool::allocationSize(PoolAllocation allocation) const
+    {
+        if (allocation.heap == PoolAllocation::NO_HEAP) return 0;
+        return m_heaps[allocation.heap]->allocationSize(allocation.allocation);
+    }
+
+    StorageReport HeapPool::storageReport() const
+    {
+        StorageReport report = {};
+        for (uint64 mask = m_liveHeaps; mask; mask &= mask - 1)
+        {
+            StorageReport heapReport = m_heaps[std::countr_zero(mask)]->storageReport();
+            report.totalFreeSpace += heapReport.totalFreeSpace;
+            if (heapReport.largestFreeRegion > report.largestFreeRegion)
+                report.largestFreeRegion = heapReport.largestFreeRegion;
+        }
+        return report;
+    }
+
+    uint32 HeapPool::createHeap(Offset size)
+    {
+        // Lowest unused index
+        uint32 heapIndex = (uint32)std::countr_zero(~m_liveHeaps);
+        if (heapIndex >= m_maxHeaps) return PoolAllocation::NO_HEAP;
+        if (m_listener && !m_listener->heapCreated(heapIndex, size)) return PoolAllocation::NO_HEAP;
+
+        m_heaps[heapIndex].emplace(size, m_maxAllocsPerHeap);
+        m_heapLevels[heapIndex] = 0;
+        m_liveHeaps |= 1ull << heapIndex;
+        updateSummary(heapIndex);
+        return heapIndex;
+    }
+
+    void HeapPool::releaseHeap(uint32 heapIndex)
+    {
+        uint64 heapBit = 1ull << heapIndex;
+        for (uint32 i = 0; i < m_heapLevels[heapIndex]; i++)
+            m_levelHeaps[i] &= ~heapBit;
+        m_heapLevels[heapIndex] = 0;
+        m_liveHeaps &= ~heapBit;
+        m_emptyHeaps &= ~heapBit;
+        m_heaps[heapIndex].reset();
+
+        if (m_listener) m_listener->heapReleased(heapIndex);
+    }
+
+    // Updates the heap's level in m_levelHeaps and tracks emptiness. Call after every heap operation.
+    // Level = highest used top bin + 1. It only changes when the largest free node crosses a top bin, so the
+    // mask loops rarely run. A heap out of nodes is level 0: Its allocate would fail before the bin search.
+    void HeapPool::updateSummary(uint32 heapIndex)
+    {
+        const Allocator& heap = *m_heaps[heapIndex];
+        uint64 heapBit = 1ull << heapIndex;
+        uint32 level = heap.m_freeOffset != 0 ? (uint32)std::bit_width(heap.m_usedBinsTop) : 0;
+        for (uint32 i = m_heapLevels[heapIndex]; i < level; i++)
+            m_levelHeaps[i] |= heapBit;
+        for (uint32 i = level; i < m_heapLevels[heapIndex]; i++)
+            m_levelHeaps[i] &= ~heapBit;
+        m_heapLevels[heapIndex] = (uint8)level;
+
+        bool empty = heap.m_freeStorage == heap.m_size;
+        if (empty && !(m_emptyHeaps & heapBit)) m_emptySince[heapIndex] = m_frame;
+        m_emptyHeaps = empty ? (m_emptyHeaps | heapBit) : (m_emptyHeaps & ~heapBit);
+    }
+}
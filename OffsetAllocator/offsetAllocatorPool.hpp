@@ -0,0 +1,96 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+
+#include <optional>
+#include <vector>
+
+namespace OffsetAllocator
+{
+    // Allocation of a HeapPool: Heap index + the allocation inside that heap
+    struct PoolAllocation
+    {
+        static constexpr uint32 NO_HEAP = 0xffffffff;
+
+        uint32 heap = NO_HEAP;
+        Allocation allocation = {};
+    };
+
+    // Heap lifetime notifications: Create / destroy the backing memory (e.g. a GPU heap) of a heap index.
+    // Called from inside HeapPool::allocate and HeapPool::releaseEmptyHeaps.
+    class HeapPoolListener
+    {
+    public:
+        // False = no backing memory: The heap is not created and the allocation fails
+        virtual bool heapCreated(uint32 heap, Offset size) = 0;
+        virtual void heapReleased(uint32 heap) = 0;
+
+    protected:
+        ~HeapPoolListener() = default;
+    };
+
+    // Pool of Allocator heaps that grows on demand
+    //
+    // Requests go to the lowest index heap that has a free node in the request's top bin or above. Summary: Per
+    // top bin a mask of the heaps whose largest free node is in that top bin or above. Routing is one mask load.
+    // Non-empty heaps are preferred: Empty heaps drain and get released. New heaps are heapSize big (oversized
+    // requests get a dedicated heap of their bin size). A heap that stays empty for releaseDelay frames of
+    // releaseEmptyHeaps is destroyed. Heap indices of released heaps are reused.
+    //
+    // Single threaded like Allocator. free is O(1): The handle carries the heap index.
+    class HeapPool
+    {
+    public:
+        static constexpr uint32 MAX_HEAPS = 64;
+
+        // Starts without heaps. The destructor doesn't notify the listener: reset() first to get heapReleased calls.
+        HeapPool(Offset heapSize, uint32 maxAllocsPerHeap = 128 * 1024, uint32 maxHeaps = MAX_HEAPS);
+
+        void setListener(HeapPoolListener* listener) { m_listener = listener; }
+
+        // Frames an empty heap is kept before releaseEmptyHeaps destroys it (default 3)
+        void setReleaseDelay(uint64 frames) { m_releaseDelay = frames; }
+
+        PoolAllocation allocate(Offset size);
+
+        // Routed by size + alignment - 1: Heaps that would only fit with lucky padding are skipped
+        PoolAllocation allocate(Offset size, Offset alignment);
+        void free(PoolAllocation allocation);
+
+        // Call once per frame with an increasing frame number
+        void releaseEmptyHeaps(uint64 frame);
+
+        // Releases every heap, empty or not
+        void reset();
+
+        uint32 heapCount() const;
+        const Allocator* heap(uint32 heapIndex) const;
+        Offset allocationSize(PoolAllocation allocation) const;
+
+        // Sum over the heaps. largestFreeRegion = largest of a single heap.
+        StorageReport storageReport() const;
+
+//    private:
+        template<typename AllocateFunction>
+        PoolAllocation allocateRouted(Offset size, AllocateFunction&& allocateFunction);
+        uint32 createHeap(Offset size);
+        void releaseHeap(uint32 heapIndex);
+        void updateSummary(uint32 heapIndex);
+
+        Offset m_heapSize;
+        uint32 m_maxAllocsPerHeap;
+        uint32 m_maxHeaps;
+        uint64 m_releaseDelay = 3;
+        uint64 m_frame = 0;
+        HeapPoolListener* m_listener = nullptr;
+
+        std::vector<std::optional<Allocator>> m_heaps;
+        std::vector<uint8> m_heapLevels;        // Highest used top bin + 1 per heap (0 = no free node)
+        std::vector<uint64> m_emptySince;       // Frame the heap became empty
+        uint64 m_levelHeaps[NUM_TOP_BINS];      // Heaps with a free node in the top bin or above
+        uint64 m_liveHeaps = 0;
+        uint64 m_emptyHeaps = 0;
+    };
+}
@@ -0,0 +1,95 @@
+// MIT License (see file: LICENSE)
+
+// Headless trace replay: offsetAllocatorReplay <trace file> [report interval]
+// Pass 1 replays the whole trace without reporting (throughput).
+// Pass 2 replays again and prints storageReport every interval operations as CSV (stdout). Summary goes to stderr.
+// Used bytes come from the free node sizes: storageReport reports no free space at all once the nodes run out.
+
+#include "offsetAllocatorTrace.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace OffsetAllocator;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <trace file> [report interval = 1000]\n", argv[0]);
+        return 1;
+    }
+    uint64 interval = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000;
+    if (interval == 0) interval = 1;
+
+    std::vector<TraceRecord> records;
+    if (!loadTrace(argv[1], records))
+    {
+        fprintf(stderr, "Can't load trace %s\n", argv[1]);
+        return 1;
+    }
+
+    TraceReplayer probe(records);
+    if (probe.maxAllocs() == 0)
+    {
+        fprintf(stderr, "Trace has no Begin record\n");
+        return 1;
+    }
+
+    // Pass 1: Throughput. Each pass gets a fresh allocator: Grow records change the size of the previous one.
+    uint64 operations = 0;
+    {
+        Allocator allocator(probe.storageSize(), probe.maxAllocs());
+        TraceReplayer replayer(records);
+        auto start = std::chrono::steady_clock::now();
+        while (replayer.step(allocator))
+            operations++;
+        auto end = std::chrono::steady_clock::now();
+        if (replayer.diverged())
+        {
+            fprintf(stderr, "Replay diverged at record %zu\n", replayer.position() - 1);
+            return 1;
+        }
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        fprintf(stderr, "%llu operations (%zu records) in %.3f ms: %.1f M ops/s, %.1f ns/op\n",
+            operations, records.size(), seconds * 1000.0, operations / seconds / 1e6, seconds * 1e9 / operations);
+    }
+
+    // Pass 2: Usage over time
+    printf("operation,used,peak_used,total_free,largest_free,fragmentation,out_of_nodes\n");
+    Allocator allocator(probe.storageSize(), probe.maxAllocs());
+    TraceReplayer replayer(records);
+    uint64 operation = 0;
+    Offset peakUsed = 0;
+    uint64 outOfNodesOperations = 0;
+    auto report = [&]()
+    {
+        StorageReport storage = allocator.storageReport();
+        bool outOfNodes = allocator.m_freeOffset == 0;
+        Offset used = allocator.m_size - allocator.m_freeStorage;
+        printf("%llu,%llu,%llu,%llu,%llu,%.4f,%d\n", operation, (uint64)used, (uint64)peakUsed,
+            (uint64)allocator.m_freeStorage, (uint64)storage.largestFreeRegion, storage.fragmentation(), (int)outOfNodes);
+    };
+    while (replayer.step(allocator))
+    {
+        operation++;
+        Offset used = allocator.m_size - allocator.m_freeStorage;
+        if (used > peakUsed) peakUsed = used;
+        if (allocator.m_freeOffset == 0) outOfNodesOperations++;
+        if (operation % interval == 0) report();
+    }
+    if (replayer.diverged())
+    {
+        fprintf(stderr, "Replay diverged at record %zu\n", replayer.position() - 1);
+        return 1;
+    }
+    if (operation % interval != 0) report();
+
+    fprintf(stderr, "Peak used: %llu / %llu (%.1f%%)\n", (uint64)peakUsed, (uint64)allocator.m_size,
+        100.0 * (double)peakUsed / (double)allocator.m_size);
+    if (outOfNodesOperations > 0)
+        fprintf(stderr, "Out of nodes at the end of %llu of %llu operations (maxAllocs %u)\n", outOfNodesOperations, operation, allocator.m_maxAllocs);
+    return 0;
+}
@@ -0,0 +1,167 @@
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocatorSlab.hpp"
+
+#include <bit>
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+namespace OffsetAllocator
+{
+    // Powers of two and their midpoints: 8, 12, 16, 24 ... 192, 256
+    static constexpr Offset CLASS_SIZES[SlabAllocator::NUM_SIZE_CLASSES] = {8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+    static constexpr uint64 ALL_BLOCKS_FREE = ~0ull;
+    static_assert(SlabAllocator::SLAB_BLOCKS == 64, "Free mask is a single uint64");
+
+    SlabAllocator::SlabAllocator(Allocator& parent, uint32 maxSlabs) :
+        m_parent(parent),
+        m_slabs(maxSlabs),
+        m_freeSlabs(maxSlabs)
+    {
+        // Stack in inverse order so that slab 0 pops first
+        for (uint32 i = 0; i < maxSlabs; i++)
+            m_freeSlabs[i] = maxSlabs - i - 1;
+        for (uint32 i = 0; i < NUM_SIZE_CLASSES; i++)
+        {
+            m_partialSlabs[i] = Slab::unused;
+            m_emptySlabs[i] = Slab::unused;
+        }
+    }
+
+    uint32 SlabAllocator::sizeClass(Offset size)
+    {
+        ASSERT(size <= MAX_SLAB_SIZE);
+        if (size <= CLASS_SIZES[0]) return 0;
+
+        // (2^b, 2^(b+1)]: Lower half -> 3 * 2^(b-1), upper half -> 2^(b+1)
+        uint32 b = (uint32)std::bit_width((uint32)size - 1) - 1;
+        return 2 * (b - 3) + 1 + (size > ((Offset)3 << (b - 1)) ? 1 : 0);
+    }
+
+    Offset SlabAllocator::classSize(uint32 sizeClass)
+    {
+        ASSERT(sizeClass < NUM_SIZE_CLASSES);
+        return CLASS_SIZES[sizeClass];
+    }
+
+    SlabAllocation SlabAllocator::allocate(Offset size)
+    {
+        if (size > MAX_SLAB_SIZE) return {.allocation = m_parent.allocate(size)};
+
+        uint32 sizeClass = SlabAllocator::sizeClass(size);
+        uint32 slabIndex = m_partialSlabs[sizeClass];
+        if (slabIndex == Slab::unused)
+        {
+            // No slab: The parent serves the request itself
+            slabIndex = createSlab(sizeClass);
+            if (slabIndex == Slab::unused) return {.allocation = m_parent.allocate(size)};
+        }
+
+        // Lowest free block
+        Slab& slab = m_slabs[slabIndex];
+        uint32 block = (uint32)std::countr_zero(slab.freeBlocks);
+        slab.freeBlocks &= slab.freeBlocks - 1;
+        if (m_emptySlabs[sizeClass] == slabIndex) m_emptySlabs[sizeClass] = Slab::unused;
+        if (slab.freeBlocks == 0) unlinkSlab(slabIndex);
+
+        return {.slab = slabIndex, .allocation = {.offset = slab.allocation.offset + block * CLASS_SIZES[sizeClass], .metadata = (NodeIndex)block}};
+    }
+
+    void SlabAllocator::free(SlabAllocation allocation)
+    {
+        if (allocation.slab == SlabAllocation::NO_SLAB)
+        {
+            if (allocation.allocation.offset != Allocation::NO_SPACE) m_parent.free(allocation.allocation);
+            return;
+        }
+        ASSERT(allocation.slab < m_slabs.size() && allocation.allocation.metadata < SLAB_BLOCKS);
+
+        Slab& slab = m_slabs[allocation.slab];
+        uint64 blockBit = 1ull << allocation.allocation.metadata;
+        ASSERT((slab.freeBlocks & blockBit) == 0);
+
+        // Full slab gets a free block: Back to the class list, at the head (the next allocate of the class uses it)
+        if (slab.freeBlocks == 0)
+        {
+            uint32 head = m_partialSlabs[slab.sizeClass];
+            slab.prev = Slab::unused;
+            slab.next = head;
+            if (head != Slab::unused) m_slabs[head].prev = allocation.slab;
+            m_partialSlabs[slab.sizeClass] = allocation.slab;
+        }
+        slab.freeBlocks |= blockBit;
+
+        // Empty: Keep one per class, return the others to the parent
+        if (slab.freeBlocks == ALL_BLOCKS_FREE)
+        {
+            if (m_emptySlabs[slab.sizeClass] == Slab::unused) m_emptySlabs[slab.sizeClass] = allocation.slab;
+            else releaseSlab(allocation.slab);
+        }
+    }
+
+    void SlabAllocator::releaseEmptySlabs()
+    {
+        for (uint32 i = 0; i < NUM_SIZE_CLASSES; i++)
+        {
+            if (m_emptySlabs[i] != Slab::unused) releaseSlab(m_emptySlabs[i]);
+        }
+    }
+
+    void SlabAllocator::reset()
+    {
+        for (uint32 i = 0; i < m_slabs.size(); i++)
+        {
+            if (m_slabs[i].allocation.offset != Allocation::NO_SPACE) releaseSlab(i);
+        }
+    }
+
+    Offset SlabAllocator::allocationSize(SlabAllocation allocation) const
+    {
+        if (allocation.slab == SlabAllocation::NO_SLAB) return m_parent.allocationSize(allocation.allocation);
+        return CLASS_SIZES[m_slabs[allocation.slab].sizeClass];
+    }
+
+    uint32 SlabAllocator::createSlab(uint32 sizeClass)
+    {
+        if (m_freeSlabs.empty()) return Slab::unused;
+        Allocation allocation = m_parent.allocate(CLASS_SIZES[sizeClass] * SLAB_BLOCKS);
+        if (allocation.offset == Allocation::NO_SPACE) return Slab::unused;
+
+        uint32 slabIndex = m_freeSlabs.back();
+        m_freeSlabs.pop_back();
+        m_slabCount++;
+
+        // Only slab of the class list: Called when the list is empty
+        ASSERT(m_partialSlabs[sizeClass] == Slab::unused);
+        m_slabs[slabIndex] = {.freeBlocks = ALL_BLOCKS_FREE, .allocation = allocation, .sizeClass = (uint8)sizeClass};
+        m_partialSlabs[sizeClass] = slabIndex;
+        return slabIndex;
+    }
+
+    void SlabAllocator::releaseSlab(uint32 slabIndex)
+    {
+        Slab& slab = m_slabs[slabIndex];
+        if (slab.freeBlocks != 0) unlinkSlab(slabIndex);
+        if (m_emptySlabs[slab.sizeClass] == slabIndex) m_emptySlabs[slab.sizeClass] = Slab::unused;
+
+        m_parent.free(slab.allocation);
+        slab = {};
+        m_freeSlabs.push_back(slabIndex);
+        m_slabCount--;
+    }
+
+    void SlabAllocator::unlinkSlab(uint32 slabIndex)
+    {
+        Slab& slab = m_slabs[slabIndex];
+        if (slab.prev != Slab::unused) m_slabs[slab.prev].next = slab.next;
+        else m_partialSlabs[slab.sizeClass] = slab.next;
+        if (slab.next != Slab::unused) m_slabs[slab.next].prev = slab.prev;
+        slab.prev = Slab::unused;
+        slab.next = Slab::unused;
+    }
+}
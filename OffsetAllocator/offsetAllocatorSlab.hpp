@@ -0,0 +1,81 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+
+#include <vector>
+
+namespace OffsetAllocator
+{
+    // Allocation of a SlabAllocator: Slab index + the block (offset, metadata = block index) inside that slab.
+    // slab = NO_SLAB: allocation is a regular handle of the parent Allocator (large sizes, no slab available).
+    struct SlabAllocation
+    {
+        static constexpr uint32 NO_SLAB = 0xffffffff;
+
+        uint32 slab = NO_SLAB;
+        Allocation allocation = {};
+    };
+
+    // Slab sub-allocator for tiny allocations on top of an Allocator
+    //
+    // Sizes up to MAX_SLAB_SIZE round up to one of NUM_SIZE_CLASSES classes (8, 12, 16, 24 ... 192, 256: up to 33%
+    // rounding). A slab is one parent allocation of SLAB_BLOCKS blocks of its class with a single 64 bit free mask:
+    // allocate = tzcnt + clear bit, free = set bit. Metadata per tiny allocation is one bit plus 1/64 of a Slab,
+    // instead of a parent node and freelist slot. Slabs with free blocks are in a per class list. A slab that gets
+    // empty goes back to the parent, except one empty slab kept per class (no slab churn at the boundary).
+    // Larger sizes and requests that can't get a slab (maxSlabs or parent out of space) go to the parent directly.
+    //
+    // Blocks are aligned to the parent offset of their slab only. Single threaded like Allocator.
+    class SlabAllocator
+    {
+    public:
+        static constexpr uint32 SLAB_BLOCKS = 64;
+        static constexpr uint32 NUM_SIZE_CLASSES = 11;
+        static constexpr Offset MAX_SLAB_SIZE = 256;
+
+        // The parent must outlive the slab allocator. The destructor doesn't free the slabs: reset() first.
+        SlabAllocator(Allocator& parent, uint32 maxSlabs = 4096);
+
+        SlabAllocation allocate(Offset size);
+        void free(SlabAllocation allocation);
+
+        // Returns the kept empty slabs to the parent (e.g. before defragmenting or growing it)
+        void releaseEmptySlabs();
+
+        // Returns every slab to the parent. Slab allocations become invalid, parent allocations stay.
+        void reset();
+
+        // Block size for slab allocations (size class), parent allocationSize otherwise
+        Offset allocationSize(SlabAllocation allocation) const;
+        uint32 slabCount() const { return m_slabCount; }
+        Allocator& parent() const { return m_parent; }
+
+        static uint32 sizeClass(Offset size);
+        static Offset classSize(uint32 sizeClass);
+
+//    private:
+        struct Slab
+        {
+            static constexpr uint32 unused = 0xffffffff;
+
+            uint64 freeBlocks = 0;          // Bit per block, 1 = free
+            Allocation allocation = {};     // Parent allocation of the slab
+            uint32 prev = unused;           // Class list of slabs with free blocks
+            uint32 next = unused;
+            uint8 sizeClass = 0;
+        };
+
+        uint32 createSlab(uint32 sizeClass);
+        void releaseSlab(uint32 slabIndex);
+        void unlinkSlab(uint32 slabIndex);
+
+        Allocator& m_parent;
+        std::vector<Slab> m_slabs;
+        std::vector<uint32> m_freeSlabs;                // Unused slab indices (stack)
+        uint32 m_slabCount = 0;
+        uint32 m_partialSlabs[NUM_SIZE_CLASSES];        // Head of the class list of slabs with free blocks
+        uint32 m_emptySlabs[NUM_SIZE_CLASSES];          // The kept empty slab of the class (also in the class list)
+    };
+}
@@ -0,0 +1,326 @@
+// MIT License (see file: LICENSE)
+
+// Headless stress runner: Synthetic workloads against Allocator, timing + fragmentation CSV on stdout.
+// Long running and allocation free inside the timed loops: Attach perf (perf record / perf stat) to it.
+//
+// offsetAllocatorStress [options]
+//   --workload churn|lifo|fifo|fragmented|fill|all   (default all)
+//   --sizes random|pow2|odd|clustered                (default random)
+//   --policy binhead|bestfit|lowest                  (default binhead)
+//   --max-allocs N                                   (default 65536)
+//   --ops N          operations per workload         (default 10000000)
+//   --interval N     operations per CSV row          (default 1000000)
+//   --seed N
+//
+// Columns: ns_per_op = interval average, p99_ns = every 16th operation timed with steady_clock (~20ns overhead).
+// used/total_free/largest_free/fragmentation = storageReport at the end of the interval.
+
+#include "offsetAllocator.hpp"
+#include "offsetAllocatorWorkload.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace OffsetAllocator;
+using namespace OffsetAllocator::Workload;
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr uint32 SAMPLE_INTERVAL = 16;
+
+    struct Options
+    {
+        const char* workload = "all";
+        SizeDistribution sizes = SizeDistribution::Random;
+        AllocationPolicy policy = AllocationPolicy::BinHead;
+        uint32 maxAllocs = 64 * 1024;
+        uint64 ops = 10000000;
+        uint64 interval = 1000000;
+        uint32 seed = 0x12345678;
+    };
+
+    const char* sizesName(SizeDistribution sizes)
+    {
+        switch (sizes)
+        {
+        case SizeDistribution::Pow2: return "pow2";
+        case SizeDistribution::Odd: return "odd";
+        case SizeDistribution::Clustered: return "clustered";
+        default: return "random";
+        }
+    }
+
+    const char* policyName(AllocationPolicy policy)
+    {
+        switch (policy)
+        {
+        case AllocationPolicy::BestFit: return "bestfit";
+        case AllocationPolicy::LowestAddress: return "lowest";
+        default: return "binhead";
+        }
+    }
+
+    // One CSV row per interval
+    class Reporter
+    {
+    public:
+        Reporter(const Options& options, const char* workload, const Allocator& allocator) :
+            m_options(options), m_workload(workload), m_allocator(allocator)
+        {
+            m_samples.reserve(options.interval / SAMPLE_INTERVAL + 1);
+        }
+
+        // Runs operation (opsPerCall allocator operations) and reports every interval operations
+        template<typename Operation>
+        void run(uint32 opsPerCall, Operation&& operation)
+        {
+            Clock::time_point intervalStart = Clock::now();
+            uint64 intervalOps = 0;
+            for (uint64 call = 0; m_ops < m_options.ops; call++)
+            {
+                if ((call % SAMPLE_INTERVAL) == 0)
+                {
+                    Clock::time_point start = Clock::now();
+                    operation();
+                    Clock::time_point end = Clock::now();
+                    m_samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / opsPerCall);
+                }
+                else
+                {
+                    operation();
+                }
+                m_ops += opsPerCall;
+                intervalOps += opsPerCall;
+
+                if (intervalOps >= m_options.interval || m_ops >= m_options.ops)
+                {
+                    Clock::time_point now = Clock::now();
+                    double ns = std::chrono::duration<double, std::nano>(now - intervalStart).count();
+                    row(ns / (double)intervalOps);
+                    intervalOps = 0;
+                    intervalStart = Clock::now();
+                }
+            }
+        }
+
+        void row(double nsPerOp)
+        {
+            double p99 = 0.0;
+            if (!m_samples.empty())
+            {
+                size_t index = std::min(m_samples.size() - 1, m_samples.size() * 99 / 100);
+                std::nth_element(m_samples.begin(), m_samples.begin() + index, m_samples.end());
+                p99 = m_samples[index];
+                m_samples.clear();
+            }
+
+            StorageReport report = m_allocator.storageReport();
+            printf("%s,%s,%s,%u,%llu,%.2f,%.1f,%llu,%llu,%llu,%.4f,%llu\n", m_workload, sizesName(m_options.sizes),
+                policyName(m_options.policy), m_options.maxAllocs, m_ops, nsPerOp, p99,
+                (uint64)(m_allocator.m_size - report.totalFreeSpace), (uint64)report.totalFreeSpace,
+                (uint64)report.largestFreeRegion, report.fragmentation(), failed);
+            fflush(stdout);
+        }
+
+        uint64 failed = 0;
+
+    private:
+        const Options& m_options;
+        const char* m_workload;
+        const Allocator& m_allocator;
+        std::vector<double> m_samples;
+        uint64 m_ops = 0;
+    };
+
+    Allocation allocateCounted(Allocator& allocator, Offset size, Reporter& reporter)
+    {
+        Allocation allocation = allocator.allocate(size);
+        if (allocation.offset == Allocation::NO_SPACE) reporter.failed++;
+        return allocation;
+    }
+
+    void freeIfUsed(Allocator& allocator, Allocation& allocation)
+    {
+        if (allocation.offset != Allocation::NO_SPACE) allocator.free(allocation);
+        allocation = {};
+    }
+
+    // Random slot: free + allocate on a half full heap
+    void churn(const Options& options, Allocator& allocator, Reporter& reporter, Random& random)
+    {
+        std::vector<Allocation> live(options.maxAllocs / 2);
+        for (Allocation& allocation : live)
+            allocation = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+
+        reporter.run(2, [&]()
+        {
+            Allocation& allocation = live[random.next() % live.size()];
+            freeIfUsed(allocator, allocation);
+            allocation = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+        });
+    }
+
+    // Runs of 64 allocations freed in reverse order on top of a half full heap
+    void lifo(const Options& options, Allocator& allocator, Reporter& reporter, Random& random)
+    {
+        static constexpr uint32 RUN_LENGTH = 64;
+
+        std::vector<Allocation> live(options.maxAllocs / 2);
+        for (Allocation& allocation : live)
+            allocation = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+
+        Allocation run[RUN_LENGTH];
+        reporter.run(RUN_LENGTH * 2, [&]()
+        {
+            for (Allocation& allocation : run)
+                allocation = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+            for (uint32 i = RUN_LENGTH; i > 0; i--)
+                freeIfUsed(allocator, run[i - 1]);
+        });
+    }
+
+    // Ring of maxAllocs / 2 allocations: Free the oldest, allocate the newest
+    void fifo(const Options& options, Allocator& allocator, Reporter& reporter, Random& random)
+    {
+        std::vector<Allocation> ring(options.maxAllocs / 2);
+        for (Allocation& allocation : ring)
+            allocation = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+
+        size_t oldest = 0;
+        reporter.run(2, [&]()
+        {
+            freeIfUsed(allocator, ring[oldest]);
+            ring[oldest] = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+            oldest = (oldest + 1) % ring.size();
+        });
+    }
+
+    // Every other allocation freed, then churn with double sizes: Most free holes are too small
+    void fragmented(const Options& options, Allocator& allocator, Reporter& reporter, Random& random)
+    {
+        std::vector<Allocation> live(options.maxAllocs / 2);
+        for (Allocation& allocation : live)
+            allocation = allocateCounted(allocator, nextSize(random, options.sizes), reporter);
+        for (size_t i = 0; i < live.size(); i += 2)
+            freeIfUsed(allocator, live[i]);
+
+        reporter.run(2, [&]()
+        {
+            Allocation& allocation = live[random.next() % live.size()];
+            freeIfUsed(allocator, allocation);
+            allocation = allocateCounted(allocator, nextSize(random, options.sizes) * 2, reporter);
+        });
+    }
+
+    // Allocate until the first failure, free everything, repeat. failed = completed fills.
+    void fill(const Options& options, Allocator& allocator, Reporter& reporter, Random& random)
+    {
+        std::vector<Allocation> live;
+        live.reserve(options.maxAllocs);
+        reporter.run(1, [&]()
+        {
+            Allocation allocation = allocator.allocate(nextSize(random, options.sizes));
+            if (allocation.offset != Allocation::NO_SPACE)
+            {
+                live.push_back(allocation);
+                return;
+            }
+
+            reporter.failed++;
+            for (Allocation& used : live)
+                allocator.free(used);
+            live.clear();
+        });
+        for (Allocation& used : live)
+            allocator.free(used);
+    }
+
+    typedef void (*WorkloadFunction)(const Options&, Allocator&, Reporter&, Random&);
+
+    struct NamedWorkload
+    {
+        const char* name;
+        WorkloadFunction function;
+    };
+
+    static const NamedWorkload WORKLOADS[] =
+    {
+        {"churn", churn},
+        {"lifo", lifo},
+        {"fifo", fifo},
+        {"fragmented", fragmented},
+        {"fill", fill},
+    };
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const char* name = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (!value) return false;
+            i++;
+
+            if (!strcmp(name, "--workload")) options.workload = value;
+            else if (!strcmp(name, "--max-allocs")) options.maxAllocs = (uint32)strtoul(value, nullptr, 10);
+            else if (!strcmp(name, "--ops")) options.ops = strtoull(value, nullptr, 10);
+            else if (!strcmp(name, "--interval")) options.interval = strtoull(value, nullptr, 10);
+            else if (!strcmp(name, "--seed")) options.seed = (uint32)strtoul(value, nullptr, 10);
+            else if (!strcmp(name, "--sizes"))
+            {
+                if (!strcmp(value, "random")) options.sizes = SizeDistribution::Random;
+                else if (!strcmp(value, "pow2")) options.sizes = SizeDistribution::Pow2;
+                else if (!strcmp(value, "odd")) options.sizes = SizeDistribution::Odd;
+                else if (!strcmp(value, "clustered")) options.sizes = SizeDistribution::Clustered;
+                else return false;
+            }
+            else if (!strcmp(name, "--policy"))
+            {
+                if (!strcmp(value, "binhead")) options.policy = AllocationPolicy::BinHead;
+                else if (!strcmp(value, "bestfit")) options.policy = AllocationPolicy::BestFit;
+                else if (!strcmp(value, "lowest")) options.policy = AllocationPolicy::LowestAddress;
+                else return false;
+            }
+            else return false;
+        }
+        return options.maxAllocs >= 2 && options.interval > 0 && options.seed != 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "Usage: %s [--workload churn|lifo|fifo|fragmented|fill|all] [--sizes random|pow2|odd|clustered]\n"
+            "    [--policy binhead|bestfit|lowest] [--max-allocs N] [--ops N] [--interval N] [--seed N (non-zero)]\n", argv[0]);
+        return 1;
+    }
+
+    bool found = false;
+    printf("workload,sizes,policy,max_allocs,ops,ns_per_op,p99_ns,used,total_free,largest_free,fragmentation,failed\n");
+    for (const NamedWorkload& workload : WORKLOADS)
+    {
+        if (strcmp(options.workload, "all") && strcmp(options.workload, workload.name)) continue;
+        found = true;
+
+        Allocator allocator(heapSize(options.maxAllocs, options.sizes), options.maxAllocs);
+        allocator.setAllocationPolicy(options.policy);
+        Random random = {.state = options.seed};
+        Reporter reporter(options, workload.name, allocator);
+        workload.function(options, allocator, reporter, random);
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "Unknown workload %s\n", options.workload);
+        return 1;
+    }
+    return 0;
+}
@@ -1,18 +1,37 @@
+// Catch2 v3 (links Catch2::Catch2WithMain) or the v2 single header
+#if __has_include(<catch2/catch_all.hpp>)
 #include <catch2/catch_all.hpp>
-#include <catch2/catch_test_macros.hpp>
-#include "gfxTestFixture.hpp"
+#else
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+#endif
 
 #include "offsetAllocator.hpp"
+#include "offsetAllocatorConcurrent.hpp"
+#include "offsetAllocatorPartitioned.hpp"
+#include "offsetAllocatorPool.hpp"
+#include "offsetAllocatorSlab.hpp"
+#include "offsetAllocatorTimeline.hpp"
+#include "offsetAllocatorTrace.hpp"
 
-using namespace f;
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+using OffsetAllocator::uint32;
+using OffsetAllocator::uint64;
 
 namespace OffsetAllocator
 {
     namespace SmallFloat
     {
-        extern uint32 uintToFloatRoundUp(uint32 size);
-        extern uint32 uintToFloatRoundDown(uint32 size);
-    extern uint32 floatToUint(uint32 floatValue);
+        extern uint32 uintToFloatRoundUp(Offset size);
+        extern uint32 uintToFloatRoundDown(Offset size);
+    extern Offset floatToUint(uint32 floatValue);
     }
 }
 
@@ -23,9 +42,7 @@ namespace offsetAllocatorTests
         SECTION("uintToFloat")
         {
             // Denorms, exp=1 and exp=2 + mantissa = 0 are all precise.
-            // NOTE: Assuming 8 value (3 bit) mantissa.
-            // If this test fails, please change this assumption!
-            uint32 preciseNumberCount = 17;
+            uint32 preciseNumberCount = 2 * OffsetAllocator::BINS_PER_LEAF + 1;
             for (uint32 i = 0; i < preciseNumberCount; i++)
             {
                 uint32 roundUp = OffsetAllocator::SmallFloat::uintToFloatRoundUp(i);
@@ -51,7 +68,8 @@ namespace offsetAllocatorTests
                 {.number = 1048575, .up = 144, .down = 143},
             };
             
-            for (uint32 i = 0; i < sizeof(testData) / sizeof(NumberFloatUpDown); i++)
+            // NOTE: Assuming 8 value (3 bit) mantissa
+            for (uint32 i = 0; i < sizeof(testData) / sizeof(NumberFloatUpDown) && OffsetAllocator::MANTISSA_BITS == 3; i++)
             {
                 NumberFloatUpDown v = testData[i];
                 uint32 roundUp = OffsetAllocator::SmallFloat::uintToFloatRoundUp(v.number);
@@ -64,9 +82,7 @@ namespace offsetAllocatorTests
         SECTION("floatToUint")
         {
             // Denorms, exp=1 and exp=2 + mantissa = 0 are all precise.
-            // NOTE: Assuming 8 value (3 bit) mantissa.
-            // If this test fails, please change this assumption!
-            uint32 preciseNumberCount = 17;
+            uint32 preciseNumberCount = 2 * OffsetAllocator::BINS_PER_LEAF + 1;
             for (uint32 i = 0; i < preciseNumberCount; i++)
             {
                 uint32 v = OffsetAllocator::SmallFloat::floatToUint(i);
@@ -74,8 +90,9 @@ namespace offsetAllocatorTests
             }
             
             // Test that float->uint->float conversion is precise for all numbers
-            // NOTE: Test values < 240. 240->4G = overflows 32 bit integer
-            for (uint32 i = 0; i < 240; i++)
+            // NOTE: Test values below exponent 32 - MANTISSA_BITS + 1 (240 with 3 bits). Larger = overflows 32 bit integer
+            uint32 maxPreciseBin = (32 - OffsetAllocator::MANTISSA_BITS + 1) << OffsetAllocator::MANTISSA_BITS;
+            for (uint32 i = 0; i < maxPreciseBin; i++)
             {
                 uint32 v = OffsetAllocator::SmallFloat::floatToUint(i);
                 uint32 roundUp = OffsetAllocator::SmallFloat::uintToFloatRoundUp(v);
@@ -97,6 +114,32 @@ namespace offsetAllocatorTests
         allocator.free(a);
     }
 
+    TEST_CASE("tiny maxAllocs", "[offsetAllocator]")
+    {
+        // maxAllocs below MIN_MAX_ALLOCS is clamped: Valid empty allocator, allocations need a spare node
+        for (uint32 maxAllocs : {0u, 1u, 2u})
+        {
+            OffsetAllocator::Allocator allocator(1024, maxAllocs);
+            REQUIRE(allocator.m_maxAllocs == OffsetAllocator::Allocator::MIN_MAX_ALLOCS);
+            REQUIRE(allocator.validate() == nullptr);
+            REQUIRE(allocator.allocate(100).offset == OffsetAllocator::Allocation::NO_SPACE);
+            REQUIRE(allocator.m_freeStorage == 1024);
+            REQUIRE(allocator.storageReport().totalFreeSpace == 0);     // Out of nodes
+            REQUIRE(OffsetAllocator::Allocator::requiredMemorySize(maxAllocs) == OffsetAllocator::Allocator::requiredMemorySize(2));
+        }
+
+        OffsetAllocator::Allocator allocator(1024, 3);
+        OffsetAllocator::Allocation a = allocator.allocate(100);
+        REQUIRE(a.offset == 0);
+        allocator.free(a);
+        REQUIRE(allocator.validate() == nullptr);
+
+        // Moved-from allocator: reset keeps it empty
+        OffsetAllocator::Allocator moved(std::move(allocator));
+        allocator.reset();
+        REQUIRE(allocator.allocate(1).offset == OffsetAllocator::Allocation::NO_SPACE);
+    }
+
     TEST_CASE("allocate", "[offsetAllocator]")
     {
         OffsetAllocator::Allocator allocator(1024 * 1024 * 256);
@@ -257,4 +300,2369 @@ namespace offsetAllocatorTests
             allocator.free(validateAll);
         }
     }
+
+    TEST_CASE("aligned", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256);
+
+        SECTION("padding is reused")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(100);
+            REQUIRE(a.offset == 0);
+
+            // Padding 100..255 stays as a free node
+            OffsetAllocator::Allocation b = allocator.allocate(1000, 256);
+            REQUIRE(b.offset == 256);
+            REQUIRE(allocator.allocationSize(b) == 1000);
+
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 * 256 - 100 - 1000);
+
+            // Fits the padding (156 bytes = bin 144)
+            OffsetAllocator::Allocation c = allocator.allocate(144);
+            REQUIRE(c.offset == 100);
+
+            OffsetAllocator::Allocation d = allocator.allocate(4096, 65536);
+            REQUIRE(d.offset == 65536);
+
+            allocator.free(b);
+            allocator.free(a);
+            allocator.free(d);
+            allocator.free(c);
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+
+        SECTION("larger bin fallback")
+        {
+            // Free 1024 bytes at offset 1 (not 1024 aligned). Aligned allocation can't use it.
+            OffsetAllocator::Allocation a = allocator.allocate(1);
+            OffsetAllocator::Allocation b = allocator.allocate(1024);
+            OffsetAllocator::Allocation c = allocator.allocate(1);
+            allocator.free(b);
+
+            OffsetAllocator::Allocation d = allocator.allocate(1024, 1024);
+            REQUIRE(d.offset == 2048);
+
+            // Unaligned allocation still uses the hole
+            OffsetAllocator::Allocation e = allocator.allocate(1024, 1);
+            REQUIRE(e.offset == 1);
+
+            allocator.free(a);
+            allocator.free(c);
+            allocator.free(d);
+            allocator.free(e);
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+
+        SECTION("no space")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(1024 * 1024 * 256 - 4096);
+            OffsetAllocator::Allocation b = allocator.allocate(1024, 65536);
+            REQUIRE(b.offset == OffsetAllocator::Allocation::NO_SPACE);
+            allocator.free(a);
+        }
+    }
+
+#ifdef USE_64_BIT_OFFSETS
+    TEST_CASE("64 bit offsets", "[offsetAllocator]")
+    {
+        // 16GB storage. Only metadata is allocated, so this is cheap.
+        static constexpr OffsetAllocator::Offset GB = 1024ull * 1024 * 1024;
+        OffsetAllocator::Allocator allocator(16 * GB);
+
+        SECTION("numbers")
+        {
+            // Float->uint->float is precise for all bins (top bin 61 is the last one that fits 64 bits)
+            for (uint32 i = 0; i < 496; i++)
+            {
+                OffsetAllocator::Offset v = OffsetAllocator::SmallFloat::floatToUint(i);
+                REQUIRE(i == OffsetAllocator::SmallFloat::uintToFloatRoundUp(v));
+                REQUIRE(i == OffsetAllocator::SmallFloat::uintToFloatRoundDown(v));
+            }
+        }
+
+        SECTION("allocate above 4GB")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(5 * GB);
+            REQUIRE(a.offset == 0);
+            REQUIRE(allocator.allocationSize(a) == 5 * GB);
+
+            OffsetAllocator::Allocation b = allocator.allocate(1337);
+            REQUIRE(b.offset == 5 * GB);
+
+            OffsetAllocator::Allocation c = allocator.allocate(10 * GB);
+            REQUIRE(c.offset == 5 * GB + 1337);
+
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1 * GB - 1337);
+
+            // Doesn't fit anymore
+            OffsetAllocator::Allocation d = allocator.allocate(2 * GB);
+            REQUIRE(d.offset == OffsetAllocator::Allocation::NO_SPACE);
+
+            allocator.free(b);
+            allocator.free(a);
+            allocator.free(c);
+
+            OffsetAllocator::StorageReport report2 = allocator.storageReport();
+            REQUIRE(report2.totalFreeSpace == 16 * GB);
+            REQUIRE(report2.largestFreeRegion == 16 * GB);
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::Allocation validateAll = allocator.allocate(16 * GB);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+    }
+#endif
+
+    TEST_CASE("batch", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256);
+
+        SECTION("allocate contiguous")
+        {
+            // Whole batch is carved from one free node: offsets are packed back to back
+            OffsetAllocator::Offset sizes[] = {1337, 0, 123, 1024, 7};
+            OffsetAllocator::Allocation allocations[5];
+            REQUIRE(allocator.allocateBatch(sizes, allocations));
+
+            OffsetAllocator::Offset offset = 0;
+            for (uint32 i = 0; i < 5; i++)
+            {
+                REQUIRE(allocations[i].offset == offset);
+                REQUIRE(allocator.allocationSize(allocations[i]) == sizes[i]);
+                offset += sizes[i];
+            }
+
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 * 256 - offset);
+
+            allocator.freeBatch(allocations);
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+
+        SECTION("free merges with binned neighbors")
+        {
+            OffsetAllocator::Allocation allocations[8];
+            for (uint32 i = 0; i < 8; i++)
+                allocations[i] = allocator.allocate(1024);
+
+            // Free nodes 1 and 5 the scalar way, so the batch has to merge with existing free nodes in bins
+            allocator.free(allocations[1]);
+            allocator.free(allocations[5]);
+
+            OffsetAllocator::Allocation batch[] = {allocations[6], allocations[0], allocations[4], allocations[2], allocations[3]};
+            allocator.freeBatch(batch);
+
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 * 256 - 1024);
+
+            // Offsets 0..7167 must be a single free region now
+            OffsetAllocator::Allocation c = allocator.allocate(1024 * 7);
+            REQUIRE(c.offset == 0);
+
+            allocator.free(c);
+            allocator.free(allocations[7]);
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+
+        SECTION("partial batch keeps placed items")
+        {
+            // Batch sum doesn't fit a single node: allocator falls back to per-item allocate and reports failure.
+            // There is no rollback: Items that fit stay allocated, the rest get NO_SPACE
+            OffsetAllocator::Offset sizes[] = {1024 * 1024 * 128, 1024 * 1024 * 64, 1024 * 1024 * 128};
+            OffsetAllocator::Allocation allocations[3];
+            REQUIRE(!allocator.allocateBatch(sizes, allocations));
+            REQUIRE(allocations[0].offset == 0);
+            REQUIRE(allocations[1].offset == 1024 * 1024 * 128);
+            REQUIRE(allocations[2].offset == OffsetAllocator::Allocation::NO_SPACE);
+
+            // freeBatch skips the failed items
+            allocator.freeBatch(allocations);
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+
+        SECTION("out of nodes")
+        {
+            OffsetAllocator::Allocator small(1024, 8);
+            OffsetAllocator::Offset sizes[16] = {};
+            for (uint32 i = 0; i < 16; i++) sizes[i] = 1;
+
+            OffsetAllocator::Allocation allocations[16];
+            REQUIRE(!small.allocateBatch(sizes, allocations));
+            REQUIRE(allocations[15].offset == OffsetAllocator::Allocation::NO_SPACE);
+            small.freeBatch(allocations);
+
+            OffsetAllocator::Allocation validateAll = small.allocate(1024);
+            REQUIRE(validateAll.offset == 0);
+            small.free(validateAll);
+        }
+    }
+
+    TEST_CASE("reset", "[offsetAllocator]")
+    {
+        SECTION("reuses node arrays")
+        {
+            OffsetAllocator::Allocator allocator(1024 * 1024 * 256);
+            OffsetAllocator::Allocator::Node* nodes = allocator.m_nodes;
+            OffsetAllocator::NodeIndex* freeNodes = allocator.m_freeNodes;
+
+            OffsetAllocator::Allocation a = allocator.allocate(1337);
+            OffsetAllocator::Allocation b = allocator.allocate(123);
+            REQUIRE(b.offset == 1337);
+            (void)a;
+
+            allocator.reset();
+            REQUIRE(allocator.m_nodes == nodes);
+            REQUIRE(allocator.m_freeNodes == freeNodes);
+            REQUIRE(allocator.storageReport().totalFreeSpace == 1024 * 1024 * 256);
+
+            // Same node indices as a fresh allocator
+            OffsetAllocator::Allocation c = allocator.allocate(1337);
+            REQUIRE(c.offset == 0);
+            REQUIRE(c.metadata == a.metadata);
+            allocator.free(c);
+
+            OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            allocator.free(validateAll);
+        }
+
+        SECTION("freelist after reset")
+        {
+            // Mix of lazy (never written) and pushed freelist entries. Run out of nodes twice.
+            OffsetAllocator::Allocator allocator(1024, 16);
+            std::vector<OffsetAllocator::Allocation> allocations;
+            for (uint32 round = 0; round < 2; round++)
+            {
+                for (uint32 i = 0; i < 8; i++)
+                    allocations.push_back(allocator.allocate(1));
+                allocator.free(allocations[2]);
+                allocator.free(allocations[5]);
+                allocations[2] = allocator.allocate(1);
+                allocations[5] = allocator.allocate(1);
+
+                for (;;)
+                {
+                    OffsetAllocator::Allocation a = allocator.allocate(1);
+                    if (a.offset == OffsetAllocator::Allocation::NO_SPACE) break;
+                    allocations.push_back(a);
+                }
+                // 16 nodes: One holds the remainder and allocate never pops the last freelist entry
+                REQUIRE(allocations.size() == 14);
+
+                // Node indices are unique
+                for (uint32 i = 0; i < allocations.size(); i++)
+                    for (uint32 j = i + 1; j < allocations.size(); j++)
+                        REQUIRE(allocations[i].metadata != allocations[j].metadata);
+
+                for (OffsetAllocator::Allocation& a : allocations)
+                    allocator.free(a);
+                allocations.clear();
+
+                OffsetAllocator::Allocation validateAll = allocator.allocate(1024);
+                REQUIRE(validateAll.offset == 0);
+                allocator.free(validateAll);
+
+                allocator.reset();
+            }
+        }
+
+        SECTION("caller provided memory")
+        {
+            size_t memorySize = OffsetAllocator::Allocator::requiredMemorySize(1024);
+            void* memory = ::operator new[](memorySize, std::align_val_t(64));
+            {
+                OffsetAllocator::Allocator allocator(1024 * 1024, 1024, memory);
+                REQUIRE((void*)allocator.m_nodes == memory);
+
+                OffsetAllocator::Allocation a = allocator.allocate(1337);
+                OffsetAllocator::Allocation b = allocator.allocate(4096);
+                REQUIRE(a.offset == 0);
+                REQUIRE(b.offset == 1337);
+                allocator.free(a);
+
+                allocator.reset();
+                OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024);
+                REQUIRE(validateAll.offset == 0);
+                allocator.free(validateAll);
+            }
+            ::operator delete[](memory, std::align_val_t(64));
+        }
+    }
+
+    TEST_CASE("defragment", "[offsetAllocator]")
+    {
+        // Checkerboard: every other allocation freed
+        OffsetAllocator::Allocator allocator(1024 * 1024);
+        std::vector<OffsetAllocator::uint8> memory(1024 * 1024);
+        std::vector<OffsetAllocator::Allocation> allocations;
+        for (uint32 i = 0; i < 256; i++)
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(100 + i);
+            std::fill(memory.begin() + a.offset, memory.begin() + a.offset + 100 + i, (OffsetAllocator::uint8)i);
+            allocations.push_back(a);
+        }
+        for (uint32 i = 1; i < 256; i += 2)
+            allocator.free(allocations[i]);
+        std::erase_if(allocations, [&](const OffsetAllocator::Allocation& a) { return memory[a.offset] & 1; });
+
+        auto freeRegionCount = [&]()
+        {
+            OffsetAllocator::StorageReportFull report = allocator.storageReportFull();
+            uint32 count = 0;
+            for (const OffsetAllocator::StorageReportFull::Region& region : report.freeRegions)
+                count += region.count;
+            return count;
+        };
+        REQUIRE(freeRegionCount() == 128);
+
+        auto applyRelocations = [&](std::span<const OffsetAllocator::Relocation> relocations)
+        {
+            for (const OffsetAllocator::Relocation& relocation : relocations)
+            {
+                memmove(memory.data() + relocation.newOffset, memory.data() + relocation.oldOffset, relocation.size);
+                for (OffsetAllocator::Allocation& a : allocations)
+                {
+                    if (a.metadata == relocation.allocation.metadata)
+                    {
+                        REQUIRE(a.offset == relocation.oldOffset);
+                        a = relocation.allocation;
+                    }
+                }
+            }
+        };
+
+        auto validateContents = [&]()
+        {
+            for (OffsetAllocator::Allocation& a : allocations)
+            {
+                OffsetAllocator::Offset size = allocator.allocationSize(a);
+                OffsetAllocator::uint8 value = memory[a.offset];
+                REQUIRE(size == (OffsetAllocator::Offset)(100 + value));
+                REQUIRE(std::all_of(memory.begin() + a.offset, memory.begin() + a.offset + size, [value](OffsetAllocator::uint8 v) { return v == value; }));
+            }
+        };
+
+        SECTION("full compaction")
+        {
+            OffsetAllocator::Relocation relocations[256];
+            uint32 count = allocator.defragment(relocations);
+            REQUIRE(count == 127);
+            applyRelocations({relocations, count});
+            validateContents();
+
+            REQUIRE(allocator.defragment(relocations) == 0);
+            REQUIRE(freeRegionCount() == 1);
+        }
+
+        SECTION("byte budget")
+        {
+            OffsetAllocator::Relocation relocations[256];
+            uint32 calls = 0;
+            for (;;)
+            {
+                uint32 count = allocator.defragment(relocations, 1000);
+                if (count == 0) break;
+                OffsetAllocator::Offset movedBytes = 0;
+                for (uint32 i = 0; i < count; i++)
+                    movedBytes += relocations[i].size;
+                REQUIRE(movedBytes <= 1000);
+                applyRelocations({relocations, count});
+                validateContents();
+                calls++;
+            }
+            REQUIRE(calls > 1);
+            REQUIRE(freeRegionCount() == 1);
+        }
+
+        SECTION("byte budget below the first move")
+        {
+            // Every allocation is larger than the budget: One move per call (the first move always happens)
+            OffsetAllocator::Relocation relocations[256];
+            uint32 calls = 0;
+            uint32 count;
+            while ((count = allocator.defragment(relocations, 50)) > 0)
+            {
+                REQUIRE(count == 1);
+                REQUIRE(relocations[0].size > 50);
+                applyRelocations({relocations, count});
+                validateContents();
+                calls++;
+            }
+            REQUIRE(calls > 1);
+            REQUIRE(freeRegionCount() == 1);
+        }
+
+        SECTION("small relocation span")
+        {
+            // Allocations keep working between partial defragment calls
+            OffsetAllocator::Relocation relocations[4];
+            uint32 count;
+            while ((count = allocator.defragment(relocations)) > 0)
+            {
+                applyRelocations({relocations, count});
+                OffsetAllocator::Allocation a = allocator.allocate(50);
+                REQUIRE(a.offset != OffsetAllocator::Allocation::NO_SPACE);
+                allocator.free(a);
+            }
+            validateContents();
+        }
+
+        SECTION("gap freed below the cursor")
+        {
+            // The next call resumes after the moved ranges. Reaching the end it starts over once from the lowest gap.
+            OffsetAllocator::Relocation relocations[4];
+            uint32 count = allocator.defragment(relocations);
+            REQUIRE(count == 4);
+            applyRelocations({relocations, count});
+            REQUIRE(allocator.m_defragmentCursor != OffsetAllocator::Allocator::Node::unused);
+
+            allocator.free(allocations[0]);
+            allocations.erase(allocations.begin());
+            REQUIRE(allocator.validate() == nullptr);
+
+            OffsetAllocator::Relocation all[256];
+            while ((count = allocator.defragment(all)) > 0)
+                applyRelocations({all, count});
+            validateContents();
+            REQUIRE(freeRegionCount() == 1);
+            REQUIRE(allocator.m_defragmentCursor == OffsetAllocator::Allocator::Node::unused);
+        }
+
+        for (OffsetAllocator::Allocation& a : allocations)
+            allocator.free(a);
+
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("defragment aligned", "[offsetAllocator]")
+    {
+        // [a 100][b 156][c 256, aligned 256][d 256][free]
+        OffsetAllocator::Allocator allocator(1024 * 1024);
+        OffsetAllocator::Allocation a = allocator.allocate(100);
+        OffsetAllocator::Allocation b = allocator.allocate(156);
+        OffsetAllocator::Allocation c = allocator.allocate(256, 256);
+        OffsetAllocator::Allocation d = allocator.allocate(256, 16);
+        REQUIRE(c.offset == 256);
+        REQUIRE(d.offset == 512);
+
+        // Gap at 0 fits c, but isn't 256 aligned: c stays, d moves down behind it
+        allocator.free(a);
+        OffsetAllocator::Relocation relocations[8];
+        uint32 count = allocator.defragment(relocations);
+        REQUIRE(count == 1);
+        REQUIRE(relocations[0].allocation.metadata == b.metadata);
+        REQUIRE(relocations[0].newOffset == 0);
+        b = relocations[0].allocation;
+        REQUIRE(allocator.defragment(relocations) == 0);
+        REQUIRE(allocator.validate() == nullptr);
+
+        // Gap at 0 is 256 aligned now: c and d slide down and keep their alignment
+        allocator.free(b);
+        count = allocator.defragment(relocations);
+        REQUIRE(count == 2);
+        REQUIRE(relocations[0].allocation.metadata == c.metadata);
+        REQUIRE(relocations[0].newOffset == 0);
+        REQUIRE(relocations[1].allocation.metadata == d.metadata);
+        REQUIRE(relocations[1].newOffset == 256);
+        c = relocations[0].allocation;
+        d = relocations[1].allocation;
+
+        allocator.free(c);
+        allocator.free(d);
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("storage report", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256);
+
+        // Incremental bin counts must match the bin linked lists
+        auto validateBinCounts = [&]()
+        {
+            OffsetAllocator::StorageReportFull report = allocator.storageReportFull();
+            for (uint32 i = 0; i < OffsetAllocator::NUM_LEAF_BINS; i++)
+            {
+                uint32 count = 0;
+                for (uint32 nodeIndex = allocator.m_binIndices[i]; nodeIndex != OffsetAllocator::Allocator::Node::unused; nodeIndex = allocator.m_nodes[nodeIndex].binListNext)
+                    count++;
+                REQUIRE(report.freeRegions[i].count == count);
+            }
+        };
+
+        REQUIRE(allocator.storageReport().fragmentation() == 0.0f);
+        validateBinCounts();
+
+        // Every bin count update path: allocate, aligned allocate, batches, free merges and defragment
+        std::vector<OffsetAllocator::Allocation> allocations;
+        uint32 seed = 1234;
+        for (uint32 i = 0; i < 2000; i++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            uint32 size = 1 + (seed >> 8) % 100000;
+            if (i % 3 == 0 && !allocations.empty())
+            {
+                uint32 index = (seed >> 4) % allocations.size();
+                allocator.free(allocations[index]);
+                allocations[index] = allocations.back();
+                allocations.pop_back();
+            }
+            else if (i % 7 == 0)
+            {
+                allocations.push_back(allocator.allocate(size, 256));
+            }
+            else
+            {
+                allocations.push_back(allocator.allocate(size));
+            }
+        }
+        validateBinCounts();
+        REQUIRE(allocator.storageReport().fragmentation() > 0.0f);
+
+        OffsetAllocator::Offset sizes[] = {100, 200, 300};
+        OffsetAllocator::Allocation batch[3];
+        allocator.allocateBatch(sizes, batch);
+        validateBinCounts();
+        allocator.freeBatch(batch);
+        validateBinCounts();
+
+        OffsetAllocator::Relocation relocations[64];
+        while (uint32 count = allocator.defragment(relocations))
+        {
+            for (const OffsetAllocator::Relocation& relocation : std::span(relocations, count))
+                for (OffsetAllocator::Allocation& a : allocations)
+                    if (a.metadata == relocation.allocation.metadata) a = relocation.allocation;
+        }
+        validateBinCounts();
+        REQUIRE(allocator.storageReport().fragmentation() < 0.125f);
+
+        for (OffsetAllocator::Allocation& a : allocations)
+            allocator.free(a);
+        validateBinCounts();
+
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("validate", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024, 1024);
+        REQUIRE(allocator.validate() == nullptr);
+
+        OffsetAllocator::Allocation a = allocator.allocate(1337);
+        OffsetAllocator::Allocation b = allocator.allocate(4096, 256);
+        OffsetAllocator::Allocation c = allocator.allocateHigh(100);
+        allocator.freeDeferred(b, 1);
+        REQUIRE(allocator.validate() == nullptr);
+
+        // Broken bookkeeping is reported, not asserted
+        allocator.m_freeStorage++;
+        REQUIRE(allocator.validate() != nullptr);
+        allocator.m_freeStorage--;
+
+        uint32 binIndex = OffsetAllocator::NUM_LEAF_BINS - 1;
+        while (allocator.m_binCounts[binIndex] == 0)
+            binIndex--;
+        allocator.m_binCounts[binIndex]++;
+        REQUIRE(allocator.validate() != nullptr);
+        allocator.m_binCounts[binIndex]--;
+
+        allocator.m_nodes[a.metadata].dataSize++;
+        REQUIRE(allocator.validate() != nullptr);
+        allocator.m_nodes[a.metadata].dataSize--;
+        REQUIRE(allocator.validate() == nullptr);
+
+        allocator.free(a);
+        allocator.free(c);
+        allocator.retire(1);
+        REQUIRE(allocator.validate() == nullptr);
+        REQUIRE(allocator.storageReport().totalFreeSpace == 1024 * 1024);
+    }
+
+    TEST_CASE("allocation policy", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024);
+
+        // Holes separated by small used allocations: [a][s][b][s][c][s][remainder]
+        auto makeHoles = [&](OffsetAllocator::Offset sizeA, OffsetAllocator::Offset sizeB, OffsetAllocator::Offset sizeC, OffsetAllocator::Allocation* holes, OffsetAllocator::Allocation* separators)
+        {
+            OffsetAllocator::Offset sizes[] = {sizeA, sizeB, sizeC};
+            for (uint32 i = 0; i < 3; i++)
+            {
+                holes[i] = allocator.allocate(sizes[i]);
+                separators[i] = allocator.allocate(10);
+            }
+            for (uint32 i = 0; i < 3; i++)
+                allocator.free(holes[i]);
+        };
+
+        OffsetAllocator::Allocation holes[3];
+        OffsetAllocator::Allocation separators[3];
+
+        SECTION("bin head")
+        {
+            // Last freed node is the bin head
+            makeHoles(150, 150, 150, holes, separators);
+            OffsetAllocator::Allocation a = allocator.allocate(100);
+            REQUIRE(a.offset == holes[2].offset);
+            allocator.free(a);
+        }
+
+        SECTION("best fit")
+        {
+            // 145 rounds up past the 145 hole's bin. Best fit finds it in the exact fit bin.
+            allocator.setAllocationPolicy(OffsetAllocator::AllocationPolicy::BestFit);
+            makeHoles(158, 145, 150, holes, separators);
+            OffsetAllocator::Allocation a = allocator.allocate(145);
+            REQUIRE(a.offset == holes[1].offset);
+
+            OffsetAllocator::Allocation b = allocator.allocate(149);
+            REQUIRE(b.offset == holes[2].offset);
+            allocator.free(a);
+            allocator.free(b);
+        }
+
+        SECTION("lowest address")
+        {
+            allocator.setAllocationPolicy(OffsetAllocator::AllocationPolicy::LowestAddress);
+            makeHoles(150, 150, 150, holes, separators);
+            OffsetAllocator::Allocation a = allocator.allocate(100);
+            REQUIRE(a.offset == holes[0].offset);
+            OffsetAllocator::Allocation b = allocator.allocate(100);
+            REQUIRE(b.offset == holes[1].offset);
+            allocator.free(a);
+            allocator.free(b);
+        }
+
+        for (uint32 i = 0; i < 3; i++)
+            allocator.free(separators[i]);
+
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("allocate high", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024);
+
+        SECTION("double ended")
+        {
+            // Low allocations grow up from 0, high ones down from the end
+            OffsetAllocator::Allocation a = allocator.allocate(100);
+            OffsetAllocator::Allocation b = allocator.allocateHigh(100);
+            OffsetAllocator::Allocation c = allocator.allocateHigh(50);
+            OffsetAllocator::Allocation d = allocator.allocate(100);
+            REQUIRE(a.offset == 0);
+            REQUIRE(b.offset == 924);
+            REQUIRE(c.offset == 874);
+            REQUIRE(d.offset == 100);
+            REQUIRE(allocator.allocationSize(c) == 50);
+
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 674);
+
+            // Frees merge with the head remainder and the high neighbors
+            allocator.free(c);
+            allocator.free(a);
+            allocator.free(b);
+            allocator.free(d);
+        }
+
+        SECTION("highest offset in bin")
+        {
+            // Two equal holes in the same bin: The higher one is carved from its tail
+            OffsetAllocator::Allocation a = allocator.allocate(256);
+            OffsetAllocator::Allocation b = allocator.allocate(256);
+            OffsetAllocator::Allocation c = allocator.allocate(256);
+            OffsetAllocator::Allocation d = allocator.allocate(256);
+            allocator.free(c);
+            allocator.free(a);
+            OffsetAllocator::Allocation e = allocator.allocateHigh(64);
+            REQUIRE(e.offset == 704);
+
+            // Exact fit: No head remainder
+            OffsetAllocator::Allocation f = allocator.allocateHigh(256);
+            REQUIRE(f.offset == 0);
+
+            allocator.free(b);
+            allocator.free(d);
+            allocator.free(e);
+            allocator.free(f);
+        }
+
+        SECTION("highest node that fits")
+        {
+            // Free: [0, 400) and [1000, 1024). Both fit 16, the higher one is used.
+            OffsetAllocator::Allocation a = allocator.allocate(400);
+            OffsetAllocator::Allocation b = allocator.allocate(100);
+            OffsetAllocator::Allocation c = allocator.allocate(500);
+            allocator.free(a);
+            OffsetAllocator::Allocation d = allocator.allocateHigh(16);
+            REQUIRE(d.offset == 1008);
+
+            // [1000, 1008) is too small: The next free node down
+            OffsetAllocator::Allocation e = allocator.allocateHigh(16);
+            REQUIRE(e.offset == 384);
+
+            allocator.free(b);
+            allocator.free(c);
+            allocator.free(d);
+            allocator.free(e);
+        }
+
+        SECTION("largest node beyond the scan limit")
+        {
+            // Free: [0, 400) and [500, 516), followed by more than POLICY_SCAN_LIMIT used nodes.
+            // The walk from the end stops before the small hole: Tail of the largest free node.
+            OffsetAllocator::Allocation a = allocator.allocate(400);
+            OffsetAllocator::Allocation b = allocator.allocate(100);
+            OffsetAllocator::Allocation hole = allocator.allocate(16);
+            std::vector<OffsetAllocator::Allocation> allocations;
+            for (uint32 i = 0; i < OffsetAllocator::Allocator::POLICY_SCAN_LIMIT + 4; i++)
+                allocations.push_back(allocator.allocate(16));
+            allocations.push_back(allocator.allocateHigh(1024 - 516 - 16 * (OffsetAllocator::Allocator::POLICY_SCAN_LIMIT + 4)));
+            REQUIRE(allocator.storageReport().totalFreeSpace == 0);
+            allocator.free(a);
+            allocator.free(hole);
+
+            OffsetAllocator::Allocation c = allocator.allocateHigh(16);
+            REQUIRE(c.offset == 384);
+
+            allocator.free(b);
+            allocator.free(c);
+            for (OffsetAllocator::Allocation allocation : allocations)
+                allocator.free(allocation);
+        }
+
+        SECTION("out of space")
+        {
+            OffsetAllocator::Allocation a = allocator.allocateHigh(1025);
+            REQUIRE(a.offset == OffsetAllocator::Allocation::NO_SPACE);
+
+            OffsetAllocator::Allocation b = allocator.allocateHigh(1024);
+            REQUIRE(b.offset == 0);
+            OffsetAllocator::Allocation c = allocator.allocateHigh(1);
+            REQUIRE(c.offset == OffsetAllocator::Allocation::NO_SPACE);
+            allocator.free(b);
+        }
+
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("resize", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024);
+
+        SECTION("grow")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(1000);
+            OffsetAllocator::Allocation b = allocator.allocate(1000);
+
+            // Grows into the free remainder after b, the rest stays free
+            REQUIRE(allocator.tryGrow(b, 5000));
+            REQUIRE(allocator.allocationSize(b) == 5000);
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 - 6000);
+
+            // a is followed by b (used)
+            REQUIRE(!allocator.tryGrow(a, 1001));
+            REQUIRE(allocator.tryGrow(a, 500));
+            REQUIRE(allocator.allocationSize(a) == 1000);
+
+            // Hole after a: Exact fit absorbs the whole neighbor, one more element doesn't fit
+            allocator.free(b);
+            OffsetAllocator::Allocation c = allocator.allocate(1000);
+            OffsetAllocator::Allocation d = allocator.allocate(1000);
+            allocator.free(c);
+            REQUIRE(!allocator.tryGrow(a, 2001));
+            REQUIRE(allocator.tryGrow(a, 2000));
+            REQUIRE(allocator.allocationSize(a) == 2000);
+
+            // Next allocation lands right after the grown range
+            OffsetAllocator::Allocation e = allocator.allocate(100);
+            REQUIRE(e.offset == 3000);
+
+            allocator.free(a);
+            allocator.free(d);
+            allocator.free(e);
+        }
+
+        SECTION("shrink")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(1000);
+            OffsetAllocator::Allocation b = allocator.allocate(1000);
+            OffsetAllocator::Allocation c = allocator.allocate(1000);
+
+            // Tail between two used ranges becomes its own free node (512 = exact bin size)
+            REQUIRE(allocator.shrink(b, 488));
+            REQUIRE(allocator.allocationSize(b) == 488);
+            OffsetAllocator::Allocation d = allocator.allocate(512);
+            REQUIRE(d.offset == 1488);
+
+            // Tail merges with the free remainder after c
+            REQUIRE(allocator.shrink(c, 10));
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 - 2010);
+            REQUIRE(allocator.shrink(c, 2000));
+            REQUIRE(allocator.allocationSize(c) == 10);
+
+            // Grow back after the shrink
+            REQUIRE(allocator.tryGrow(c, 1000));
+
+            allocator.free(a);
+            allocator.free(b);
+            allocator.free(c);
+            allocator.free(d);
+        }
+
+        SECTION("out of nodes")
+        {
+            OffsetAllocator::Allocator small(1024, 4);
+            OffsetAllocator::Allocation a = small.allocate(256);
+            OffsetAllocator::Allocation b = small.allocate(256);
+
+            // No free neighbor and no node for the tail
+            REQUIRE(!small.shrink(a, 100));
+            small.free(b);
+            REQUIRE(small.shrink(a, 100));
+            small.free(a);
+            REQUIRE(small.storageReport().largestFreeRegion == 1024);
+        }
+
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("grow heap", "[offsetAllocator]")
+    {
+        SECTION("storage after free node")
+        {
+            OffsetAllocator::Allocator allocator(1024, 16);
+            OffsetAllocator::Allocation a = allocator.allocate(512);
+
+            // Merged with the free remainder: One free node
+            REQUIRE(allocator.growStorage(1024));
+            REQUIRE(allocator.m_size == 2048);
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1536);
+            REQUIRE(report.largestFreeRegion == 1536);
+            REQUIRE(allocator.growStorage(0));
+
+            OffsetAllocator::Allocation b = allocator.allocate(1536);
+            REQUIRE(b.offset == 512);
+            allocator.free(a);
+            allocator.free(b);
+            REQUIRE(allocator.storageReport().largestFreeRegion == 2048);
+        }
+
+        SECTION("storage after used node")
+        {
+            OffsetAllocator::Allocator allocator(1024, 16);
+            OffsetAllocator::Allocation a = allocator.allocate(1024);
+            REQUIRE(allocator.growStorage(1024));
+            OffsetAllocator::Allocation b = allocator.allocate(1024);
+            REQUIRE(b.offset == 1024);
+
+            // Neighbor links: The old and the new storage coalesce
+            allocator.free(a);
+            allocator.free(b);
+            OffsetAllocator::Allocation c = allocator.allocate(2048);
+            REQUIRE(c.offset == 0);
+            allocator.free(c);
+        }
+
+        SECTION("freelist nodes untouched")
+        {
+            // The merged free neighbors of a went back to the freelist with their old ranges
+            OffsetAllocator::Allocator allocator(1024, 16);
+            OffsetAllocator::Allocation a = allocator.allocate(256);
+            OffsetAllocator::Allocation b = allocator.allocate(256);
+            allocator.free(a);
+            allocator.free(b);
+            std::vector<OffsetAllocator::Allocator::Node> nodes(allocator.m_nodes, allocator.m_nodes + allocator.m_maxAllocs);
+
+            REQUIRE(allocator.growStorage(1024));
+            REQUIRE(allocator.validate() == nullptr);
+            for (uint32 i = allocator.m_lazyFreeNodes; i <= allocator.m_freeOffset; i++)
+            {
+                uint32 nodeIndex = allocator.m_freeNodes[i];
+                REQUIRE(allocator.m_nodes[nodeIndex].dataOffset == nodes[nodeIndex].dataOffset);
+                REQUIRE(allocator.m_nodes[nodeIndex].dataSize == nodes[nodeIndex].dataSize);
+            }
+            REQUIRE(allocator.storageReport().largestFreeRegion == 2048);
+        }
+
+        SECTION("storage overflow")
+        {
+            OffsetAllocator::Allocator allocator(1024, 16);
+            REQUIRE(!allocator.growStorage(~(OffsetAllocator::Offset)0));
+            REQUIRE(allocator.m_size == 1024);
+        }
+
+        SECTION("nodes")
+        {
+            // 2 usable nodes: The free head and the used tail
+            OffsetAllocator::Allocator allocator(1024, 3);
+            OffsetAllocator::Allocation a = allocator.allocateHigh(512);
+            REQUIRE(a.offset == 512);
+
+            // Out of nodes and the last node is used
+            REQUIRE(!allocator.growStorage(1024));
+            REQUIRE(allocator.m_size == 1024);
+
+            // Old handles stay valid
+            REQUIRE(allocator.growNodes(64));
+            REQUIRE(allocator.m_maxAllocs == 64);
+            REQUIRE(allocator.growNodes(32));
+            REQUIRE(allocator.m_maxAllocs == 64);
+            REQUIRE(allocator.growStorage(1024));
+
+            std::vector<OffsetAllocator::Allocation> allocations = {a};
+            for (OffsetAllocator::Allocation b = allocator.allocate(64); b.offset != OffsetAllocator::Allocation::NO_SPACE; b = allocator.allocate(64))
+                allocations.push_back(b);
+            REQUIRE(allocations.size() == 1 + 8 + 16);
+            REQUIRE(allocator.storageReport().totalFreeSpace == 0);
+
+            REQUIRE(allocator.growNodes(128));
+            REQUIRE(allocator.growStorage(1024));
+            OffsetAllocator::Allocation b = allocator.allocate(1024);
+            REQUIRE(b.offset == 2048);
+            allocations.push_back(b);
+
+            for (OffsetAllocator::Allocation& allocation : allocations)
+                allocator.free(allocation);
+            REQUIRE(allocator.storageReport().largestFreeRegion == 3072);
+        }
+
+        SECTION("nodes with deferred frees")
+        {
+            OffsetAllocator::Allocator allocator(1024 * 1024, 8);
+            OffsetAllocator::Allocation a = allocator.allocate(1000);
+            OffsetAllocator::Allocation b = allocator.allocate(1000);
+            allocator.freeDeferred(a, 1);
+            REQUIRE(allocator.growNodes(1024));
+            allocator.freeDeferred(b, 2);
+
+            std::vector<OffsetAllocator::Allocation> allocations;
+            for (uint32 i = 0; i < 512; i++)
+                allocations.push_back(allocator.allocate(1000));
+            REQUIRE(allocations.back().offset != OffsetAllocator::Allocation::NO_SPACE);
+            allocator.retire(2);
+            for (OffsetAllocator::Allocation& allocation : allocations)
+                allocator.free(allocation);
+            REQUIRE(allocator.storageReport().largestFreeRegion == 1024 * 1024);
+        }
+
+        SECTION("random churn")
+        {
+            // Starts at 64KB / 16 nodes, grows whenever an allocation fails (nodes when out of them, else storage)
+            OffsetAllocator::Allocator allocator(64 * 1024, 16);
+            std::vector<OffsetAllocator::Allocation> live;
+            uint32 seed = 12345;
+            for (uint32 i = 0; i < 20000; i++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                if (live.size() >= 1000 || (live.size() > 0 && (seed >> 28) < 7))
+                {
+                    uint32 index = (seed >> 8) % live.size();
+                    allocator.free(live[index]);
+                    live[index] = live.back();
+                    live.pop_back();
+                    continue;
+                }
+
+                OffsetAllocator::Offset size = 1 + (seed >> 12) % (16 * 1024);
+                OffsetAllocator::Allocation a = allocator.allocate(size);
+                while (a.offset == OffsetAllocator::Allocation::NO_SPACE)
+                {
+                    if (allocator.m_freeOffset < 2)
+                        REQUIRE(allocator.growNodes(allocator.m_maxAllocs * 2));
+                    else
+                        REQUIRE(allocator.growStorage(16 * 1024));
+                    a = allocator.allocate(size);
+                }
+                live.push_back(a);
+            }
+            REQUIRE(allocator.m_maxAllocs > 16);
+            for (OffsetAllocator::Allocation a : live)
+                allocator.free(a);
+
+            REQUIRE(allocator.validate() == nullptr);
+
+            // Coalesced back to one node
+            uint32 freeNodes = 0;
+            for (uint32 count : allocator.m_binCounts)
+                freeNodes += count;
+            REQUIRE(freeNodes == 1);
+            REQUIRE(allocator.storageReport().totalFreeSpace == allocator.m_size);
+        }
+
+        SECTION("caller memory")
+        {
+            void* memory = ::operator new[](OffsetAllocator::Allocator::requiredMemorySize(16), std::align_val_t(64));
+            {
+                OffsetAllocator::Allocator allocator(1024, 16, memory);
+
+                // Storage grows, the node arrays can't be reallocated
+                REQUIRE(allocator.growStorage(1024));
+                REQUIRE(allocator.allocate(2048).offset == 0);
+                REQUIRE(!allocator.growNodes(32));
+                REQUIRE(allocator.growNodes(16));
+            }
+            ::operator delete[](memory, std::align_val_t(64));
+        }
+    }
+
+    TEST_CASE("deferred free", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256);
+
+        SECTION("retire by fence")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(1000);
+            OffsetAllocator::Allocation b = allocator.allocate(2000);
+            OffsetAllocator::Allocation c = allocator.allocate(3000);
+            OffsetAllocator::Allocation d = allocator.allocate(4000);
+            OffsetAllocator::Offset freeSpace = allocator.storageReport().totalFreeSpace;
+
+            allocator.freeDeferred(a, 1);
+            allocator.freeDeferred(c, 1);
+            allocator.freeDeferred(b, 2);
+            allocator.freeDeferred(d, 3);
+            REQUIRE(allocator.storageReport().totalFreeSpace == freeSpace);
+
+            allocator.retire(0);
+            REQUIRE(allocator.storageReport().totalFreeSpace == freeSpace);
+
+            allocator.retire(1);
+            REQUIRE(allocator.storageReport().totalFreeSpace == freeSpace + 4000);
+
+            // b merges with a and c: One region + the remainder merged with d later
+            allocator.retire(2);
+            REQUIRE(allocator.storageReport().totalFreeSpace == freeSpace + 6000);
+
+            allocator.retire(100);
+        }
+
+        SECTION("whole frame coalesces")
+        {
+            OffsetAllocator::Allocation allocations[64];
+            for (uint32 i = 0; i < 64; i++)
+                allocations[i] = allocator.allocate(100 + i);
+            OffsetAllocator::Allocation fence = allocator.allocate(10);
+
+            for (uint32 i = 0; i < 64; i++)
+                allocator.freeDeferred(allocations[(i * 37) % 64], 7);
+            allocator.retire(7);
+
+            // One region for the frame + the storage tail
+            OffsetAllocator::StorageReportFull report = allocator.storageReportFull();
+            uint32 regions = 0;
+            for (const OffsetAllocator::StorageReportFull::Region& region : report.freeRegions)
+                regions += region.count;
+            REQUIRE(regions == 2);
+
+            // Frame total = 8416: Bin size 8192 fits the combined region
+            OffsetAllocator::Allocation a = allocator.allocate(8192);
+            REQUIRE(a.offset == 0);
+            allocator.free(a);
+            allocator.free(fence);
+        }
+
+        SECTION("mixed with immediate frees")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(1000);
+            OffsetAllocator::Allocation b = allocator.allocate(1000);
+            OffsetAllocator::Allocation c = allocator.allocate(1000);
+            allocator.freeDeferred(b, 1);
+
+            // Deferred node stays used: a and c don't merge through it
+            allocator.free(a);
+            allocator.free(c);
+            OffsetAllocator::Allocation d = allocator.allocate(1500);
+            REQUIRE(d.offset == 2000);
+            allocator.free(d);
+
+            allocator.retire(1);
+        }
+
+        SECTION("more fences than segments")
+        {
+            // Ring overflow delays frees to a later fence, never earlier
+            std::vector<OffsetAllocator::Allocation> allocations;
+            for (uint32 i = 0; i < 40; i++)
+            {
+                allocations.push_back(allocator.allocate(1000));
+                allocator.allocate(1); // Separator (leaked, freed by reset)
+            }
+            OffsetAllocator::Offset freeSpace = allocator.storageReport().totalFreeSpace;
+            for (uint32 i = 0; i < 40; i++)
+                allocator.freeDeferred(allocations[i], i + 1);
+
+            for (uint32 fence = 1; fence <= 40; fence++)
+            {
+                allocator.retire(fence);
+                OffsetAllocator::Offset freed = allocator.storageReport().totalFreeSpace - freeSpace;
+                REQUIRE(freed <= fence * 1000);
+                if (fence < OffsetAllocator::Allocator::MAX_DEFERRED_FENCES) REQUIRE(freed == fence * 1000);
+            }
+            REQUIRE(allocator.storageReport().totalFreeSpace == freeSpace + 40 * 1000);
+            allocator.reset();
+        }
+
+        SECTION("defragment skips deferred")
+        {
+            OffsetAllocator::Allocation a = allocator.allocate(1000);
+            OffsetAllocator::Allocation b = allocator.allocate(1000);
+            OffsetAllocator::Allocation c = allocator.allocate(1000);
+            OffsetAllocator::Allocation d = allocator.allocate(1000);
+            OffsetAllocator::Allocation e = allocator.allocate(1000);
+            allocator.free(a);
+            allocator.freeDeferred(b, 1);
+            allocator.free(d);
+
+            // [free][deferred b][c][free][e][tail]: Only e moves
+            OffsetAllocator::Relocation relocations[8];
+            uint32 count = allocator.defragment(relocations);
+            REQUIRE(count == 1);
+            REQUIRE(relocations[0].allocation.metadata == e.metadata);
+            REQUIRE(relocations[0].newOffset == 3000);
+
+            allocator.retire(1);
+            allocator.free(c);
+            allocator.free(relocations[0].allocation);
+        }
+
+        OffsetAllocator::Allocation validateAll = allocator.allocate(1024 * 1024 * 256);
+        REQUIRE(validateAll.offset == 0);
+        allocator.free(validateAll);
+    }
+
+    TEST_CASE("snapshot", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256, 1024);
+        OffsetAllocator::Allocation a = allocator.allocate(1337);
+        OffsetAllocator::Allocation b = allocator.allocate(123);
+        OffsetAllocator::Allocation c = allocator.allocate(4096);
+        OffsetAllocator::Allocation d = allocator.allocate(1000);
+        allocator.free(b);
+        allocator.freeDeferred(c, 5);
+
+        size_t snapshotSize = allocator.snapshotSize();
+        void* snapshot = ::operator new[](snapshotSize, std::align_val_t(64));
+        allocator.saveSnapshot(snapshot);
+        REQUIRE(OffsetAllocator::Allocator::isValidSnapshot(snapshot, snapshotSize));
+        REQUIRE(!OffsetAllocator::Allocator::isValidSnapshot(snapshot, snapshotSize - 1));
+
+        // Restored allocator continues exactly where the saved one was
+        OffsetAllocator::Allocation expected = allocator.allocate(123);
+        allocator.free(expected);
+        auto validateRestored = [&](OffsetAllocator::Allocator& restored)
+        {
+            REQUIRE(restored.storageReport().totalFreeSpace == allocator.storageReport().totalFreeSpace);
+            REQUIRE(restored.allocationSize(a) == 1337);
+            REQUIRE(restored.allocationSize(d) == 1000);
+
+            OffsetAllocator::Allocation e = restored.allocate(123);
+            REQUIRE(e.offset == expected.offset);
+            REQUIRE(e.metadata == expected.metadata);
+
+            restored.retire(5);
+            restored.free(a);
+            restored.free(d);
+            restored.free(e);
+
+            OffsetAllocator::Allocation validateAll = restored.allocate(1024 * 1024 * 256);
+            REQUIRE(validateAll.offset == 0);
+            restored.free(validateAll);
+        };
+
+        SECTION("load")
+        {
+            OffsetAllocator::Allocator restored(1024, 1024);
+            REQUIRE(restored.loadSnapshot(snapshot, snapshotSize));
+            validateRestored(restored);
+        }
+
+        SECTION("in place")
+        {
+            OffsetAllocator::Allocator restored = OffsetAllocator::Allocator::restoreSnapshotInPlace(snapshot, snapshotSize);
+            REQUIRE((OffsetAllocator::uint8*)restored.m_nodes > (OffsetAllocator::uint8*)snapshot);
+            REQUIRE((OffsetAllocator::uint8*)restored.m_freeNodes < (OffsetAllocator::uint8*)snapshot + snapshotSize);
+            validateRestored(restored);
+        }
+
+        SECTION("incompatible")
+        {
+            // maxAllocs mismatch: Allocator is left untouched
+            OffsetAllocator::Allocator other(1024, 2048);
+            REQUIRE(!other.loadSnapshot(snapshot, snapshotSize));
+            REQUIRE(other.allocate(1024).offset == 0);
+
+            // Corrupted magic
+            ((OffsetAllocator::uint32*)snapshot)[0] ^= 1;
+            REQUIRE(!OffsetAllocator::Allocator::isValidSnapshot(snapshot, snapshotSize));
+            OffsetAllocator::Allocator restored(1024, 1024);
+            REQUIRE(!restored.loadSnapshot(snapshot, snapshotSize));
+
+            OffsetAllocator::Allocator empty = OffsetAllocator::Allocator::restoreSnapshotInPlace(snapshot, snapshotSize);
+            REQUIRE(empty.allocate(1).offset == OffsetAllocator::Allocation::NO_SPACE);
+        }
+
+        ::operator delete[](snapshot, std::align_val_t(64));
+
+        allocator.retire(5);
+        allocator.free(a);
+        allocator.free(d);
+    }
+
+#ifdef USE_ALLOCATION_TRACE
+    TEST_CASE("trace", "[offsetAllocator]")
+    {
+        OffsetAllocator::TraceRing ring(1024);
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256, 1024);
+        allocator.setTrace(&ring);
+
+        // Every traced operation kind
+        OffsetAllocator::Allocation a = allocator.allocate(1337);
+        OffsetAllocator::Allocation b = allocator.allocate(1000, 256);
+        OffsetAllocator::Offset sizes[] = {256, 1024, 64};
+        OffsetAllocator::Allocation batch[3];
+        REQUIRE(allocator.allocateBatch(sizes, batch));
+        allocator.free(a);
+        allocator.freeDeferred(b, 1);
+        allocator.setAllocationPolicy(OffsetAllocator::AllocationPolicy::BestFit);
+        OffsetAllocator::Allocation c = allocator.allocate(500);
+        OffsetAllocator::Allocation h = allocator.allocateHigh(4096);
+        REQUIRE(allocator.shrink(h, 1024));
+        REQUIRE(!allocator.tryGrow(h, 8192));
+        REQUIRE(allocator.growNodes(2048));
+        REQUIRE(allocator.growStorage(1024 * 1024));
+        allocator.free(batch[0]);
+        OffsetAllocator::Relocation relocations[8];
+        uint32 relocationCount = allocator.defragment(relocations);
+        REQUIRE(relocationCount > 0);
+        allocator.retire(1);
+        allocator.freeBatch(std::span(batch + 1, 2));
+        (void)c;
+        (void)h;
+
+        std::vector<OffsetAllocator::TraceRecord> records;
+        uint32 recordCount = ring.drain(records);
+        REQUIRE(recordCount == 22);
+        REQUIRE(records[0].op == OffsetAllocator::TraceOp::Begin);
+        REQUIRE(ring.dropped() == 0);
+        REQUIRE(ring.drain(records) == 0);
+
+        const char* path = "offsetAllocatorTests.trace";
+        REQUIRE(OffsetAllocator::saveTrace(path, records));
+        std::vector<OffsetAllocator::TraceRecord> loaded;
+        REQUIRE(OffsetAllocator::loadTrace(path, loaded));
+        std::remove(path);
+        REQUIRE(loaded.size() == records.size());
+        REQUIRE(memcmp(loaded.data(), records.data(), sizeof(OffsetAllocator::TraceRecord) * records.size()) == 0);
+
+        SECTION("replay")
+        {
+            OffsetAllocator::TraceReplayer replayer(loaded);
+            REQUIRE(replayer.storageSize() == 1024 * 1024 * 256);
+            REQUIRE(replayer.maxAllocs() == 1024);
+
+            OffsetAllocator::Allocator replayed(replayer.storageSize(), replayer.maxAllocs());
+            uint32 steps = 0;
+            while (replayer.step(replayed))
+            {
+                if (replayer.lastRecords()[0].op == OffsetAllocator::TraceOp::Defragment)
+                    REQUIRE(replayer.lastRelocations().size() == relocationCount);
+                steps++;
+            }
+            REQUIRE(steps == 17);
+            REQUIRE(replayer.position() == loaded.size());
+            REQUIRE(!replayer.diverged());
+            REQUIRE(replayed.m_size == allocator.m_size);
+            REQUIRE(replayed.m_maxAllocs == allocator.m_maxAllocs);
+            REQUIRE(replayed.storageReport().totalFreeSpace == allocator.storageReport().totalFreeSpace);
+            REQUIRE(replayed.storageReport().largestFreeRegion == allocator.storageReport().largestFreeRegion);
+        }
+
+        SECTION("diverged replay")
+        {
+            // Not the traced start state: Stops at the first allocate that differs
+            OffsetAllocator::TraceReplayer replayer(loaded);
+            OffsetAllocator::Allocator replayed(1024 * 1024 * 256, 1024);
+            OffsetAllocator::Allocation existing = replayed.allocate(1);
+            std::vector<OffsetAllocator::TraceRecord> withoutBegin(loaded.begin() + 1, loaded.end());
+            OffsetAllocator::TraceReplayer replayerWithoutBegin(withoutBegin);
+            REQUIRE(replayerWithoutBegin.step(replayed));
+            REQUIRE(replayerWithoutBegin.diverged());
+            REQUIRE(!replayerWithoutBegin.step(replayed));
+            replayed.free(existing);
+
+            // Different storage size: Begin doesn't match, nothing is replayed
+            OffsetAllocator::Allocator small(1024, 1024);
+            REQUIRE(replayer.step(small));
+            REQUIRE(replayer.diverged());
+            REQUIRE(!replayer.step(small));
+            REQUIRE(small.storageReport().totalFreeSpace == 1024);
+        }
+
+        SECTION("full ring drops")
+        {
+            OffsetAllocator::TraceRing small(4);
+            allocator.setTrace(&small);
+            for (uint32 i = 0; i < 8; i++)
+                allocator.free(allocator.allocate(16));
+            REQUIRE(small.dropped() == 13);
+
+            records.clear();
+            REQUIRE(small.drain(records) == 4);
+            REQUIRE(records[0].op == OffsetAllocator::TraceOp::Begin);
+            allocator.setTrace(nullptr);
+        }
+    }
+#endif
+
+#ifdef USE_ALLOCATOR_STATS
+    TEST_CASE("stats", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator allocator(1024 * 1024 * 256, 1024);
+        const OffsetAllocator::AllocatorStats& stats = allocator.stats();
+
+        auto binAllocations = [&]()
+        {
+            uint64 sum = 0;
+            for (uint64 count : stats.binAllocations) sum += count;
+            return sum;
+        };
+
+        // Both served by the 256MB node: Remainder split, higher top bin
+        OffsetAllocator::Allocation a = allocator.allocate(1337);
+        OffsetAllocator::Allocation b = allocator.allocate(2000);
+        REQUIRE(stats.allocations == 2);
+        REQUIRE(stats.splits == 2);
+        REQUIRE(stats.topBinFallbacks == 2);
+        REQUIRE(binAllocations() == 2);
+
+        // b merges with a and the remainder
+        allocator.free(a);
+        REQUIRE(stats.merges == 0);
+        allocator.free(b);
+        REQUIRE(stats.frees == 2);
+        REQUIRE(stats.merges == 2);
+
+        REQUIRE(allocator.allocate(1024 * 1024 * 512).offset == OffsetAllocator::Allocation::NO_SPACE);
+        REQUIRE(stats.failedAllocations == 1);
+
+        // Batch fast path: One bin search, three handles. freeBatch coalesces the run once.
+        OffsetAllocator::Offset sizes[] = {256, 1024, 64};
+        OffsetAllocator::Allocation batch[3];
+        REQUIRE(allocator.allocateBatch(sizes, batch));
+        REQUIRE(stats.allocations == 5);
+        REQUIRE(binAllocations() == 3);
+        allocator.freeBatch(batch);
+        REQUIRE(stats.frees == 5);
+        REQUIRE(stats.merges == 5);
+
+        // Free list depth
+        std::vector<OffsetAllocator::Allocation> allocations;
+        for (uint32 i = 0; i < 16; i++)
+            allocations.push_back(allocator.allocate(1024));
+        for (uint32 i = 0; i < 16; i += 2)
+            allocator.free(allocations[i]);
+        uint32 bin = OffsetAllocator::SmallFloat::uintToFloatRoundDown(1024);
+        REQUIRE(allocator.m_binCounts[bin] == 8);
+        REQUIRE(stats.binPeakDepth[bin] == 8);
+        REQUIRE(stats.binInserts[bin] == 8);
+
+        // Repeated size: The freed 1024 nodes serve it from its own round up bin. The bin cache saw 1024 before.
+        uint64 minBinHits = stats.minBinHits;
+        allocator.allocate(1024);
+        REQUIRE(stats.minBinHits == minBinHits + 1);
+#ifdef USE_BIN_CACHE
+        REQUIRE(stats.binCacheHits == 16);
+#else
+        REQUIRE(stats.binCacheHits == 0);
+#endif
+
+        allocator.resetStats();
+        REQUIRE(stats.allocations == 0);
+        REQUIRE(stats.binPeakDepth[bin] == 0);
+    }
+#endif
+
+    TEST_CASE("concurrent", "[offsetAllocator]")
+    {
+        OffsetAllocator::ConcurrentAllocator allocator(1024 * 1024 * 256, 128 * 1024, 8);
+
+        SECTION("single thread")
+        {
+            // Size class rounding: every range from the cache fits the size
+            OffsetAllocator::Allocation a = allocator.allocate(0, 1000);
+            OffsetAllocator::Allocation b = allocator.allocate(0, 1000);
+            REQUIRE(a.offset != OffsetAllocator::Allocation::NO_SPACE);
+            REQUIRE(b.offset != OffsetAllocator::Allocation::NO_SPACE);
+            REQUIRE((b.offset >= a.offset + 1000 || a.offset >= b.offset + 1000));
+
+            // Uncached size goes straight to the shared allocator
+            OffsetAllocator::Allocation c = allocator.allocate(0, 1024 * 1024);
+            REQUIRE(c.offset != OffsetAllocator::Allocation::NO_SPACE);
+
+            allocator.free(0, a);
+            allocator.free(1, b);
+            allocator.free(2, c);
+            allocator.flushCaches();
+
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 * 256);
+            REQUIRE(report.largestFreeRegion == 1024 * 1024 * 256);
+        }
+
+        SECTION("threads with cross thread frees")
+        {
+            // Every thread frees the previous thread's allocations: drives the remote free queues
+            static constexpr uint32 THREADS = 8;
+            static constexpr uint32 ALLOCS = 20000;
+            std::vector<OffsetAllocator::Allocation> results[THREADS];
+            std::atomic<uint32> failures = 0;
+            std::vector<std::thread> threads;
+            for (uint32 t = 0; t < THREADS; t++)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    for (uint32 i = 0; i < ALLOCS; i++)
+                    {
+                        // NOTE: Catch2 assertions are not thread safe. Count failures and check after join.
+                        OffsetAllocator::Allocation a = allocator.allocate(t, 16 + (i * 31 + t * 7) % 3000);
+                        if (a.offset == OffsetAllocator::Allocation::NO_SPACE)
+                        {
+                            failures++;
+                            continue;
+                        }
+                        results[t].push_back(a);
+                        if (i % 3 == 0)
+                        {
+                            allocator.free(t, results[t].back());
+                            results[t].pop_back();
+                        }
+                    }
+                });
+            }
+            for (std::thread& thread : threads) thread.join();
+            threads.clear();
+            REQUIRE(failures == 0);
+
+            for (uint32 t = 0; t < THREADS; t++)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    for (OffsetAllocator::Allocation a : results[(t + 1) % THREADS])
+                        allocator.free(t, a);
+                });
+            }
+            for (std::thread& thread : threads) thread.join();
+
+            allocator.flushCaches();
+
+            // End: Validate that allocator has no fragmentation left. Should be 100% clean.
+            OffsetAllocator::StorageReport report = allocator.storageReport();
+            REQUIRE(report.totalFreeSpace == 1024 * 1024 * 256);
+            REQUIRE(report.largestFreeRegion == 1024 * 1024 * 256);
+        }
+    }
+
+    TEST_CASE("heap pool", "[offsetAllocator]")
+    {
+        struct Listener : OffsetAllocator::HeapPoolListener
+        {
+            bool heapCreated(uint32 heap, OffsetAllocator::Offset size) override
+            {
+                if (failCreate) return false;
+                created.push_back({heap, size});
+                return true;
+            }
+            void heapReleased(uint32 heap) override { released.push_back(heap); }
+
+            bool failCreate = false;
+            std::vector<std::pair<uint32, OffsetAllocator::Offset>> created;
+            std::vector<uint32> released;
+        };
+
+        Listener listener;
+        OffsetAllocator::HeapPool pool(1024 * 1024, 1024, 4);
+        pool.setListener(&listener);
+        REQUIRE(pool.heapCount() == 0);
+
+        SECTION("grow on demand")
+        {
+            // Fills the first heap, the next request creates a second one
+            OffsetAllocator::PoolAllocation a = pool.allocate(768 * 1024);
+            OffsetAllocator::PoolAllocation b = pool.allocate(512 * 1024);
+            OffsetAllocator::PoolAllocation c = pool.allocate(128 * 1024);
+            REQUIRE(a.heap == 0);
+            REQUIRE(b.heap == 1);
+            REQUIRE(c.heap == 0);
+            REQUIRE(a.allocation.offset == 0);
+            REQUIRE(b.allocation.offset == 0);
+            REQUIRE(c.allocation.offset == 768 * 1024);
+            REQUIRE(pool.heapCount() == 2);
+            REQUIRE(listener.created.size() == 2);
+            REQUIRE(listener.created[1].second == 1024 * 1024);
+
+            // Oversized: Dedicated heap of the bin size
+            OffsetAllocator::PoolAllocation d = pool.allocate(3 * 1024 * 1024);
+            REQUIRE(d.heap == 2);
+            REQUIRE(listener.created[2].second >= 3 * 1024 * 1024);
+            REQUIRE(pool.allocationSize(d) == 3 * 1024 * 1024);
+
+            OffsetAllocator::StorageReport report = pool.storageReport();
+            REQUIRE(report.largestFreeRegion == 512 * 1024);
+
+            // Max heaps reached
+            OffsetAllocator::PoolAllocation e = pool.allocate(1024 * 1024);
+            REQUIRE(e.heap == 3);
+            OffsetAllocator::PoolAllocation f = pool.allocate(1024 * 1024);
+            REQUIRE(f.heap == OffsetAllocator::PoolAllocation::NO_HEAP);
+            REQUIRE(f.allocation.offset == OffsetAllocator::Allocation::NO_SPACE);
+
+            pool.free(a);
+            pool.free(b);
+            pool.free(c);
+            pool.free(d);
+            pool.free(e);
+            pool.free(f);
+            report = pool.storageReport();
+            REQUIRE(report.totalFreeSpace == OffsetAllocator::Offset(4 * 1024 * 1024 + listener.created[2].second - 1024 * 1024));
+        }
+
+        SECTION("prefer non-empty heaps")
+        {
+            OffsetAllocator::PoolAllocation a = pool.allocate(1024 * 1024);
+            OffsetAllocator::PoolAllocation b = pool.allocate(1000);
+            REQUIRE(a.heap == 0);
+            REQUIRE(b.heap == 1);
+
+            // Heap 0 is empty again: Small requests keep going to heap 1 so heap 0 can drain
+            pool.free(a);
+            OffsetAllocator::PoolAllocation c = pool.allocate(1000);
+            REQUIRE(c.heap == 1);
+
+            // Only the empty heap fits
+            OffsetAllocator::PoolAllocation d = pool.allocate(1024 * 1024);
+            REQUIRE(d.heap == 0);
+
+            pool.free(b);
+            pool.free(c);
+            pool.free(d);
+        }
+
+        SECTION("release empty heaps")
+        {
+            pool.setReleaseDelay(2);
+            pool.releaseEmptyHeaps(10);
+
+            OffsetAllocator::PoolAllocation a = pool.allocate(1024 * 1024);
+            OffsetAllocator::PoolAllocation b = pool.allocate(1000);
+            pool.free(a);
+
+            pool.releaseEmptyHeaps(11);
+            REQUIRE(pool.heapCount() == 2);
+            pool.releaseEmptyHeaps(12);
+            REQUIRE(pool.heapCount() == 1);
+            REQUIRE(listener.released == std::vector<uint32>{0});
+            REQUIRE(pool.heap(0) == nullptr);
+
+            // Released index is reused
+            OffsetAllocator::PoolAllocation c = pool.allocate(1024 * 1024);
+            REQUIRE(c.heap == 0);
+
+            // Reused before the delay: Not released
+            pool.free(b);
+            pool.releaseEmptyHeaps(13);
+            b = pool.allocate(1000);
+            REQUIRE(b.heap == 1);
+            pool.releaseEmptyHeaps(20);
+            REQUIRE(pool.heapCount() == 2);
+
+            pool.free(b);
+            pool.free(c);
+            pool.reset();
+            REQUIRE(pool.heapCount() == 0);
+            REQUIRE(listener.released.size() == 3);
+        }
+
+        SECTION("aligned size overflow")
+        {
+            // size + alignment - 1 would wrap: Fails without creating a heap
+            for (OffsetAllocator::Offset size : {OffsetAllocator::Allocation::NO_SPACE, OffsetAllocator::Allocation::NO_SPACE - 100})
+            {
+                OffsetAllocator::PoolAllocation a = pool.allocate(size, 256);
+                REQUIRE(a.heap == OffsetAllocator::PoolAllocation::NO_HEAP);
+                REQUIRE(a.allocation.offset == OffsetAllocator::Allocation::NO_SPACE);
+            }
+            REQUIRE(pool.heapCount() == 0);
+            REQUIRE(listener.created.empty());
+        }
+
+        SECTION("size above the largest bin")
+        {
+            // Rounds up to the bin of 2^32 (2^64 with 64 bit offsets): Its size wraps to 0. Fails without creating a heap.
+            for (OffsetAllocator::Offset size : {OffsetAllocator::Allocation::NO_SPACE - 255, OffsetAllocator::Allocation::NO_SPACE})
+            {
+                OffsetAllocator::PoolAllocation a = pool.allocate(size);
+                REQUIRE(a.heap == OffsetAllocator::PoolAllocation::NO_HEAP);
+                REQUIRE(a.allocation.offset == OffsetAllocator::Allocation::NO_SPACE);
+            }
+            OffsetAllocator::PoolAllocation b = pool.allocate(OffsetAllocator::Allocation::NO_SPACE - 1024, 256);
+            REQUIRE(b.heap == OffsetAllocator::PoolAllocation::NO_HEAP);
+            REQUIRE(pool.heapCount() == 0);
+            REQUIRE(listener.created.empty());
+        }
+
+        SECTION("listener failure")
+        {
+            listener.failCreate = true;
+            OffsetAllocator::PoolAllocation a = pool.allocate(1000);
+            REQUIRE(a.heap == OffsetAllocator::PoolAllocation::NO_HEAP);
+            REQUIRE(pool.heapCount() == 0);
+        }
+
+        SECTION("random churn")
+        {
+            // At most 1000 live allocations of up to 64KB (~32MB): 64 heaps of 1MB always have room
+            OffsetAllocator::HeapPool bigPool(1024 * 1024, 1024, 64);
+            std::vector<OffsetAllocator::PoolAllocation> live;
+            uint32 seed = 12345;
+            for (uint32 i = 0; i < 20000; i++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                if (live.size() >= 1000 || (live.size() > 0 && (seed >> 28) < 8))
+                {
+                    uint32 index = (seed >> 8) % live.size();
+                    bigPool.free(live[index]);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+                else
+                {
+                    OffsetAllocator::PoolAllocation a = bigPool.allocate(1 + (seed >> 12) % (64 * 1024));
+                    REQUIRE(a.heap != OffsetAllocator::PoolAllocation::NO_HEAP);
+                    live.push_back(a);
+                }
+                if ((i % 100) == 0) bigPool.releaseEmptyHeaps(i / 100);
+            }
+            for (OffsetAllocator::PoolAllocation a : live)
+                bigPool.free(a);
+            bigPool.releaseEmptyHeaps(1000);
+            REQUIRE(bigPool.heapCount() == 0);
+        }
+    }
+
+    TEST_CASE("slab allocator", "[offsetAllocator]")
+    {
+        OffsetAllocator::Allocator parent(1024 * 1024, 1024);
+        OffsetAllocator::SlabAllocator slabs(parent, 16);
+        REQUIRE(slabs.slabCount() == 0);
+
+        SECTION("size classes")
+        {
+            // Every size maps to the smallest class that fits it
+            for (OffsetAllocator::Offset size = 0; size <= OffsetAllocator::SlabAllocator::MAX_SLAB_SIZE; size++)
+            {
+                uint32 sizeClass = OffsetAllocator::SlabAllocator::sizeClass(size);
+                REQUIRE(sizeClass < OffsetAllocator::SlabAllocator::NUM_SIZE_CLASSES);
+                REQUIRE(OffsetAllocator::SlabAllocator::classSize(sizeClass) >= size);
+                if (sizeClass > 0) REQUIRE(OffsetAllocator::SlabAllocator::classSize(sizeClass - 1) < size);
+            }
+            REQUIRE(OffsetAllocator::SlabAllocator::sizeClass(12) == 1);
+            REQUIRE(OffsetAllocator::SlabAllocator::sizeClass(13) == 2);
+            REQUIRE(OffsetAllocator::SlabAllocator::sizeClass(256) == 10);
+        }
+
+        SECTION("blocks")
+        {
+            // One parent allocation per slab: 64 blocks of 24 back to back
+            OffsetAllocator::SlabAllocation a = slabs.allocate(20);
+            REQUIRE(a.slab == 0);
+            REQUIRE(a.allocation.offset == 0);
+            REQUIRE(slabs.allocationSize(a) == 24);
+            REQUIRE(parent.storageReport().totalFreeSpace == 1024 * 1024 - 24 * 64);
+
+            std::vector<OffsetAllocator::SlabAllocation> blocks = {a};
+            for (uint32 i = 1; i < 64; i++)
+            {
+                blocks.push_back(slabs.allocate(24));
+                REQUIRE(blocks[i].slab == 0);
+                REQUIRE(blocks[i].allocation.offset == i * 24);
+            }
+            REQUIRE(slabs.m_partialSlabs[3] == OffsetAllocator::SlabAllocator::Slab::unused);
+
+            // Slab full: Second slab
+            OffsetAllocator::SlabAllocation b = slabs.allocate(17);
+            REQUIRE(b.slab == 1);
+            REQUIRE(b.allocation.offset == 24 * 64);
+            REQUIRE(slabs.slabCount() == 2);
+
+            // A freed block is reused first
+            slabs.free(blocks[10]);
+            blocks[10] = slabs.allocate(24);
+            REQUIRE(blocks[10].slab == 0);
+            REQUIRE(blocks[10].allocation.offset == 240);
+
+            // Other classes get their own slabs
+            OffsetAllocator::SlabAllocation c = slabs.allocate(1);
+            REQUIRE(c.slab == 2);
+            REQUIRE(slabs.allocationSize(c) == 8);
+
+            slabs.free(b);
+            slabs.free(c);
+            for (OffsetAllocator::SlabAllocation block : blocks)
+                slabs.free(block);
+            REQUIRE(slabs.slabCount() == 2);
+            slabs.releaseEmptySlabs();
+            REQUIRE(slabs.slabCount() == 0);
+            REQUIRE(parent.storageReport().totalFreeSpace == 1024 * 1024);
+            REQUIRE(parent.validate() == nullptr);
+        }
+
+        SECTION("empty slabs")
+        {
+            // Two slabs of the class: The first one to get empty is kept, the second one goes back to the parent
+            std::vector<OffsetAllocator::SlabAllocation> blocks;
+            for (uint32 i = 0; i < 128; i++)
+                blocks.push_back(slabs.allocate(64));
+            REQUIRE(slabs.slabCount() == 2);
+
+            for (uint32 i = 0; i < 64; i++)
+                slabs.free(blocks[i]);
+            REQUIRE(slabs.slabCount() == 2);
+            REQUIRE(slabs.m_emptySlabs[6] == 0);
+
+            // The kept slab serves the class again
+            blocks[0] = slabs.allocate(50);
+            REQUIRE(blocks[0].slab == 0);
+            REQUIRE(slabs.m_emptySlabs[6] == OffsetAllocator::SlabAllocator::Slab::unused);
+            slabs.free(blocks[0]);
+
+            for (uint32 i = 64; i < 128; i++)
+                slabs.free(blocks[i]);
+            REQUIRE(slabs.slabCount() == 1);
+
+            slabs.reset();
+            REQUIRE(slabs.slabCount() == 0);
+            REQUIRE(parent.storageReport().totalFreeSpace == 1024 * 1024);
+        }
+
+        SECTION("parent fallback")
+        {
+            // Large sizes go to the parent
+            OffsetAllocator::SlabAllocation a = slabs.allocate(257);
+            REQUIRE(a.slab == OffsetAllocator::SlabAllocation::NO_SLAB);
+            REQUIRE(slabs.allocationSize(a) == 257);
+            REQUIRE(slabs.slabCount() == 0);
+            slabs.free(a);
+
+            // Out of slabs: Tiny sizes go to the parent too
+            OffsetAllocator::SlabAllocator fewSlabs(parent, 1);
+            OffsetAllocator::SlabAllocation b = fewSlabs.allocate(8);
+            OffsetAllocator::SlabAllocation c = fewSlabs.allocate(16);
+            REQUIRE(b.slab == 0);
+            REQUIRE(c.slab == OffsetAllocator::SlabAllocation::NO_SLAB);
+            REQUIRE(fewSlabs.allocationSize(c) == 16);
+            fewSlabs.free(b);
+            fewSlabs.free(c);
+            fewSlabs.reset();
+
+            // Parent out of space: NO_SPACE result, free of it is a no-op
+            OffsetAllocator::Allocator tiny(256, 16);
+            OffsetAllocator::SlabAllocator tinySlabs(tiny, 16);
+            OffsetAllocator::SlabAllocation d = tinySlabs.allocate(200);
+            REQUIRE(d.slab == OffsetAllocator::SlabAllocation::NO_SLAB);
+            OffsetAllocator::SlabAllocation e = tinySlabs.allocate(100);
+            REQUIRE(e.allocation.offset == OffsetAllocator::Allocation::NO_SPACE);
+            tinySlabs.free(e);
+            tinySlabs.free(d);
+            REQUIRE(tiny.storageReport().totalFreeSpace == 256);
+        }
+
+        SECTION("random churn")
+        {
+            // Mixed tiny and large sizes. Live ranges never overlap, the parent stays valid.
+            OffsetAllocator::Allocator bigParent(16 * 1024 * 1024, 4096);
+            OffsetAllocator::SlabAllocator bigSlabs(bigParent, 256);
+            std::vector<OffsetAllocator::SlabAllocation> live;
+            std::vector<OffsetAllocator::uint8> owner(16 * 1024 * 1024, 0);
+            uint32 seed = 12345;
+            for (uint32 i = 0; i < 20000; i++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                if (live.size() >= 2000 || (live.size() > 0 && (seed >> 28) < 7))
+                {
+                    uint32 index = (seed >> 8) % live.size();
+                    OffsetAllocator::SlabAllocation a = live[index];
+                    memset(&owner[a.allocation.offset], 0, bigSlabs.allocationSize(a));
+                    bigSlabs.free(a);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+                else
+                {
+                    OffsetAllocator::Offset size = (seed >> 12) % 16 == 0 ? 1 + (seed >> 16) % 4096 : 1 + (seed >> 16) % 256;
+                    OffsetAllocator::SlabAllocation a = bigSlabs.allocate(size);
+                    REQUIRE(a.allocation.offset != OffsetAllocator::Allocation::NO_SPACE);
+                    REQUIRE(bigSlabs.allocationSize(a) >= size);
+                    auto begin = owner.begin() + a.allocation.offset;
+                    REQUIRE(std::all_of(begin, begin + size, [](OffsetAllocator::uint8 v) { return v == 0; }));
+                    std::fill(begin, begin + size, (OffsetAllocator::uint8)1);
+                    live.push_back(a);
+                }
+                if ((i % 1000) == 0) REQUIRE(bigParent.validate() == nullptr);
+            }
+            for (OffsetAllocator::SlabAllocation a : live)
+                bigSlabs.free(a);
+            bigSlabs.releaseEmptySlabs();
+            REQUIRE(bigSlabs.slabCount() == 0);
+            REQUIRE(bigParent.storageReport().totalFreeSpace == 16 * 1024 * 1024);
+        }
+    }
+
+    TEST_CASE("partitioned allocator", "[offsetAllocator]")
+    {
+        struct Memory : OffsetAllocator::PartitionMemory
+        {
+            void* allocateMetadata(uint32 partition, size_t size) override
+            {
+                if (partition == heapPartition) return nullptr;
+                void* memory = ::operator new(size, std::align_val_t(64));
+                blocks.push_back({partition, memory, size});
+                return memory;
+            }
+            void freeMetadata(uint32 partition, void* memory, size_t size) override
+            {
+                freed.push_back({partition, memory, size});
+                ::operator delete(memory, std::align_val_t(64));
+            }
+
+            struct Block
+            {
+                uint32 partition;
+                void* memory;
+                size_t size;
+            };
+            uint32 heapPartition = 0xffffffff;
+            std::vector<Block> blocks;
+            std::vector<Block> freed;
+        };
+
+        const OffsetAllocator::PartitionDesc descs[] = {{.size = 1024, .maxAllocs = 64}, {.size = 2048, .maxAllocs = 64}, {.size = 4096, .maxAllocs = 128}};
+
+        SECTION("local first")
+        {
+            OffsetAllocator::PartitionedAllocator partitions(descs);
+            REQUIRE(partitions.partitionCount() == 3);
+            for (uint32 i = 0; i < 3; i++)
+            {
+                OffsetAllocator::PartitionAllocation a = partitions.allocate(i, 100);
+                REQUIRE(a.partition == i);
+                REQUIRE(a.allocation.offset == 0);
+                REQUIRE(partitions.allocationSize(a) == 100);
+                REQUIRE(partitions.stats(i).localAllocations == 1);
+            }
+            REQUIRE(partitions.storageReport().totalFreeSpace == 1024 + 2048 + 4096 - 300);
+
+            // Aligned allocations route the same way
+            OffsetAllocator::PartitionAllocation b = partitions.allocate(1, 64, 256);
+            REQUIRE(b.partition == 1);
+            REQUIRE(b.allocation.offset == 256);
+        }
+
+        SECTION("stealing")
+        {
+            OffsetAllocator::PartitionedAllocator partitions(descs);
+
+            // Default order: Next partitions round robin
+            REQUIRE(std::ranges::equal(partitions.stealOrder(0), std::vector<uint32>{1, 2}));
+            REQUIRE(std::ranges::equal(partitions.stealOrder(2), std::vector<uint32>{0, 1}));
+
+            // Closest first: 0 -> 2 -> 1. 1 is unreachable from 2.
+            const uint32 distances[] = {
+                10, 30, 20,
+                20, 10, 20,
+                21, OffsetAllocator::PartitionedAllocator::UNREACHABLE, 10};
+            partitions.setDistances(distances);
+            REQUIRE(std::ranges::equal(partitions.stealOrder(0), std::vector<uint32>{2, 1}));
+            REQUIRE(std::ranges::equal(partitions.stealOrder(1), std::vector<uint32>{0, 2}));
+            REQUIRE(std::ranges::equal(partitions.stealOrder(2), std::vector<uint32>{0}));
+
+            OffsetAllocator::PartitionAllocation a = partitions.allocate(0, 1024);
+            REQUIRE(a.partition == 0);
+            OffsetAllocator::PartitionAllocation b = partitions.allocate(0, 1024);
+            REQUIRE(b.partition == 2);
+            REQUIRE(partitions.stats(0).localAllocations == 1);
+            REQUIRE(partitions.stats(0).stolenAllocations == 1);
+
+            // Too large for 2 and 0, 1 can't be stolen from
+            OffsetAllocator::PartitionAllocation c = partitions.allocate(2, 2048 + 1024);
+            REQUIRE(c.partition == 2);
+            OffsetAllocator::PartitionAllocation d = partitions.allocate(2, 2048);
+            REQUIRE(d.partition == OffsetAllocator::PartitionAllocation::NO_PARTITION);
+            REQUIRE(d.allocation.offset == OffsetAllocator::Allocation::NO_SPACE);
+            REQUIRE(partitions.stats(2).failedAllocations == 1);
+
+            // Freed stolen space is reused by its own partition
+            partitions.free(b);
+            partitions.free(c);
+            OffsetAllocator::PartitionAllocation e = partitions.allocate(2, 4096);
+            REQUIRE(e.partition == 2);
+            REQUIRE(e.allocation.offset == 0);
+
+            // No stealing
+            partitions.setStealOrder(0, {});
+            REQUIRE(partitions.allocate(0, 16).partition == OffsetAllocator::PartitionAllocation::NO_PARTITION);
+            partitions.setStealOrder(0, std::vector<uint32>{1});
+            REQUIRE(partitions.allocate(0, 16).partition == 1);
+        }
+
+        SECTION("aligned size overflow")
+        {
+            // size + alignment - 1 would wrap: Fails on every partition, nothing allocated
+            OffsetAllocator::PartitionedAllocator partitions(descs);
+            for (OffsetAllocator::Offset size : {OffsetAllocator::Allocation::NO_SPACE, OffsetAllocator::Allocation::NO_SPACE - 100})
+            {
+                OffsetAllocator::PartitionAllocation a = partitions.allocate(0, size, 256);
+                REQUIRE(a.partition == OffsetAllocator::PartitionAllocation::NO_PARTITION);
+                REQUIRE(a.allocation.offset == OffsetAllocator::Allocation::NO_SPACE);
+            }
+            REQUIRE(partitions.stats(0).failedAllocations == 2);
+            REQUIRE(partitions.storageReport().totalFreeSpace == 1024 + 2048 + 4096);
+#ifdef USE_ALLOCATOR_STATS
+            // Rejected before routing: No partition allocate ran with a wrapped size
+            for (uint32 i = 0; i < 3; i++)
+                REQUIRE(partitions.partition(i).stats().failedAllocations == 0);
+#endif
+        }
+
+        SECTION("steal skips partitions without a large enough node")
+        {
+            OffsetAllocator::PartitionedAllocator partitions(descs);
+            partitions.allocate(0, 1024);
+            partitions.allocate(1, 1024 + 512);
+
+            // 1 has 512 left: Skipped by its top bin mask, 2 serves the request without an allocate on 1
+            OffsetAllocator::PartitionAllocation a = partitions.allocate(0, 1024);
+            REQUIRE(a.partition == 2);
+            REQUIRE(partitions.stats(0).stolenAllocations == 1);
+#ifdef USE_ALLOCATOR_STATS
+            REQUIRE(partitions.partition(1).stats().failedAllocations == 0);
+#endif
+        }
+
+        SECTION("metadata memory")
+        {
+            Memory memory;
+            memory.heapPartition = 1;
+            {
+                OffsetAllocator::PartitionedAllocator partitions(descs, &memory);
+                REQUIRE(memory.blocks.size() == 2);
+                REQUIRE(memory.blocks[0].partition == 0);
+                REQUIRE(memory.blocks[0].size == OffsetAllocator::Allocator::requiredMemorySize(64));
+                REQUIRE(memory.blocks[1].partition == 2);
+                REQUIRE(memory.blocks[1].size == OffsetAllocator::Allocator::requiredMemorySize(128));
+
+                // Provided memory: Node arrays inside it, not owned. Partition 1 falls back to the heap.
+                REQUIRE((void*)partitions.partition(0).m_nodes == memory.blocks[0].memory);
+                REQUIRE(!partitions.partition(0).m_ownsMemory);
+                REQUIRE(partitions.partition(1).m_ownsMemory);
+                REQUIRE((void*)partitions.partition(2).m_nodes == memory.blocks[1].memory);
+
+                OffsetAllocator::PartitionAllocation a = partitions.allocate(2, 100);
+                REQUIRE(a.partition == 2);
+                partitions.free(a);
+                partitions.reset();
+                REQUIRE(partitions.storageReport().totalFreeSpace == 1024 + 2048 + 4096);
+                REQUIRE(memory.freed.empty());
+            }
+            REQUIRE(memory.freed.size() == 2);
+            REQUIRE(memory.freed[0].memory == memory.blocks[0].memory);
+            REQUIRE(memory.freed[1].memory == memory.blocks[1].memory);
+            REQUIRE(memory.freed[1].size == memory.blocks[1].size);
+        }
+    }
+
+    TEST_CASE("timeline", "[offsetAllocator]")
+    {
+        using OffsetAllocator::Allocation;
+        using OffsetAllocator::Allocator;
+        using OffsetAllocator::Timeline;
+        using OffsetAllocator::TraceOp;
+        using OffsetAllocator::TraceRecord;
+
+        static constexpr OffsetAllocator::Offset STORAGE_SIZE = 64 * 1024;
+        static constexpr uint32 MAX_ALLOCS = 256;
+
+        // Deterministic mix of every operation the explorer records. The same seed replays the same steps.
+        struct Script
+        {
+            uint32 seed = 12345;
+            uint64 fence = 0;
+            std::vector<Allocation> live;
+
+            uint32 next()
+            {
+                seed = seed * 1664525 + 1013904223;
+                return seed >> 8;
+            }
+
+            Allocation take()
+            {
+                uint32 index = next() % (uint32)live.size();
+                Allocation allocation = live[index];
+                live[index] = live.back();
+                live.pop_back();
+                return allocation;
+            }
+
+            // Half clustered in one bin: Long bin lists, so bin neighbors of changed nodes aren't just bin heads
+            OffsetAllocator::Offset size()
+            {
+                return next() % 2 ? 60 + next() % 4 : 1 + next() % 600;
+            }
+
+            void allocated(std::vector<TraceRecord>& records, TraceOp op, Allocation allocation)
+            {
+                records.push_back({.op = op, .metadata = allocation.metadata, .offset = allocation.offset});
+                if (allocation.offset != Allocation::NO_SPACE) live.push_back(allocation);
+            }
+
+            void freed(Allocator& allocator, std::vector<TraceRecord>& records)
+            {
+                Allocation allocation = take();
+                allocator.free(allocation);
+                records.push_back({.op = TraceOp::Free, .metadata = allocation.metadata, .offset = allocation.offset});
+            }
+
+            void step(Allocator& allocator, std::vector<TraceRecord>& records)
+            {
+                records.clear();
+                uint32 op = next() % 100;
+                if (live.size() < 4 || op < 25)
+                {
+                    allocated(records, TraceOp::Allocate, allocator.allocate(size()));
+                }
+                else if (op < 31)
+                {
+                    OffsetAllocator::Offset alignedSize = size();
+                    allocated(records, TraceOp::Allocate, allocator.allocate(alignedSize, 1u << (next() % 8)));
+                }
+                else if (op < 37)
+                {
+                    allocated(records, TraceOp::AllocateHigh, allocator.allocateHigh(size()));
+                }
+                else if (op < 57)
+                {
+                    freed(allocator, records);
+                }
+                else if (op < 61)
+                {
+                    OffsetAllocator::Offset sizes[4];
+                    Allocation out[4];
+                    for (OffsetAllocator::Offset& batchSize : sizes)
+                        batchSize = size();
+                    allocator.allocateBatch(sizes, out);
+                    records.push_back({.op = TraceOp::AllocateBatch, .metadata = 4});
+                    for (Allocation allocation : out)
+                        allocated(records, TraceOp::Allocate, allocation);
+                }
+                else if (op < 65)
+                {
+                    Allocation batch[3] = {take(), take(), take()};
+                    allocator.freeBatch(batch);
+                    records.push_back({.op = TraceOp::FreeBatch, .metadata = 3});
+                    for (Allocation allocation : batch)
+                        records.push_back({.op = TraceOp::Free, .metadata = allocation.metadata, .offset = allocation.offset});
+                }
+                else if (op < 71)
+                {
+                    Allocation allocation = take();
+                    allocator.freeDeferred(allocation, ++fence);
+                    records.push_back({.op = TraceOp::FreeDeferred, .metadata = allocation.metadata, .offset = allocation.offset, .size = fence});
+                }
+                else if (op < 75)
+                {
+                    uint64 completed = fence - std::min<uint64>(fence, next() % 3);
+                    allocator.retire(completed);
+                    records.push_back({.op = TraceOp::Retire, .size = completed});
+                }
+                else if (op < 79)
+                {
+                    Allocation allocation = live[next() % live.size()];
+                    OffsetAllocator::Offset newSize = allocator.allocationSize(allocation) + 1 + next() % 128;
+                    bool grown = allocator.tryGrow(allocation, newSize);
+                    records.push_back({.op = TraceOp::Grow, .arg = (OffsetAllocator::uint16)grown, .metadata = allocation.metadata, .offset = allocation.offset, .size = newSize});
+                }
+                else if (op < 83)
+                {
+                    Allocation allocation = live[next() % live.size()];
+                    OffsetAllocator::Offset newSize = 1 + next() % allocator.allocationSize(allocation);
+                    bool shrunk = allocator.shrink(allocation, newSize);
+                    records.push_back({.op = TraceOp::Shrink, .arg = (OffsetAllocator::uint16)shrunk, .metadata = allocation.metadata, .offset = allocation.offset, .size = newSize});
+                }
+                else if (op < 89)
+                {
+                    // Two calls in one step
+                    freed(allocator, records);
+                    allocated(records, TraceOp::Allocate, allocator.allocate(size()));
+                }
+                else if (op < 92)
+                {
+                    OffsetAllocator::Relocation relocations[8];
+                    uint32 count = allocator.defragment(relocations, 1 + next() % 2048);
+                    for (uint32 i = 0; i < count; i++)
+                    {
+                        for (Allocation& allocation : live)
+                        {
+                            if (allocation.metadata == relocations[i].allocation.metadata) allocation = relocations[i].allocation;
+                        }
+                    }
+                    records.push_back({.op = TraceOp::Defragment, .metadata = 8, .offset = count});
+                }
+                else if (op < 94)
+                {
+                    bool grown = allocator.growStorage(1024);
+                    records.push_back({.op = TraceOp::GrowStorage, .arg = (OffsetAllocator::uint16)grown, .size = 1024});
+                }
+                else if (op < 96)
+                {
+                    OffsetAllocator::AllocationPolicy policy = (OffsetAllocator::AllocationPolicy)(next() % 3);
+                    allocator.setAllocationPolicy(policy);
+                    records.push_back({.op = TraceOp::SetPolicy, .arg = (OffsetAllocator::uint16)policy});
+                }
+                else if (op < 97)
+                {
+                    allocator.reset();
+                    live.clear();
+                    records.push_back({.op = TraceOp::Reset});
+                }
+                else
+                {
+                    allocated(records, TraceOp::Allocate, allocator.allocate(1 + next() % 64));
+                }
+            }
+        };
+
+        // Full state: Written nodes, explicit freelist entries, bins, masks, fences and scalars
+        auto sameState = [](const Allocator& left, const Allocator& right) -> const char*
+        {
+            if (left.m_maxAllocs != right.m_maxAllocs) return "max allocations";
+            Timeline::Header header = Timeline::readHeader(left);
+            if (!Timeline::sameHeader(header, Timeline::readHeader(right))) return "header";
+            if (left.m_usedBinsTop != right.m_usedBinsTop) return "top bin mask";
+            for (uint32 i = 0; i < OffsetAllocator::NUM_TOP_BINS; i++)
+            {
+                if (left.m_usedBins[i] != right.m_usedBins[i]) return "bin mask";
+            }
+            for (uint32 i = 0; i < OffsetAllocator::NUM_LEAF_BINS; i++)
+            {
+                if (left.m_binIndices[i] != right.m_binIndices[i] || left.m_binCounts[i] != right.m_binCounts[i]) return "bin";
+            }
+            for (uint32 i = 0; i < header.deferredFenceCount; i++)
+            {
+                // Ring slots outside [start, start + count) are stale
+                uint32 slot = (header.deferredFenceStart + i) % Allocator::MAX_DEFERRED_FENCES;
+                if (!Timeline::sameFence(left.m_deferredFences[slot], right.m_deferredFences[slot])) return "deferred fence";
+            }
+            for (uint32 i = header.lazyFreeNodes; i <= header.freeOffset; i++)
+            {
+                if (left.m_freeNodes[i] != right.m_freeNodes[i]) return "freelist";
+            }
+            for (uint32 i = 0; i < left.m_maxAllocs - header.lazyFreeNodes; i++)
+            {
+                if (!Timeline::sameNode(Timeline::readNode(left, i), Timeline::readNode(right, i))) return "node";
+            }
+            return nullptr;
+        };
+
+        // Fresh allocator replaying steps [0, count) of the script, then branchSteps steps with a reseeded script
+        std::vector<TraceRecord> scratch;
+        auto replay = [&](Allocator& reference, uint32 count, uint32 branchSteps)
+        {
+            Script script;
+            for (uint32 i = 0; i < count; i++)
+                script.step(reference, scratch);
+            script.seed ^= 0x9e3779b9;
+            for (uint32 i = 0; i < branchSteps; i++)
+                script.step(reference, scratch);
+        };
+
+        Allocator allocator(STORAGE_SIZE, MAX_ALLOCS);
+        Timeline timeline;
+        timeline.start(allocator, {.op = TraceOp::Begin, .metadata = MAX_ALLOCS, .size = STORAGE_SIZE}, 0);
+
+        static constexpr uint32 STEPS = 600;
+        Script script;
+        std::vector<TraceRecord> records;
+        for (uint32 i = 0; i < STEPS; i++)
+        {
+            script.step(allocator, records);
+            timeline.recordStep(allocator, records, 0);
+        }
+        REQUIRE(timeline.steps.size() == STEPS + 1);
+        REQUIRE(allocator.validate() == nullptr);
+
+        // Every deferred free, retire, batch and merge path ran
+        uint32 ops[16] = {};
+        for (const Timeline::Step& step : timeline.steps)
+            ops[(uint32)step.record.op]++;
+        for (TraceOp op : {TraceOp::Allocate, TraceOp::AllocateHigh, TraceOp::Free, TraceOp::AllocateBatch, TraceOp::FreeBatch,
+            TraceOp::FreeDeferred, TraceOp::Retire, TraceOp::Grow, TraceOp::Shrink, TraceOp::Defragment, TraceOp::GrowStorage, TraceOp::Reset})
+            REQUIRE(ops[(uint32)op] > 0);
+
+        SECTION("seek")
+        {
+            // Single steps back from the end, then random jumps both ways
+            std::vector<uint32> targets;
+            for (uint32 i = 1; i <= 40; i++)
+                targets.push_back(STEPS - i);
+            uint32 seed = 777;
+            for (uint32 i = 0; i < 40; i++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                targets.push_back((seed >> 8) % (STEPS + 1));
+            }
+            targets.push_back(0);
+            targets.push_back(STEPS);
+
+            std::vector<uint32> touched;
+            for (uint32 target : targets)
+            {
+                timeline.seek(allocator, target, touched);
+                REQUIRE(timeline.position == target);
+                REQUIRE(allocator.validate() == nullptr);
+
+                Allocator reference(STORAGE_SIZE, MAX_ALLOCS);
+                replay(reference, target, 0);
+                INFO("step " << target);
+                REQUIRE(sameState(allocator, reference) == nullptr);
+            }
+        }
+
+        SECTION("branch")
+        {
+            // Seek back, then record different steps: The later history is replaced
+            static constexpr uint32 BRANCH_AT = STEPS / 2;
+            static constexpr uint32 BRANCH_STEPS = 200;
+            std::vector<uint32> touched;
+            timeline.seek(allocator, BRANCH_AT, touched);
+            {
+                Allocator scratchAllocator(STORAGE_SIZE, MAX_ALLOCS);
+                Script branch;
+                for (uint32 i = 0; i < BRANCH_AT; i++)
+                    branch.step(scratchAllocator, scratch);
+                branch.seed ^= 0x9e3779b9;
+                for (uint32 i = 0; i < BRANCH_STEPS; i++)
+                {
+                    branch.step(allocator, records);
+                    timeline.recordStep(allocator, records, 0);
+                }
+            }
+            REQUIRE(timeline.steps.size() == BRANCH_AT + BRANCH_STEPS + 1);
+
+            for (uint32 target : {BRANCH_AT + BRANCH_STEPS, BRANCH_AT + 1, BRANCH_AT - 1, 0u, BRANCH_AT + BRANCH_STEPS / 2})
+            {
+                timeline.seek(allocator, target, touched);
+                Allocator reference(STORAGE_SIZE, MAX_ALLOCS);
+                if (target > BRANCH_AT) replay(reference, BRANCH_AT, target - BRANCH_AT);
+                else replay(reference, target, 0);
+                INFO("step " << target);
+                REQUIRE(sameState(allocator, reference) == nullptr);
+            }
+        }
+
+        SECTION("drop oldest")
+        {
+            // The new step 0 is the state after the dropped steps
+            timeline.dropOldest(100);
+            REQUIRE(timeline.steps.size() == STEPS + 1 - 100);
+            std::vector<uint32> touched;
+            timeline.seek(allocator, 0, touched);
+            Allocator reference(STORAGE_SIZE, MAX_ALLOCS);
+            replay(reference, 100, 0);
+            REQUIRE(sameState(allocator, reference) == nullptr);
+        }
+
+        SECTION("merge deep in a bin list")
+        {
+            // Equal holes 1, 3, ..., 13 share a bin list, head = 13. Freeing 6 unlinks holes 5 and 7 from its middle:
+            // Their bin list neighbors 3 and 9 are neither the record's links nor next to the bin head.
+            Allocator heap(STORAGE_SIZE, MAX_ALLOCS);
+            Timeline history;
+            history.start(heap, {.op = TraceOp::Begin, .metadata = MAX_ALLOCS, .size = STORAGE_SIZE}, 0);
+            Allocation blocks[16];
+            for (Allocation& block : blocks)
+            {
+                block = heap.allocate(64);
+                TraceRecord record = {.op = TraceOp::Allocate, .metadata = block.metadata};
+                history.recordStep(heap, std::span(&record, 1), 0);
+            }
+            for (uint32 i : {1, 3, 5, 7, 9, 11, 13, 6})
+            {
+                heap.free(blocks[i]);
+                TraceRecord record = {.op = TraceOp::Free, .metadata = blocks[i].metadata};
+                history.recordStep(heap, std::span(&record, 1), 0);
+                REQUIRE(history.verify(heap) == nullptr);
+            }
+
+            // Back before the merge and forward again
+            Allocator before(STORAGE_SIZE, MAX_ALLOCS);
+            Allocator afterMerge(STORAGE_SIZE, MAX_ALLOCS);
+            for (uint32 i = 0; i < 16; i++)
+            {
+                blocks[i] = before.allocate(64);
+                afterMerge.allocate(64);
+            }
+            for (uint32 i : {1, 3, 5, 7, 9, 11, 13})
+            {
+                before.free(blocks[i]);
+                afterMerge.free(blocks[i]);
+            }
+            afterMerge.free(blocks[6]);
+
+            std::vector<uint32> touched;
+            uint32 last = (uint32)history.steps.size() - 1;
+            history.seek(heap, last - 1, touched);
+            REQUIRE(sameState(heap, before) == nullptr);
+            history.seek(heap, last, touched);
+            REQUIRE(sameState(heap, afterMerge) == nullptr);
+        }
+    }
 }
@@ -0,0 +1,495 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+#include "offsetAllocatorTrace.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <span>
+#include <vector>
+
+// Allocator state history shared by the explorer timeline and the tests (tools only)
+namespace OffsetAllocator
+{
+    // Allocator state history for the timeline scrubber: One step per operation, stored as a delta (nodes touched, bins
+    // toggled, freelist entries, fences, scalars). seek applies / unapplies the deltas: Any step without a replay from reset.
+    // Deltas diff the allocator against a shadow copy of the current step. Single operations only compare the nodes within
+    // two links of their trace records, the freelist entries near the stack top and the bin heads. Reset, Retire, Defragment,
+    // GrowStorage and multi operation steps compare every written node. Stats and latency histograms are not rewound.
+    struct Timeline
+    {
+        static constexpr uint32 maxSteps = 256 * 1024;    // Full: The oldest half is dropped
+
+        typedef Allocator::Node NodeState;
+
+        // Allocator scalars. Bin masks follow from the bin heads.
+        struct Header
+        {
+            Offset size;
+            Offset freeStorage;
+            uint32 freeOffset;
+            uint32 lazyFreeNodes;
+            AllocationPolicy allocationPolicy;
+            uint32 deferredFenceStart;
+            uint32 deferredFenceCount;
+            uint32 deferredHead;
+            uint32 deferredTail;
+            uint32 lastNode;
+            uint32 defragmentCursor;
+        };
+
+        struct NodeDelta { uint32 index; NodeState before; NodeState after; };
+        struct BinDelta { uint32 binIndex; NodeIndex headBefore; NodeIndex headAfter; uint32 countBefore; uint32 countAfter; };
+        struct FreeListDelta { uint32 position; NodeIndex before; NodeIndex after; };    // Node::unused = above the stack top
+        struct FenceDelta { uint32 index; Allocator::DeferredFence before; Allocator::DeferredFence after; };
+
+        struct Step
+        {
+            TraceRecord record;    // First record of the step
+            uint32 operations;    // Allocator calls (a batch counts as one)
+            Header header;    // State after the step
+            uint32 nodeEnd;    // Deltas of the step: [previous step end, end)
+            uint32 binEnd;
+            uint32 freeListEnd;
+            uint32 fenceEnd;
+            size_t traceEnd;    // Recorded trace size after the step
+        };
+
+        std::vector<Step> steps;    // [0] = start state, no deltas
+        std::vector<NodeDelta> nodeDeltas;
+        std::vector<BinDelta> binDeltas;
+        std::vector<FreeListDelta> freeListDeltas;
+        std::vector<FenceDelta> fenceDeltas;
+        uint32 position = 0;    // Step the allocator is at
+
+        // Allocator state at position. Nodes and freelist entries are valid in the written / explicit ranges only.
+        uint32 maxAllocs = 0;
+        std::vector<NodeState> shadowNodes;
+        std::vector<NodeIndex> shadowFreeNodes;
+        Header shadowHeader = {};
+        NodeIndex shadowBinIndices[NUM_LEAF_BINS] = {};
+        uint32 shadowBinCounts[NUM_LEAF_BINS] = {};
+        Allocator::DeferredFence shadowFences[Allocator::MAX_DEFERRED_FENCES] = {};
+
+        // Nodes to compare in recordStep. Marks deduplicate: Node -> last recordStep call that queued it.
+        std::vector<uint32> candidates;
+        std::vector<uint32> candidateMarks;
+        uint32 recordCount = 0;
+
+        static NodeState readNode(const Allocator& allocator, uint32 index)
+        {
+            return allocator.m_nodes[index];
+        }
+
+        static void writeNode(Allocator& allocator, uint32 index, const NodeState& state)
+        {
+            allocator.m_nodes[index] = state;
+        }
+
+        // Field wise: Padding bytes differ between copies
+        static bool sameNode(const NodeState& l, const NodeState& r)
+        {
+            return l.dataOffset == r.dataOffset && l.dataSize == r.dataSize && l.used == r.used && l.alignmentLog2 == r.alignmentLog2 &&
+                l.binListPrev == r.binListPrev && l.binListNext == r.binListNext && l.neighborPrev == r.neighborPrev && l.neighborNext == r.neighborNext;
+        }
+
+        static bool sameHeader(const Header& left, const Header& right)
+        {
+            return left.size == right.size && left.freeStorage == right.freeStorage && left.freeOffset == right.freeOffset &&
+                left.lazyFreeNodes == right.lazyFreeNodes && left.allocationPolicy == right.allocationPolicy &&
+                left.deferredFenceStart == right.deferredFenceStart && left.deferredFenceCount == right.deferredFenceCount &&
+                left.deferredHead == right.deferredHead && left.deferredTail == right.deferredTail && left.lastNode == right.lastNode &&
+                left.defragmentCursor == right.defragmentCursor;
+        }
+
+        static bool sameFence(const Allocator::DeferredFence& left, const Allocator::DeferredFence& right)
+        {
+            return left.fence == right.fence && left.lastNodeIndex == right.lastNodeIndex;
+        }
+
+        static Header readHeader(const Allocator& allocator)
+        {
+            return {.size = allocator.m_size, .freeStorage = allocator.m_freeStorage, .freeOffset = allocator.m_freeOffset,
+                .lazyFreeNodes = allocator.m_lazyFreeNodes, .allocationPolicy = allocator.m_allocationPolicy,
+                .deferredFenceStart = allocator.m_deferredFenceStart, .deferredFenceCount = allocator.m_deferredFenceCount,
+                .deferredHead = allocator.m_deferredHead, .deferredTail = allocator.m_deferredTail, .lastNode = allocator.m_lastNode,
+                .defragmentCursor = allocator.m_defragmentCursor};
+        }
+
+        static void writeHeader(Allocator& allocator, const Header& header)
+        {
+            allocator.m_size = header.size;
+            allocator.m_freeStorage = header.freeStorage;
+            allocator.m_freeOffset = header.freeOffset;
+            allocator.m_lazyFreeNodes = header.lazyFreeNodes;
+            allocator.m_allocationPolicy = header.allocationPolicy;
+            allocator.m_deferredFenceStart = header.deferredFenceStart;
+            allocator.m_deferredFenceCount = header.deferredFenceCount;
+            allocator.m_deferredHead = header.deferredHead;
+            allocator.m_deferredTail = header.deferredTail;
+            allocator.m_lastNode = header.lastNode;
+            allocator.m_defragmentCursor = header.defragmentCursor;
+        }
+
+        // Freelist stack entry at position: Implicit below lazyFreeNodes, Node::unused above the stack top
+        static NodeIndex freeListEntry(const Header& header, uint32 allocs, const NodeIndex* freeNodes, uint32 position)
+        {
+            if (position > header.freeOffset)
+                return Allocator::Node::unused;
+            if (position < header.lazyFreeNodes)
+                return (NodeIndex)(allocs - position - 1);
+            return freeNodes[position];
+        }
+
+        // Allocator calls in the records: A batch record is followed by its items
+        static uint32 countOperations(std::span<const TraceRecord> records)
+        {
+            uint32 operations = 0;
+            for (size_t i = 0; i < records.size(); operations++)
+            {
+                bool batch = records[i].op == TraceOp::AllocateBatch || records[i].op == TraceOp::FreeBatch;
+                i += batch ? 1 + records[i].metadata : 1;
+            }
+            return operations;
+        }
+
+        // Operations whose node changes aren't near their records
+        static bool comparesAllNodes(TraceOp op)
+        {
+            return op == TraceOp::Begin || op == TraceOp::Reset || op == TraceOp::Retire || op == TraceOp::Defragment ||
+                op == TraceOp::GrowStorage || op == TraceOp::GrowNodes;
+        }
+
+        uint32 writtenNodes(const Header& header) const
+        {
+            return maxAllocs - header.lazyFreeNodes;
+        }
+
+        bool atEnd() const
+        {
+            return position + 1 >= steps.size();
+        }
+
+        void clear()
+        {
+            steps.clear();
+            nodeDeltas.clear();
+            binDeltas.clear();
+            freeListDeltas.clear();
+            fenceDeltas.clear();
+            position = 0;
+            maxAllocs = 0;
+        }
+
+        // New history: The allocator state becomes step 0 (also after growNodes: The node arrays moved)
+        void start(const Allocator& allocator, const TraceRecord& record, size_t traceEnd)
+        {
+            clear();
+            maxAllocs = allocator.m_maxAllocs;
+            shadowHeader = readHeader(allocator);
+            shadowNodes.assign(maxAllocs, NodeState{});
+            for (uint32 i = 0; i < writtenNodes(shadowHeader); i++)
+                shadowNodes[i] = readNode(allocator, i);
+            shadowFreeNodes.assign(maxAllocs, Allocator::Node::unused);
+            for (uint32 i = shadowHeader.lazyFreeNodes; i <= shadowHeader.freeOffset; i++)
+                shadowFreeNodes[i] = allocator.m_freeNodes[i];
+            std::copy(std::begin(allocator.m_binIndices), std::end(allocator.m_binIndices), shadowBinIndices);
+            std::copy(std::begin(allocator.m_binCounts), std::end(allocator.m_binCounts), shadowBinCounts);
+            std::copy(std::begin(allocator.m_deferredFences), std::end(allocator.m_deferredFences), shadowFences);
+            candidateMarks.assign(maxAllocs, 0);
+            recordCount = 0;
+
+            steps.push_back({.record = record, .operations = 0, .header = shadowHeader, .nodeEnd = 0, .binEnd = 0, .freeListEnd = 0, .fenceEnd = 0, .traceEnd = traceEnd});
+        }
+
+        // Discards the steps after position: The next one branches off
+        void truncate()
+        {
+            if (atEnd())
+                return;
+            const Step& step = steps[position];
+            nodeDeltas.resize(step.nodeEnd);
+            binDeltas.resize(step.binEnd);
+            freeListDeltas.resize(step.freeListEnd);
+            fenceDeltas.resize(step.fenceEnd);
+            steps.resize(position + 1);
+        }
+
+        // Step for the allocator calls traced in records, done at position
+        void recordStep(const Allocator& allocator, std::span<const TraceRecord> records, size_t traceEnd)
+        {
+            assert(!steps.empty() && !records.empty());
+            truncate();
+            if (steps.size() > maxSteps)
+                dropOldest(maxSteps / 2);
+
+            Header header = readHeader(allocator);
+            uint32 operations = countOperations(records);
+            bool allNodes = operations != 1 || comparesAllNodes(records[0].op);
+
+            candidates.clear();
+            if (++recordCount == 0)
+            {
+                std::fill(candidateMarks.begin(), candidateMarks.end(), 0);
+                recordCount = 1;
+            }
+            auto queue = [&](uint32 node)
+            {
+                if (node < maxAllocs && candidateMarks[node] != recordCount)
+                {
+                    candidateMarks[node] = recordCount;
+                    candidates.push_back(node);
+                }
+            };
+
+            // Bins: Heads and counts, the heads are candidates
+            for (uint32 i = 0; i < NUM_LEAF_BINS; i++)
+            {
+                if (allocator.m_binIndices[i] == shadowBinIndices[i] && allocator.m_binCounts[i] == shadowBinCounts[i])
+                    continue;
+                binDeltas.push_back({.binIndex = i, .headBefore = shadowBinIndices[i], .headAfter = allocator.m_binIndices[i],
+                    .countBefore = shadowBinCounts[i], .countAfter = allocator.m_binCounts[i]});
+                queue(shadowBinIndices[i]);
+                queue(allocator.m_binIndices[i]);
+                shadowBinIndices[i] = allocator.m_binIndices[i];
+                shadowBinCounts[i] = allocator.m_binCounts[i];
+            }
+
+            // Deferred frees: Fence segment ends and the list ends are candidates
+            for (uint32 i = 0; i < Allocator::MAX_DEFERRED_FENCES; i++)
+            {
+                if (sameFence(allocator.m_deferredFences[i], shadowFences[i]))
+                    continue;
+                fenceDeltas.push_back({.index = i, .before = shadowFences[i], .after = allocator.m_deferredFences[i]});
+                queue(shadowFences[i].lastNodeIndex);
+                queue(allocator.m_deferredFences[i].lastNodeIndex);
+                shadowFences[i] = allocator.m_deferredFences[i];
+            }
+            queue(shadowHeader.deferredHead);
+            queue(shadowHeader.deferredTail);
+            queue(header.deferredHead);
+            queue(header.deferredTail);
+            queue(shadowHeader.lastNode);
+            queue(header.lastNode);
+
+            // Freelist: A single operation pops / pushes a few entries around the stack top.
+            // Entries become explicit only by pops of the stack top: [min lazyFreeNodes, max freeOffset] covers any change.
+            uint32 low = std::min(shadowHeader.lazyFreeNodes, header.lazyFreeNodes);
+            uint32 high = std::max(shadowHeader.freeOffset, header.freeOffset);
+            if (!allNodes)
+            {
+                uint32 top = std::min(shadowHeader.freeOffset, header.freeOffset);
+                uint32 dip = std::min(top, 2 + 2 * (uint32)records.size());
+                low = std::max(low, top - dip);
+            }
+            for (uint32 i = low; i <= high; i++)
+            {
+                // Implicit -> explicit with the same node is a change too: seek writes it back into the array
+                NodeIndex before = freeListEntry(shadowHeader, maxAllocs, shadowFreeNodes.data(), i);
+                NodeIndex after = freeListEntry(header, maxAllocs, allocator.m_freeNodes, i);
+                bool explicitBefore = i >= shadowHeader.lazyFreeNodes && i <= shadowHeader.freeOffset;
+                bool explicitAfter = i >= header.lazyFreeNodes && i <= header.freeOffset;
+                if (explicitAfter)
+                    shadowFreeNodes[i] = after;
+                if (before == after && explicitBefore == explicitAfter)
+                    continue;
+                freeListDeltas.push_back({.position = i, .before = before, .after = after});
+                queue(before);
+                queue(after);
+            }
+
+            // Nodes: Every written one, or the records' nodes and two link hops around them (old and new links)
+            if (allNodes)
+            {
+                uint32 written = std::max(writtenNodes(shadowHeader), writtenNodes(header));
+                for (uint32 i = 0; i < written; i++)
+                    queue(i);
+            }
+            else
+            {
+                for (const TraceRecord& record : records)
+                    queue((uint32)record.metadata);
+
+                size_t begin = 0;
+                for (int hop = 0; hop < 2; hop++)
+                {
+                    size_t end = candidates.size();
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        uint32 node = candidates[i];
+                        const NodeState& before = shadowNodes[node];
+                        const NodeState& after = allocator.m_nodes[node];
+                        queue(before.binListPrev);
+                        queue(before.binListNext);
+                        queue(before.neighborPrev);
+                        queue(before.neighborNext);
+                        queue(after.binListPrev);
+                        queue(after.binListNext);
+                        queue(after.neighborPrev);
+                        queue(after.neighborNext);
+                    }
+                    begin = end;
+                }
+            }
+
+            for (uint32 node : candidates)
+            {
+                NodeState after = readNode(allocator, node);
+                if (sameNode(shadowNodes[node], after))
+                    continue;
+                nodeDeltas.push_back({.index = node, .before = shadowNodes[node], .after = after});
+                shadowNodes[node] = after;
+            }
+
+            shadowHeader = header;
+            steps.push_back({.record = records[0], .operations = operations, .header = header, .nodeEnd = (uint32)nodeDeltas.size(),
+                .binEnd = (uint32)binDeltas.size(), .freeListEnd = (uint32)freeListDeltas.size(), .fenceEnd = (uint32)fenceDeltas.size(), .traceEnd = traceEnd});
+            position = (uint32)steps.size() - 1;
+        }
+
+        // Step count becomes the new step 0
+        void dropOldest(uint32 count)
+        {
+            count = std::min(count, position);
+            if (count == 0)
+                return;
+            const Step base = steps[count];
+            nodeDeltas.erase(nodeDeltas.begin(), nodeDeltas.begin() + base.nodeEnd);
+            binDeltas.erase(binDeltas.begin(), binDeltas.begin() + base.binEnd);
+            freeListDeltas.erase(freeListDeltas.begin(), freeListDeltas.begin() + base.freeListEnd);
+            fenceDeltas.erase(fenceDeltas.begin(), fenceDeltas.begin() + base.fenceEnd);
+            steps.erase(steps.begin(), steps.begin() + count);
+            for (Step& step : steps)
+            {
+                step.nodeEnd -= base.nodeEnd;
+                step.binEnd -= base.binEnd;
+                step.freeListEnd -= base.freeListEnd;
+                step.fenceEnd -= base.fenceEnd;
+            }
+            position -= count;
+        }
+
+        // Moves the allocator to step target. touched gets the nodes whose state may have changed (handles to update).
+        void seek(Allocator& allocator, uint32 target, std::vector<uint32>& touched)
+        {
+            target = std::min(target, (uint32)steps.size() - 1);
+            while (position < target)
+                apply(allocator, ++position, true, touched);
+            while (position > target)
+                apply(allocator, position--, false, touched);
+        }
+
+        // Step stepIndex forward (previous step -> step state) or backward
+        void apply(Allocator& allocator, uint32 stepIndex, bool forward, std::vector<uint32>& touched)
+        {
+            const Step& step = steps[stepIndex];
+            const Step& previous = steps[stepIndex - 1];
+            const Header& header = forward ? step.header : previous.header;
+
+            for (uint32 i = previous.nodeEnd; i < step.nodeEnd; i++)
+            {
+                const NodeDelta& delta = nodeDeltas[i];
+                const NodeState& state = forward ? delta.after : delta.before;
+                writeNode(allocator, delta.index, state);
+                shadowNodes[delta.index] = state;
+                touched.push_back(delta.index);
+            }
+
+            // Nodes entering or leaving the lazy (never written) range change liveness without a node delta
+            uint32 writtenBefore = writtenNodes(shadowHeader);
+            uint32 writtenAfter = writtenNodes(header);
+            for (uint32 i = std::min(writtenBefore, writtenAfter); i < std::max(writtenBefore, writtenAfter); i++)
+                touched.push_back(i);
+
+            for (uint32 i = previous.binEnd; i < step.binEnd; i++)
+            {
+                const BinDelta& delta = binDeltas[i];
+                NodeIndex head = forward ? delta.headAfter : delta.headBefore;
+                uint32 count = forward ? delta.countAfter : delta.countBefore;
+                allocator.m_binIndices[delta.binIndex] = head;
+                allocator.m_binCounts[delta.binIndex] = count;
+                shadowBinIndices[delta.binIndex] = head;
+                shadowBinCounts[delta.binIndex] = count;
+
+                uint32 topBinIndex = delta.binIndex >> TOP_BINS_INDEX_SHIFT;
+                uint32 leafBinIndex = delta.binIndex & LEAF_BINS_INDEX_MASK;
+                if (head != Allocator::Node::unused)
+                    allocator.m_usedBins[topBinIndex] |= (LeafBinMask)1 << leafBinIndex;
+                else
+                    allocator.m_usedBins[topBinIndex] &= ~((LeafBinMask)1 << leafBinIndex);
+                if (allocator.m_usedBins[topBinIndex] != 0)
+                    allocator.m_usedBinsTop |= (TopBinMask)1 << topBinIndex;
+                else
+                    allocator.m_usedBinsTop &= ~((TopBinMask)1 << topBinIndex);
+            }
+
+            // Implicit and above the stack top entries aren't stored
+            for (uint32 i = previous.freeListEnd; i < step.freeListEnd; i++)
+            {
+                const FreeListDelta& delta = freeListDeltas[i];
+                NodeIndex value = forward ? delta.after : delta.before;
+                if (delta.position >= header.lazyFreeNodes && delta.position <= header.freeOffset)
+                {
+                    allocator.m_freeNodes[delta.position] = value;
+                    shadowFreeNodes[delta.position] = value;
+                }
+            }
+
+            for (uint32 i = previous.fenceEnd; i < step.fenceEnd; i++)
+            {
+                const FenceDelta& delta = fenceDeltas[i];
+                allocator.m_deferredFences[delta.index] = forward ? delta.after : delta.before;
+                shadowFences[delta.index] = allocator.m_deferredFences[delta.index];
+            }
+
+            writeHeader(allocator, header);
+            shadowHeader = header;
+        }
+
+        // Shadow vs the allocator: nullptr if the deltas reproduced the full state
+        const char* verify(const Allocator& allocator) const
+        {
+            if (allocator.m_maxAllocs != maxAllocs)
+                return "max allocations changed";
+            if (!sameHeader(readHeader(allocator), shadowHeader))
+                return "header";
+            for (uint32 i = 0; i < NUM_LEAF_BINS; i++)
+            {
+                if (allocator.m_binIndices[i] != shadowBinIndices[i] || allocator.m_binCounts[i] != shadowBinCounts[i])
+                    return "bin head / count";
+                bool used = (allocator.m_usedBins[i >> TOP_BINS_INDEX_SHIFT] >> (i & LEAF_BINS_INDEX_MASK)) & 1;
+                if (used != (shadowBinIndices[i] != Allocator::Node::unused))
+                    return "bin mask";
+            }
+            for (uint32 i = 0; i < NUM_TOP_BINS; i++)
+            {
+                if (((allocator.m_usedBinsTop >> i) & 1) != (allocator.m_usedBins[i] != 0 ? 1u : 0u))
+                    return "top bin mask";
+            }
+            for (uint32 i = 0; i < Allocator::MAX_DEFERRED_FENCES; i++)
+            {
+                if (!sameFence(allocator.m_deferredFences[i], shadowFences[i]))
+                    return "deferred fence";
+            }
+            for (uint32 i = shadowHeader.lazyFreeNodes; i <= shadowHeader.freeOffset; i++)
+            {
+                if (allocator.m_freeNodes[i] != shadowFreeNodes[i])
+                    return "freelist";
+            }
+            for (uint32 i = 0; i < writtenNodes(shadowHeader); i++)
+            {
+                if (!sameNode(readNode(allocator, i), shadowNodes[i]))
+                    return "node";
+            }
+            return nullptr;
+        }
+
+        size_t memoryUsed() const
+        {
+            return steps.capacity() * sizeof(Step) + nodeDeltas.capacity() * sizeof(NodeDelta) + binDeltas.capacity() * sizeof(BinDelta) +
+                freeListDeltas.capacity() * sizeof(FreeListDelta) + fenceDeltas.capacity() * sizeof(FenceDelta);
+        }
+    };
+}
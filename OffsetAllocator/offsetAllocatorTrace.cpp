@@ -0,0 +1,222 @@
+// MIT License (see file: LICENSE)
+
+#include "offsetAllocatorTrace.hpp"
+
+#ifdef DEBUG
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace OffsetAllocator
+{
+    // TraceRing...
+    TraceRing::TraceRing(uint32 capacity) :
+        m_records(new TraceRecord[capacity]),
+        m_mask(capacity - 1)
+    {
+        ASSERT(capacity != 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    TraceRing::~TraceRing()
+    {
+        delete[] m_records;
+    }
+
+    uint32 TraceRing::drain(std::vector<TraceRecord>& out)
+    {
+        uint64 tail = m_tail.load(std::memory_order_relaxed);
+        uint64 head = m_head.load(std::memory_order_acquire);
+        for (uint64 i = tail; i < head; i++)
+            out.push_back(m_records[i & m_mask]);
+        m_tail.store(head, std::memory_order_release);
+        return (uint32)(head - tail);
+    }
+
+    // Trace file...
+    static constexpr uint32 TRACE_MAGIC = 0x5254414f; // "OATR"
+    static constexpr uint32 TRACE_VERSION = 1;
+
+    struct TraceFileHeader
+    {
+        uint32 magic;
+        uint32 version;
+        uint32 recordSize;
+        uint32 padding;
+        uint64 recordCount;
+    };
+
+    bool saveTrace(const char* path, const std::vector<TraceRecord>& records)
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+
+        TraceFileHeader header = {.magic = TRACE_MAGIC, .version = TRACE_VERSION, .recordSize = sizeof(TraceRecord), .padding = 0, .recordCount = records.size()};
+        bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+        if (success && !records.empty())
+            success = fwrite(records.data(), sizeof(TraceRecord), records.size(), file) == records.size();
+        return fclose(file) == 0 && success;
+    }
+
+    bool loadTrace(const char* path, std::vector<TraceRecord>& records)
+    {
+        FILE* file = fopen(path, "rb");
+        if (!file) return false;
+
+        TraceFileHeader header;
+        bool success = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == TRACE_MAGIC && header.version == TRACE_VERSION && header.recordSize == sizeof(TraceRecord);
+        if (success)
+        {
+            records.resize(header.recordCount);
+            success = fread(records.data(), sizeof(TraceRecord), records.size(), file) == records.size();
+        }
+        if (!success) records.clear();
+        fclose(file);
+        return success;
+    }
+
+    // TraceReplayer...
+    TraceReplayer::TraceReplayer(const std::vector<TraceRecord>& records) :
+        m_records(records)
+    {
+    }
+
+    Offset TraceReplayer::storageSize() const
+    {
+        if (m_records.empty() || m_records[0].op != TraceOp::Begin) return 0;
+        return (Offset)m_records[0].size;
+    }
+
+    uint32 TraceReplayer::maxAllocs() const
+    {
+        if (m_records.empty() || m_records[0].op != TraceOp::Begin) return 0;
+        return m_records[0].metadata;
+    }
+
+    static Allocation traceAllocation(const TraceRecord& record)
+    {
+        return {.offset = (Offset)record.offset, .metadata = (NodeIndex)record.metadata};
+    }
+
+    bool TraceReplayer::step(Allocator& allocator)
+    {
+        m_lastPosition = m_position;
+        if (m_diverged || m_position >= m_records.size()) return false;
+
+        const TraceRecord& record = m_records[m_position++];
+        switch (record.op)
+        {
+            case TraceOp::Begin:
+            {
+                if ((Offset)record.size != allocator.m_size || record.metadata != allocator.m_maxAllocs)
+                {
+                    m_diverged = true;
+                    break;
+                }
+                allocator.reset();
+                allocator.setAllocationPolicy((AllocationPolicy)record.arg);
+                break;
+            }
+            case TraceOp::Allocate:
+            {
+                Allocation allocation = record.arg == 0 ?
+                    allocator.allocate((Offset)record.size) :
+                    allocator.allocate((Offset)record.size, (Offset)1 << (record.arg - 1));
+                if (allocation.offset != (Offset)record.offset || allocation.metadata != (NodeIndex)record.metadata) m_diverged = true;
+                break;
+            }
+            case TraceOp::AllocateHigh:
+            {
+                Allocation allocation = allocator.allocateHigh((Offset)record.size);
+                if (allocation.offset != (Offset)record.offset || allocation.metadata != (NodeIndex)record.metadata) m_diverged = true;
+                break;
+            }
+            case TraceOp::Grow:
+            case TraceOp::Shrink:
+            {
+                bool result = record.op == TraceOp::Grow ?
+                    allocator.tryGrow(traceAllocation(record), (Offset)record.size) :
+                    allocator.shrink(traceAllocation(record), (Offset)record.size);
+                if (result != (record.arg != 0)) m_diverged = true;
+                break;
+            }
+            case TraceOp::GrowStorage:
+            case TraceOp::GrowNodes:
+            {
+                bool result = record.op == TraceOp::GrowStorage ?
+                    allocator.growStorage((Offset)record.size) :
+                    allocator.growNodes((uint32)record.size);
+                if (result != (record.arg != 0)) m_diverged = true;
+                break;
+            }
+            case TraceOp::Free:
+            {
+                allocator.free(traceAllocation(record));
+                break;
+            }
+            case TraceOp::AllocateBatch:
+            {
+                // Truncated trace: Replay what is there
+                size_t count = std::min((size_t)record.metadata, m_records.size() - m_position);
+                m_batchSizes.resize(count);
+                m_batchAllocations.resize(count);
+                for (size_t i = 0; i < count; i++)
+                    m_batchSizes[i] = (Offset)m_records[m_position + i].size;
+
+                allocator.allocateBatch(m_batchSizes, m_batchAllocations.data());
+                for (size_t i = 0; i < count; i++)
+                {
+                    const TraceRecord& item = m_records[m_position + i];
+                    if (m_batchAllocations[i].offset != (Offset)item.offset || m_batchAllocations[i].metadata != (NodeIndex)item.metadata) m_diverged = true;
+                }
+                m_position += count;
+                break;
+            }
+            case TraceOp::FreeBatch:
+            {
+                size_t count = std::min((size_t)record.metadata, m_records.size() - m_position);
+                m_batchAllocations.resize(count);
+                for (size_t i = 0; i < count; i++)
+                    m_batchAllocations[i] = traceAllocation(m_records[m_position + i]);
+
+                allocator.freeBatch(m_batchAllocations);
+                m_position += count;
+                break;
+            }
+            case TraceOp::FreeDeferred:
+            {
+                allocator.freeDeferred(traceAllocation(record), record.size);
+                break;
+            }
+            case TraceOp::Retire:
+            {
+                allocator.retire(record.size);
+                break;
+            }
+            case TraceOp::Reset:
+            {
+                allocator.reset();
+                break;
+            }
+            case TraceOp::Defragment:
+            {
+                m_relocations.resize(record.metadata);
+                uint32 count = allocator.defragment(m_relocations, (Offset)record.size);
+                m_relocations.resize(count);
+                if (count != record.offset) m_diverged = true;
+                break;
+            }
+            case TraceOp::SetPolicy:
+            {
+                allocator.setAllocationPolicy((AllocationPolicy)record.arg);
+                break;
+            }
+        }
+        return true;
+    }
+}
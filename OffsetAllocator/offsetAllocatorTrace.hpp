@@ -0,0 +1,132 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+
+#include <atomic>
+#include <vector>
+
+namespace OffsetAllocator
+{
+    // Allocation tracing (compile with USE_ALLOCATION_TRACE)
+    //
+    // Allocator::setTrace(ring) records every public operation as a fixed size TraceRecord into a lock-free
+    // single producer / single consumer ring. The allocator thread is the producer and never blocks:
+    // Records are dropped (and counted) when the ring is full. A consumer thread drains the ring into a trace.
+    //
+    // Replay is deterministic: A fresh allocator with the same size and maxAllocs hands out the same offsets and
+    // node indices, so recorded handles are passed back as is and every allocate result is verified.
+    enum class TraceOp : uint16
+    {
+        Begin,          // size = storage size, metadata = maxAllocs, arg = allocation policy. First record of a trace.
+        Allocate,       // size, arg = log2(alignment) + 1 (0 = unaligned), offset/metadata = result
+        Free,           // offset/metadata = handle
+        AllocateBatch,  // metadata = count, followed by count Allocate records
+        FreeBatch,      // metadata = count, followed by count Free records
+        FreeDeferred,   // offset/metadata = handle, size = fence
+        Retire,         // size = completed fence
+        Reset,
+        Defragment,     // size = byte budget, metadata = relocation span size, offset = relocation count
+        SetPolicy,      // arg = allocation policy
+        AllocateHigh,   // size, offset/metadata = result
+        Grow,           // offset/metadata = handle, size = new size, arg = result (1 = grown)
+        Shrink,         // offset/metadata = handle, size = new size, arg = result (1 = shrunk)
+        GrowStorage,    // size = additional size, arg = result (1 = grown)
+        GrowNodes,      // size = new maxAllocs, arg = result (1 = grown)
+    };
+
+    // 24 bytes. Offsets and sizes are always 64 bit: Traces don't depend on USE_64_BIT_OFFSETS.
+    struct TraceRecord
+    {
+        TraceOp op = TraceOp::Begin;
+        uint16 arg = 0;
+        uint32 metadata = 0;
+        uint64 offset = 0;
+        uint64 size = 0;
+    };
+
+    class TraceRing
+    {
+    public:
+        // capacity = power of two record count
+        explicit TraceRing(uint32 capacity);
+        ~TraceRing();
+
+        // Producer (allocator thread). False = ring full, record dropped.
+        bool push(const TraceRecord& record)
+        {
+            uint64 head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tailCache > m_mask)
+            {
+                m_tailCache = m_tail.load(std::memory_order_acquire);
+                if (head - m_tailCache > m_mask)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            m_records[head & m_mask] = record;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer. Appends every available record to out, returns the appended count.
+        uint32 drain(std::vector<TraceRecord>& out);
+
+        // Records lost to a full ring. A trace with drops can't be replayed.
+        uint64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+//    private:
+        TraceRecord* m_records;
+        uint32 m_mask;
+        alignas(64) std::atomic<uint64> m_head = 0;
+        uint64 m_tailCache = 0;         // Producer's copy of m_tail
+        alignas(64) std::atomic<uint64> m_tail = 0;
+        std::atomic<uint64> m_dropped = 0;
+    };
+
+    // Trace file: Header (magic, version, record size, record count) + the records as is
+    bool saveTrace(const char* path, const std::vector<TraceRecord>& records);
+    bool loadTrace(const char* path, std::vector<TraceRecord>& records);
+
+    // Steps through a trace against an allocator of the traced size and maxAllocs.
+    // The Begin record resets the allocator. Traces must be recorded from an empty allocator (setTrace right
+    // after construction or reset), otherwise the replayed offsets and node indices diverge.
+    // Records must outlive the replayer.
+    class TraceReplayer
+    {
+    public:
+        explicit TraceReplayer(const std::vector<TraceRecord>& records);
+
+        // From the Begin record. 0 if the trace doesn't start with one.
+        Offset storageSize() const;
+        uint32 maxAllocs() const;
+
+        // Replays one operation (a batch counts as one). Returns false at the end of the trace or once diverged.
+        bool step(Allocator& allocator);
+
+        // Record index of the next operation, [0, records.size()]
+        size_t position() const { return m_position; }
+
+        // Records of the last step (operation + batch items)
+        const TraceRecord* lastRecords() const { return m_records.data() + m_lastPosition; }
+        size_t lastRecordCount() const { return m_position - m_lastPosition; }
+
+        // Relocations done by the last Defragment step
+        const std::vector<Relocation>& lastRelocations() const { return m_relocations; }
+
+        // An allocate result differed from the trace (or Begin from the allocator geometry): The allocator didn't
+        // start from the traced state. Replay stops there, later frees would hit the wrong nodes.
+        bool diverged() const { return m_diverged; }
+
+//    private:
+        const std::vector<TraceRecord>& m_records;
+        size_t m_position = 0;
+        size_t m_lastPosition = 0;
+        bool m_diverged = false;
+        std::vector<Offset> m_batchSizes;
+        std::vector<Allocation> m_batchAllocations;
+        std::vector<Relocation> m_relocations;
+    };
+}
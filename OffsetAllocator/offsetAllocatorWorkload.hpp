@@ -0,0 +1,48 @@
+// MIT License (see file: LICENSE)
+
+#pragma once
+
+#include "offsetAllocator.hpp"
+
+// Synthetic workload helpers shared by the benchmark suite, the stress runner and the explorer (tools only)
+namespace OffsetAllocator::Workload
+{
+    struct Random
+    {
+        uint32 state = 0x12345678;
+
+        uint32 next()
+        {
+            // xorshift32
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+    };
+
+    enum class SizeDistribution
+    {
+        Random,     // [1, 256]
+        Pow2,       // 1, 2, 4 ... 256
+        Odd,        // 1, 3, 5 ... 255
+        Clustered,  // [1000, 1063]: tight size cluster
+    };
+
+    inline uint32 nextSize(Random& random, SizeDistribution distribution)
+    {
+        switch (distribution)
+        {
+        case SizeDistribution::Pow2: return 1u << (random.next() % 9);
+        case SizeDistribution::Odd: return (random.next() % 128) * 2 + 1;
+        case SizeDistribution::Clustered: return 1000 + random.next() % 64;
+        default: return random.next() % 256 + 1;
+        }
+    }
+
+    // Storage size for maxAllocs / 2 live allocations of up to 256 elements + slack for fragmentation
+    inline Offset heapSize(uint32 maxAllocs, SizeDistribution distribution = SizeDistribution::Random)
+    {
+        return (Offset)maxAllocs * (distribution == SizeDistribution::Clustered ? 2048 : 256);
+    }
+}
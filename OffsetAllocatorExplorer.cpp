@@ -1,28 +1,47 @@
+// Platform backend: Win32 + WGL (default, .vcxproj), OFFSET_ALLOCATOR_EXPLORER_GLFW or OFFSET_ALLOCATOR_EXPLORER_SDL2 (CMake)
 #include "imgui.h"
 #include "imgui_impl_opengl3.h"
-#include "imgui_impl_win32.h"
 #include "OffsetAllocator/offsetAllocator.hpp"
-
+#include "OffsetAllocator/offsetAllocatorTimeline.hpp"
+#include "OffsetAllocator/offsetAllocatorTrace.hpp"
+#include "OffsetAllocator/offsetAllocatorWorkload.hpp"
+
+#if defined(OFFSET_ALLOCATOR_EXPLORER_GLFW)
+#include "imgui_impl_glfw.h"
+#include <GLFW/glfw3.h>
+#elif defined(OFFSET_ALLOCATOR_EXPLORER_SDL2)
+#include "imgui_impl_sdl2.h"
+#include <SDL.h>
+#include <SDL_opengl.h>
+#else
+#include "imgui_impl_win32.h"
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <GL/GL.h>
 #include <tchar.h>
+#endif
 
 #include <algorithm>
-#include <functional>
-#include <unordered_set>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
 #include <vector>
 #include <memory>
-#include <format>
+#include <queue>
 #include <span>
-#include <set>
+#include <string>
 
 namespace OffsetAllocator 
 {
 namespace SmallFloat
 {
-uint32 floatToUint(uint32);
+Offset floatToUint(uint32);
+uint32 uintToFloatRoundDown(Offset);
 }
 }
 
@@ -54,74 +73,1427 @@ ImVec2 operator*(float left, const ImVec2& right)
 
 using namespace OffsetAllocator;
 
-struct WGL_WindowData { HDC hDC; };
+// Live allocations keyed by node index (Allocation::metadata, stable for the lifetime of the allocation).
+// Dense list + node index -> list position: Add, Find and Remove are O(1), Remove swaps in the last item.
+struct AllocationList
+{
+	static constexpr uint32 none = ~0u;
+
+	std::vector<Allocation> items;
+	std::vector<uint64> serials;	// Per item, unique per Add: Tells a reused node index from its previous allocation
+	std::vector<uint32> positions;
+	uint64 nextSerial = 0;
+
+	void Reset(uint32 maxAllocs)
+	{
+		items.clear();
+		serials.clear();
+		positions.assign(maxAllocs, none);
+	}
+
+	// Allocator::growNodes: Node indices stay valid
+	void Grow(uint32 maxAllocs)
+	{
+		positions.resize(maxAllocs, none);
+	}
+
+	void Clear()
+	{
+		for (const Allocation& allocation : items)
+			positions[allocation.metadata] = none;
+		items.clear();
+		serials.clear();
+	}
+
+	uint64 Add(const Allocation& allocation)
+	{
+		positions[allocation.metadata] = (uint32)items.size();
+		items.push_back(allocation);
+		serials.push_back(nextSerial);
+		return nextSerial++;
+	}
+
+	const Allocation* Find(NodeIndex node) const
+	{
+		return node < positions.size() && positions[node] != none ? &items[positions[node]] : nullptr;
+	}
+
+	uint64 Serial(NodeIndex node) const
+	{
+		return serials[positions[node]];
+	}
+
+	void Remove(NodeIndex node)
+	{
+		if (!Find(node))
+			return;
+		uint32 position = positions[node];
+		items[position] = items.back();
+		serials[position] = serials.back();
+		positions[items[position].metadata] = position;
+		items.pop_back();
+		serials.pop_back();
+		positions[node] = none;
+	}
+
+	// Relocated by defragment: Same node, new offset
+	void Update(const Allocation& allocation)
+	{
+		assert(Find(allocation.metadata));
+		items[positions[allocation.metadata]] = allocation;
+	}
+};
+
+// Latency of the explorer's single allocate / free calls. Bucket i = [2^(i-1), 2^i) nanoseconds.
+struct LatencyHistogram
+{
+	static constexpr int bucketCount = 24;
+
+	float buckets[bucketCount] = {};
+	uint64 samples = 0;
+
+	void Add(std::chrono::steady_clock::duration duration)
+	{
+		uint64 ns = (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		buckets[std::min((int)std::bit_width(ns), bucketCount - 1)]++;
+		samples++;
+	}
+};
 
-static HGLRC g_hRC;
-static WGL_WindowData g_MainWindow;
-static int g_Width;
-static int g_Height;
 static std::unique_ptr<Allocator> allocator;
-static std::vector<OffsetAllocator::Allocation> allocations;
-static std::unordered_set<uint32_t> keyDownLastFrame;
+static AllocationList allocations;
+static LatencyHistogram allocateLatency;
+static LatencyHistogram freeLatency;
 static int allocatorSize = 1024;
 static int maxAllocs = 128 * 1024;
+static uint64 allocatorVersion = 0;		// Bumped by every operation on allocator
+
+// Every allocator operation is traced (Save Trace). A loaded trace replays step by step.
+static std::unique_ptr<TraceRing> traceRing;
+static std::vector<TraceRecord> recordedTrace;
+static std::vector<TraceRecord> loadedTrace;
+static std::unique_ptr<TraceReplayer> traceReplayer;
+static char tracePath[256] = "allocations.trace";
+
+// Every recorded operation is a timeline step. Verify compares the shadow with the whole allocator after each step.
+static Timeline timeline;
+static bool timelineVerify = false;
+static const char* timelineError = nullptr;
+
+bool IsPressed(ImGuiKey key)
+{
+	return !ImGui::GetIO().WantCaptureKeyboard && ImGui::IsKeyPressed(key, false);
+}
+
+std::string Format(const char* format, ...)
+{
+	char buffer[128];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	return buffer;
+}
+
+// After every allocator operation: Model rebuild, trace records drained, timeline step recorded
+void AllocatorChanged()
+{
+	allocatorVersion++;
+	if (!traceRing)
+		return;
+
+	static std::vector<TraceRecord> records;
+	records.clear();
+	traceRing->drain(records);
+	if (records.empty())
+		return;
+
+	// Scrubbed back: The later steps and their records are discarded, a replay can't follow the new branch
+	if (!timeline.atEnd())
+	{
+		recordedTrace.resize(timeline.steps[timeline.position].traceEnd);
+		traceReplayer.reset();
+	}
+	recordedTrace.insert(recordedTrace.end(), records.begin(), records.end());
+
+	bool restart = std::any_of(records.begin(), records.end(), [](const TraceRecord& record) {
+		return record.op == TraceOp::Begin || record.op == TraceOp::GrowNodes;
+	});
+	if (restart || timeline.steps.empty())
+		timeline.start(*allocator, records.front(), recordedTrace.size());
+	else
+		timeline.recordStep(*allocator, records, recordedTrace.size());
+	if (timelineVerify && !timelineError)
+		timelineError = timeline.verify(*allocator);
+}
+
+// Scrubs the allocator to a timeline step. Handles follow the touched nodes: Live = used, not deferred and not in the
+// freelist (freed nodes keep their used flag there).
+void SeekTimeline(uint32 step)
+{
+	static std::vector<uint32> touched;
+	static std::vector<uint8> freeListed;
+	touched.clear();
+	timeline.seek(*allocator, step, touched);
+
+	freeListed.assign(allocator->m_maxAllocs, 0);
+	for (uint32 i = allocator->m_lazyFreeNodes; i <= allocator->m_freeOffset; i++)
+		freeListed[allocator->m_freeNodes[i]] = 1;
+	uint32 written = allocator->m_maxAllocs - allocator->m_lazyFreeNodes;
+	for (uint32 node : touched)
+	{
+		bool live = node < written && allocator->m_nodes[node].used && allocator->m_nodes[node].binListPrev != node && !freeListed[node];
+		Allocation allocation = {.offset = allocator->m_nodes[node].dataOffset, .metadata = (NodeIndex)node};
+		if (!live)
+			allocations.Remove((NodeIndex)node);
+		else if (allocations.Find((NodeIndex)node))
+			allocations.Update(allocation);
+		else
+			allocations.Add(allocation);
+	}
+
+	allocatorSize = (int)allocator->m_size;
+	allocatorVersion++;
+}
+
+void Allocate(uint32_t bytes, bool high = false)
+{
+	auto start = std::chrono::steady_clock::now();
+	auto allocation = high ? allocator->allocateHigh(bytes) : allocator->allocate(bytes);
+	allocateLatency.Add(std::chrono::steady_clock::now() - start);
+	if (allocation.offset != Allocation::NO_SPACE)
+		allocations.Add(allocation);
+	AllocatorChanged();
+}
+
+void CreateAllocator(Offset size, uint32 allocs)
+{
+	allocations.Reset(allocs);
+	allocator = std::make_unique<Allocator>(size, allocs);
+	allocatorSize = (int)size;
+	maxAllocs = (int)allocs;
+
+	recordedTrace.clear();
+	timeline.clear();
+	timelineError = nullptr;
+	traceRing = std::make_unique<TraceRing>(256 * 1024);
+	allocator->setTrace(traceRing.get());
+	AllocatorChanged();
+}
+
+void DestroyAllocator()
+{
+	allocations.Reset(0);
+	allocator.reset();
+	traceRing.reset();
+	traceReplayer.reset();
+	timeline.clear();
+	allocatorVersion++;
+}
+
+void RemapAllocations(std::span<const Relocation> relocations)
+{
+	// Explorer has no backing data: Only the handles need to follow the relocations
+	for (const Relocation& relocation : relocations)
+		allocations.Update(relocation.allocation);
+}
+
+// Mirrors the replayed operations in the explorer handle list. Scrubbed back: Steps through the timeline first.
+void StepTrace(uint32 steps)
+{
+	for (uint32 step = 0; step < steps; step++)
+	{
+		if (!timeline.atEnd())
+		{
+			SeekTimeline(timeline.position + 1);
+			continue;
+		}
+		if (!traceReplayer->step(*allocator))
+			break;
+
+		std::span<const TraceRecord> records(traceReplayer->lastRecords(), traceReplayer->lastRecordCount());
+		auto toAllocation = [](const TraceRecord& record) {
+			return Allocation{.offset = (Offset)record.offset, .metadata = (NodeIndex)record.metadata};
+		};
+
+		switch (records[0].op)
+		{
+			case TraceOp::Begin:
+			case TraceOp::Reset:
+				allocations.Clear();
+				break;
+			case TraceOp::Allocate:
+			case TraceOp::AllocateHigh:
+				if ((Offset)records[0].offset != Allocation::NO_SPACE)
+					allocations.Add(toAllocation(records[0]));
+				break;
+			case TraceOp::AllocateBatch:
+				for (const TraceRecord& item : records.subspan(1))
+					if ((Offset)item.offset != Allocation::NO_SPACE)
+						allocations.Add(toAllocation(item));
+				break;
+			case TraceOp::Free:
+			case TraceOp::FreeDeferred:
+				allocations.Remove((NodeIndex)records[0].metadata);
+				break;
+			case TraceOp::FreeBatch:
+				for (const TraceRecord& item : records.subspan(1))
+					allocations.Remove((NodeIndex)item.metadata);
+				break;
+			case TraceOp::Defragment:
+				RemapAllocations(traceReplayer->lastRelocations());
+				break;
+			case TraceOp::GrowNodes:
+				allocations.Grow(allocator->m_maxAllocs);
+				break;
+			default:
+				break;
+		}
+		AllocatorChanged();
+	}
+}
+
+const char* TraceOpName(TraceOp op)
+{
+	static const char* names[] = {"Begin", "Allocate", "Free", "AllocateBatch", "FreeBatch", "FreeDeferred", "Retire", "Reset", "Defragment", "SetPolicy", "AllocateHigh", "Grow", "Shrink", "GrowStorage", "GrowNodes"};
+	return (uint32)op < IM_ARRAYSIZE(names) ? names[(uint32)op] : "?";
+}
+
+void Free(NodeIndex node)
+{
+	const Allocation* allocation = allocations.Find(node);
+	assert(allocation);
+
+	auto start = std::chrono::steady_clock::now();
+	allocator->free(*allocation);
+	freeLatency.Add(std::chrono::steady_clock::now() - start);
+	allocations.Remove(node);
+	AllocatorChanged();
+}
+
+// In place tryGrow / shrink of a live allocation. False = not live, or no room next to it.
+bool Resize(NodeIndex node, uint32 bytes, bool grow)
+{
+	const Allocation* allocation = allocations.Find(node);
+	if (!allocation)
+		return false;
+
+	bool resized = grow ? allocator->tryGrow(*allocation, bytes) : allocator->shrink(*allocation, bytes);
+	AllocatorChanged();
+	return resized;
+}
+
+// Growable heap: Live allocations are kept. False = out of nodes / size overflow (storage), caller memory (nodes).
+bool GrowStorage(uint32 bytes)
+{
+	bool grown = allocator->growStorage(bytes);
+	allocatorSize = (int)allocator->m_size;
+	AllocatorChanged();
+	return grown;
+}
+
+bool GrowNodes(uint32 allocs)
+{
+	bool grown = allocator->growNodes(allocs);
+	allocations.Grow(allocator->m_maxAllocs);
+	maxAllocs = (int)allocator->m_maxAllocs;
+	AllocatorChanged();
+	return grown;
+}
+
+void DrawAllocatorNode(ImVec2 pos, uint32_t nodeIndex, uint32_t offset, uint32_t size, ImU32 lineColor, ImU32 boxColor, ImU32 textColor, ImVec2 boxSize, float rounding, float lineThickness, float margin)
+{
+	float lineHeight = ImGui::GetTextLineHeight();
+	auto drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(pos, pos + boxSize, boxColor, rounding);
+	drawList->AddRect(pos, pos + boxSize, lineColor, rounding, 0, lineThickness);
+	std::string label = Format("%u", nodeIndex);
+	ImVec2 textSize = ImGui::CalcTextSize(label.c_str());
+	ImVec2 textPos = pos + ImVec2((boxSize.x - textSize.x) / 2.0f, 0);
+	drawList->AddText(textPos, textColor, label.c_str());
+	pos.y += lineHeight + 2;
+	drawList->AddLine(pos, pos + ImVec2(boxSize.x, 0), lineColor, lineThickness);
+	pos.y += lineThickness;
+	drawList->AddText(pos + ImVec2(margin, 0), textColor, Format("O: %u", offset).c_str());
+	pos.y += lineHeight;
+	drawList->AddText(pos + ImVec2(margin, 0), textColor, Format("S: %u", size).c_str());
+}
+
+static const ImU32 allocatedColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.2f, 0.4f, 0.8f, 1.0f));
+static const ImU32 allocatedOutlineColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.4f, 0.6f, 1.0f, 1.0f));
+static const ImU32 deallocatedColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.6f, 0.6f, 0.6f, 1.0f));
+static const ImU32 deallocatedOutlineColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.9f, 0.9f, 0.9f, 1.0f));
+
+// Node graph of the allocator read by every window. Rebuilt only when allocatorVersion changes.
+struct NodeModel
+{
+	NodeIndex index;
+	uint64 offset;
+	uint64 size;
+	bool used;
+	NodeIndex binListPrev;
+	NodeIndex binListNext;
+};
+
+struct BinModel
+{
+	uint32 binIndex;
+	uint64 binSize;
+	std::vector<uint32> nodes;		// Positions in AllocatorModel::nodes, bin list order
+};
+
+struct AllocatorModel
+{
+	uint64 version = ~0ull;
+	std::vector<NodeModel> nodes;	// Neighbor chain = address order
+	std::vector<BinModel> bins;		// Used bins, ascending size
+	std::vector<uint32> positions;	// NodeIndex -> position in nodes
+	TopBinMask usedBinsTop = 0;
+	LeafBinMask usedBins[NUM_TOP_BINS] = {};
+	uint32 binCounts[NUM_LEAF_BINS] = {};	// Free list depth
+	AllocatorStats stats = {};
+	StorageReport report = {};
+};
+
+static AllocatorModel model;
+
+void UpdateModel()
+{
+	if (model.version == allocatorVersion)
+		return;
+	model.version = allocatorVersion;
+	model.nodes.clear();
+	model.bins.clear();
+	if (!allocator)
+		return;
+
+	model.usedBinsTop = allocator->m_usedBinsTop;
+	std::copy(std::begin(allocator->m_usedBins), std::end(allocator->m_usedBins), model.usedBins);
+	std::copy(std::begin(allocator->m_binCounts), std::end(allocator->m_binCounts), model.binCounts);
+	model.stats = allocator->stats();
+	model.report = allocator->storageReport();
+
+	// Any node of the chain: A bin head, or a live allocation when the heap is full
+	uint32 head = Allocator::Node::unused;
+	for (uint32 i = 0; i < NUM_TOP_BINS; ++i)
+	{
+		for (uint32 j = 0; j < BINS_PER_LEAF; ++j)
+		{
+			if (model.usedBins[i] & ((LeafBinMask)1 << j))
+			{
+				uint32 binIndex = (i << TOP_BINS_INDEX_SHIFT) | j;
+				if (head == Allocator::Node::unused)
+					head = allocator->m_binIndices[binIndex];
+				model.bins.push_back({.binIndex = binIndex, .binSize = (uint64)SmallFloat::floatToUint(binIndex), .nodes = {}});
+			}
+		}
+	}
+	if (head == Allocator::Node::unused && !allocations.items.empty())
+		head = allocations.items.front().metadata;
+	if (head == Allocator::Node::unused)
+		return;
+
+	while (allocator->m_nodes[head].neighborPrev != Allocator::Node::unused)
+		head = allocator->m_nodes[head].neighborPrev;
+
+	model.positions.resize(allocator->m_maxAllocs);
+	for (uint32 i = head; i != Allocator::Node::unused; i = allocator->m_nodes[i].neighborNext)
+	{
+		const auto& node = allocator->m_nodes[i];
+		model.positions[i] = (uint32)model.nodes.size();
+		model.nodes.push_back({.index = (NodeIndex)i, .offset = node.dataOffset, .size = node.dataSize, .used = node.used,
+			.binListPrev = node.binListPrev, .binListNext = node.binListNext});
+	}
+
+	for (BinModel& bin : model.bins)
+	{
+		for (uint32 i = allocator->m_binIndices[bin.binIndex]; i != Allocator::Node::unused; i = allocator->m_nodes[i].binListNext)
+			bin.nodes.push_back(model.positions[i]);
+	}
+}
+
+// First node ending after byte
+std::vector<NodeModel>::const_iterator FindNode(uint64 byte)
+{
+	return std::upper_bound(model.nodes.cbegin(), model.nodes.cend(), byte, [](uint64 value, const NodeModel& node) {
+		return value < node.offset + node.size;
+	});
+}
+
+// One freeBatch for the live allocations of nodes
+void FreeNodes(std::span<const NodeIndex> nodes)
+{
+	std::vector<Allocation> batch;
+	batch.reserve(nodes.size());
+	for (NodeIndex node : nodes)
+	{
+		batch.push_back(*allocations.Find(node));
+		allocations.Remove(node);
+	}
+	allocator->freeBatch(batch);
+	AllocatorChanged();
+}
+
+// Every stride-th live allocation in address order, starting with the first
+void FreeEveryNth(uint32 stride)
+{
+	UpdateModel();
+	std::vector<NodeIndex> nodes;
+	uint32 live = 0;
+	for (const NodeModel& node : model.nodes)
+	{
+		if (node.used && allocations.Find(node.index) && (live++ % stride) == 0)
+			nodes.push_back(node.index);
+	}
+	FreeNodes(nodes);
+}
+
+// Live allocations starting in [begin, end)
+void FreeRange(uint64 begin, uint64 end)
+{
+	UpdateModel();
+	std::vector<NodeIndex> nodes;
+	for (auto node = FindNode(begin); node != model.nodes.end() && node->offset < end; ++node)
+	{
+		if (node->used && node->offset >= begin && allocations.Find(node->index))
+			nodes.push_back(node->index);
+	}
+	FreeNodes(nodes);
+}
+
+// Workload panel: Allocations at a fixed rate, sizes and lifetimes from distributions.
+// Lifetimes are counted in workload allocations (ticks): Runs replay the same way at every frame rate.
+enum class WorkloadSizes { Uniform, LogNormal, Pow2, Histogram };
+enum class WorkloadLifetimes { Forever, Fixed, Uniform, Exponential };
+
+struct WorkloadExpiry
+{
+	uint64 tick;
+	NodeIndex node;
+	uint64 serial;
+
+	bool operator>(const WorkloadExpiry& other) const { return tick > other.tick; }
+};
+
+struct WorkloadState
+{
+	static constexpr int historySize = 600;
+
+	bool running = false;
+	int sizes = (int)WorkloadSizes::LogNormal;
+	int uniformRange[2] = {1, 256};
+	float logNormalMedian = 64.0f;
+	float logNormalSigma = 1.0f;
+	int pow2Range[2] = {0, 10};			// Exponents
+	std::vector<uint32> histogram;		// Captured sizes, sampled uniformly
+	int lifetimes = (int)WorkloadLifetimes::Exponential;
+	int lifetimeMean = 1000;
+	int rate = 10000;					// Allocations per second
+
+	Workload::Random random;
+	double pending = 0.0;				// Fractional allocations carried to the next frame
+	uint64 tick = 0;
+	uint64 failed = 0;
+	std::priority_queue<WorkloadExpiry, std::vector<WorkloadExpiry>, std::greater<>> expiries;
+
+	// Operations (allocate + free) per second, measured over one second windows
+	uint64 windowOperations = 0;
+	double windowTime = 0.0;
+	float operationsPerSecond = 0.0f;
+
+	// One sample per running frame
+	float fragmentationHistory[historySize] = {};
+	float usedHistory[historySize] = {};
+	float operationsHistory[historySize] = {};
+	int historyOffset = 0;
+};
+
+static WorkloadState workload;
+
+float WorkloadUniform()
+{
+	// (0, 1]
+	return ((workload.random.next() >> 8) + 1) * (1.0f / 16777216.0f);
+}
+
+uint32 WorkloadSize()
+{
+	Workload::Random& random = workload.random;
+	switch ((WorkloadSizes)workload.sizes)
+	{
+		case WorkloadSizes::Uniform:
+		{
+			uint32 low = (uint32)std::max(1, std::min(workload.uniformRange[0], workload.uniformRange[1]));
+			uint32 high = (uint32)std::max(1, std::max(workload.uniformRange[0], workload.uniformRange[1]));
+			return low + random.next() % (high - low + 1);
+		}
+		case WorkloadSizes::LogNormal:
+		{
+			// Box-Muller
+			float normal = sqrtf(-2.0f * logf(WorkloadUniform())) * cosf(6.2831853f * WorkloadUniform());
+			return (uint32)std::clamp(workload.logNormalMedian * expf(workload.logNormalSigma * normal), 1.0f, 4294967040.0f);
+		}
+		case WorkloadSizes::Pow2:
+		{
+			int low = std::min(workload.pow2Range[0], workload.pow2Range[1]);
+			int high = std::max(workload.pow2Range[0], workload.pow2Range[1]);
+			return 1u << (low + random.next() % (high - low + 1));
+		}
+		case WorkloadSizes::Histogram:
+			return workload.histogram.empty() ? 1 : workload.histogram[random.next() % workload.histogram.size()];
+	}
+	return 1;
+}
+
+// Ticks, ~0 = never freed
+uint64 WorkloadLifetime()
+{
+	uint64 mean = (uint64)std::max(workload.lifetimeMean, 1);
+	switch ((WorkloadLifetimes)workload.lifetimes)
+	{
+		case WorkloadLifetimes::Fixed: return mean;
+		case WorkloadLifetimes::Uniform: return workload.random.next() % (2 * mean + 1);
+		case WorkloadLifetimes::Exponential: return (uint64)(-(float)mean * logf(WorkloadUniform()));
+		default: return ~0ull;
+	}
+}
+
+// Requested sizes of the recorded trace (freed allocations included)
+void CaptureWorkloadHistogram()
+{
+	workload.histogram.clear();
+	for (const TraceRecord& record : recordedTrace)
+	{
+		if ((record.op == TraceOp::Allocate || record.op == TraceOp::AllocateHigh) && record.size != 0)
+			workload.histogram.push_back((uint32)record.size);
+	}
+}
+
+// One tick per allocation: Frees the expired workload allocations first
+uint64 StepWorkload(uint32 allocationCount)
+{
+	uint64 operations = 0;
+	for (uint32 i = 0; i < allocationCount; i++)
+	{
+		workload.tick++;
+		while (!workload.expiries.empty() && workload.expiries.top().tick <= workload.tick)
+		{
+			// Skips allocations freed (and node indices reused) from elsewhere in the explorer
+			WorkloadExpiry expiry = workload.expiries.top();
+			workload.expiries.pop();
+			const Allocation* allocation = allocations.Find(expiry.node);
+			if (allocation && allocations.Serial(expiry.node) == expiry.serial)
+			{
+				auto start = std::chrono::steady_clock::now();
+				allocator->free(*allocation);
+				freeLatency.Add(std::chrono::steady_clock::now() - start);
+				allocations.Remove(expiry.node);
+				operations++;
+				AllocatorChanged();
+			}
+		}
+
+		uint32 size = WorkloadSize();
+		auto start = std::chrono::steady_clock::now();
+		Allocation allocation = allocator->allocate(size);
+		allocateLatency.Add(std::chrono::steady_clock::now() - start);
+		operations++;
+		AllocatorChanged();
+		if (allocation.offset == Allocation::NO_SPACE)
+		{
+			workload.failed++;
+			continue;
+		}
+
+		uint64 serial = allocations.Add(allocation);
+		uint64 lifetime = WorkloadLifetime();
+		if (lifetime != ~0ull)
+			workload.expiries.push({.tick = workload.tick + lifetime, .node = allocation.metadata, .serial = serial});
+	}
+	return operations;
+}
+
+void RunWorkload(float deltaTime)
+{
+	if (!allocator || !workload.running)
+		return;
+
+	// At most 100ms behind: A slow frame doesn't snowball
+	workload.pending = std::min(workload.pending + workload.rate * (double)deltaTime, std::max(workload.rate * 0.1, 1.0));
+	uint32 count = (uint32)workload.pending;
+	workload.pending -= count;
+	workload.windowOperations += StepWorkload(count);
+
+	workload.windowTime += deltaTime;
+	if (workload.windowTime >= 1.0)
+	{
+		workload.operationsPerSecond = (float)(workload.windowOperations / workload.windowTime);
+		workload.windowOperations = 0;
+		workload.windowTime = 0.0;
+	}
+
+	StorageReport report = allocator->storageReport();
+	int sample = workload.historyOffset;
+	workload.fragmentationHistory[sample] = report.fragmentation();
+	workload.usedHistory[sample] = 1.0f - (float)report.totalFreeSpace / (float)allocator->m_size;
+	workload.operationsHistory[sample] = workload.operationsPerSecond;
+	workload.historyOffset = (sample + 1) % WorkloadState::historySize;
+}
+
+void ShowWorkload()
+{
+	ImGui::Begin("Workload");
+	if (!allocator)
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Combo("Sizes", &workload.sizes, "Uniform\0Log-normal\0Power of two\0Captured histogram\0");
+	switch ((WorkloadSizes)workload.sizes)
+	{
+		case WorkloadSizes::Uniform:
+			ImGui::InputInt2("Min / max", workload.uniformRange);
+			break;
+		case WorkloadSizes::LogNormal:
+			ImGui::InputFloat("Median", &workload.logNormalMedian);
+			ImGui::InputFloat("Sigma", &workload.logNormalSigma);
+			workload.logNormalMedian = std::max(workload.logNormalMedian, 1.0f);
+			workload.logNormalSigma = std::clamp(workload.logNormalSigma, 0.0f, 8.0f);
+			break;
+		case WorkloadSizes::Pow2:
+			ImGui::SliderInt2("Exponents", workload.pow2Range, 0, 31);
+			break;
+		case WorkloadSizes::Histogram:
+			if (ImGui::Button("Capture From Trace"))
+				CaptureWorkloadHistogram();
+			ImGui::SameLine();
+			ImGui::Text("%zu sizes", workload.histogram.size());
+			break;
+	}
+
+	ImGui::Combo("Lifetimes", &workload.lifetimes, "Forever\0Fixed\0Uniform\0Exponential\0");
+	if ((WorkloadLifetimes)workload.lifetimes != WorkloadLifetimes::Forever)
+		ImGui::InputInt("Mean lifetime (allocations)", &workload.lifetimeMean);
+	ImGui::InputInt("Allocations / second", &workload.rate);
+	workload.rate = std::max(workload.rate, 0);
+
+	if (ImGui::Button(workload.running ? "Pause (W)" : "Run (W)") || IsPressed(ImGuiKey_W))
+	{
+		workload.running = !workload.running;
+		workload.pending = 0.0;
+		workload.windowOperations = 0;
+		workload.windowTime = 0.0;
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Step"))
+		StepWorkload(1);
+	ImGui::SameLine();
+	if (ImGui::Button("Reset Stats"))
+	{
+		workload.failed = 0;
+		workload.operationsPerSecond = 0.0f;
+		std::fill(std::begin(workload.fragmentationHistory), std::end(workload.fragmentationHistory), 0.0f);
+		std::fill(std::begin(workload.usedHistory), std::end(workload.usedHistory), 0.0f);
+		std::fill(std::begin(workload.operationsHistory), std::end(workload.operationsHistory), 0.0f);
+	}
+
+	StorageReport report = allocator->storageReport();
+	uint64 used = (uint64)(allocator->m_size - report.totalFreeSpace);
+	ImGui::Text("%.0f ops/s, %zu live, %llu failed allocations", workload.operationsPerSecond, allocations.items.size(), workload.failed);
+	ImGui::Text("Used %llu / %llu (%.1f%%), largest free %llu", used, (uint64)allocator->m_size, 100.0 * used / allocator->m_size, (uint64)report.largestFreeRegion);
+	ImGui::Text("Fragmentation %.1f%%", report.fragmentation() * 100.0f);
+
+	const int historySize = WorkloadState::historySize;
+	ImGui::PlotLines("Fragmentation", workload.fragmentationHistory, historySize, workload.historyOffset, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
+	ImGui::PlotLines("Used", workload.usedHistory, historySize, workload.historyOffset, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
+	ImGui::PlotLines("Ops/s", workload.operationsHistory, historySize, workload.historyOffset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+
+	ImGui::End();
+}
+
+// Heap texture (Visualization, Texture mode): The heap rasterized into one RGBA8 texel per bytesPerTexel bytes, drawn as
+// a single ImGui::Image. For GB heaps the per node rectangles are CPU bound. Each update diffs the model node chain
+// against the painted one in address order: Only the texels of changed ranges are repainted and uploaded.
+enum class HeapColoring { Occupancy, Bin, Age };
+
+struct PaintedNode
+{
+	uint64 offset;
+	uint64 size;
+	bool used;
+	uint64 serial;		// Allocation serial (age), ~0 = free or deferred
+};
+
+struct HeapTexture
+{
+	static constexpr uint64 maxTexels = 1024 * 1024;
+	static constexpr double ageRefreshSeconds = 1.0;
+
+	GLuint texture = 0;
+	uint32 width = 0;
+	uint32 height = 0;
+	uint64 heapSize = 0;
+	uint64 bytesPerTexel = 1;
+	int coloring = -1;
+	uint64 version = ~0ull;
+	uint64 ageEpoch = 0;			// Ages are counted in allocations before this serial: Refreshed once a second
+	double ageRefreshTime = 0.0;
+	std::vector<uint32> pixels;
+	std::vector<PaintedNode> painted;
+	std::vector<PaintedNode> current;
+	std::vector<std::pair<uint64, uint64>> dirty;	// Texel ranges, address order
+	uint64 paintedTexels = 0;		// Last update
+};
+
+static HeapTexture heapTexture;
+static bool visualizationTexture = false;
+static int heapColoring = (int)HeapColoring::Occupancy;
+
+PaintedNode PaintedOf(const NodeModel& node)
+{
+	const Allocation* allocation = node.used ? allocations.Find(node.index) : nullptr;
+	return {.offset = node.offset, .size = node.size, .used = node.used, .serial = allocation ? allocations.Serial(node.index) : ~0ull};
+}
+
+// Per channel, 8 bit fixed point t: Once per texel in full repaints
+ImU32 LerpColor(ImU32 from, ImU32 to, float t)
+{
+	int weight = (int)(t * 256.0f);
+	ImU32 color = IM_COL32_A_MASK;
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		int a = (from >> shift) & 0xff;
+		int b = (to >> shift) & 0xff;
+		color |= (ImU32)std::clamp(a + (((b - a) * weight) >> 8), 0, 255) << shift;
+	}
+	return color;
+}
+
+ImU32 BinColor(uint64 size)
+{
+	static ImU32 colors[NUM_LEAF_BINS] = {};
+	uint32 binIndex = SmallFloat::uintToFloatRoundDown((Offset)size);
+	if (colors[binIndex] == 0)
+	{
+		ImVec4 color(0, 0, 0, 1);
+		ImGui::ColorConvertHSVtoRGB(0.8f * binIndex / NUM_LEAF_BINS, 0.6f, 0.9f, color.x, color.y, color.z);
+		colors[binIndex] = ImGui::ColorConvertFloat4ToU32(color);
+	}
+	return colors[binIndex];
+}
+
+// Young allocations bright, old ones dark. Log scale over the allocations done before the epoch.
+ImU32 AgeColor(uint64 serial)
+{
+	static const ImU32 young = ImGui::ColorConvertFloat4ToU32(ImVec4(1.0f, 0.85f, 0.3f, 1.0f));
+	static const ImU32 old = ImGui::ColorConvertFloat4ToU32(ImVec4(0.1f, 0.2f, 0.55f, 1.0f));
+	uint64 age = serial < heapTexture.ageEpoch ? heapTexture.ageEpoch - serial : 0;
+	return LerpColor(young, old, (float)std::bit_width(age) / (float)std::max(1, (int)std::bit_width(heapTexture.ageEpoch)));
+}
+
+// Texels [begin, end): Used fraction blends the free color (Occupancy) or the bin color of the largest free node (Bin)
+// with the allocated color (Occupancy, Bin) or the age color of the largest allocation (Age)
+void PaintHeapTexels(uint64 begin, uint64 end)
+{
+	struct Texel
+	{
+		uint64 usedBytes;
+		uint64 freeNodeBytes;
+		uint64 freeNodeSize;
+		uint64 usedNodeBytes;
+		uint64 usedNodeSerial;
+	};
+	static std::vector<Texel> texels;
+	texels.assign(end - begin, Texel{});
+
+	const uint64 bytesPerTexel = heapTexture.bytesPerTexel;
+	const uint64 byteBegin = begin * bytesPerTexel;
+	const uint64 byteEnd = std::min(end * bytesPerTexel, heapTexture.heapSize);
+	for (auto node = FindNode(byteBegin); node != model.nodes.end() && node->offset < byteEnd; ++node)
+	{
+		uint64 serial = PaintedOf(*node).serial;
+		uint64 nodeBegin = std::max(node->offset, byteBegin);
+		uint64 nodeEnd = std::min(node->offset + node->size, byteEnd);
+		for (uint64 texel = nodeBegin / bytesPerTexel; texel * bytesPerTexel < nodeEnd; texel++)
+		{
+			Texel& t = texels[texel - begin];
+			uint64 bytes = std::min(nodeEnd, (texel + 1) * bytesPerTexel) - std::max(nodeBegin, texel * bytesPerTexel);
+			if (node->used)
+			{
+				t.usedBytes += bytes;
+				if (bytes > t.usedNodeBytes)
+				{
+					t.usedNodeBytes = bytes;
+					t.usedNodeSerial = serial;
+				}
+			}
+			else if (bytes > t.freeNodeBytes)
+			{
+				t.freeNodeBytes = bytes;
+				t.freeNodeSize = node->size;
+			}
+		}
+	}
+
+	const HeapColoring coloring = (HeapColoring)heapTexture.coloring;
+	for (uint64 texel = begin; texel < end; texel++)
+	{
+		const Texel& t = texels[texel - begin];
+		uint64 bytes = texel * bytesPerTexel < heapTexture.heapSize ? std::min(bytesPerTexel, heapTexture.heapSize - texel * bytesPerTexel) : 0;
+		ImU32 color = IM_COL32(0, 0, 0, 255);	// Past the heap end
+		if (bytes > 0)
+		{
+			ImU32 freeColor = coloring == HeapColoring::Bin && t.freeNodeBytes ? BinColor(t.freeNodeSize) : deallocatedColor;
+			ImU32 usedColor = coloring == HeapColoring::Age && t.usedNodeBytes ? AgeColor(t.usedNodeSerial) : allocatedColor;
+			color = LerpColor(freeColor, usedColor, (float)t.usedBytes / (float)bytes);
+		}
+		heapTexture.pixels[texel] = color;
+	}
+}
+
+void MarkHeapTexels(uint64 byteBegin, uint64 byteEnd)
+{
+	uint64 begin = byteBegin / heapTexture.bytesPerTexel;
+	uint64 end = (byteEnd + heapTexture.bytesPerTexel - 1) / heapTexture.bytesPerTexel;
+	if (!heapTexture.dirty.empty() && heapTexture.dirty.back().second >= begin)
+		heapTexture.dirty.back().second = std::max(heapTexture.dirty.back().second, end);
+	else
+		heapTexture.dirty.push_back({begin, end});
+}
+
+void UpdateHeapTexture()
+{
+	UpdateModel();
+	HeapTexture& texture = heapTexture;
+	const uint64 heapSize = allocator->m_size;
+
+	// Layout: Square-ish, at most maxTexels texels
+	bool full = texture.texture == 0 || texture.heapSize != heapSize || texture.coloring != heapColoring;
+	if (texture.heapSize != heapSize)
+	{
+		texture.heapSize = heapSize;
+		texture.bytesPerTexel = std::bit_ceil((heapSize + HeapTexture::maxTexels - 1) / HeapTexture::maxTexels);
+		uint64 texels = (heapSize + texture.bytesPerTexel - 1) / texture.bytesPerTexel;
+		uint32 width = (uint32)std::min<uint64>(std::bit_ceil((uint64)ceil(sqrt((double)texels))), 1024);
+		uint32 height = (uint32)((texels + width - 1) / width);
+		if (width != texture.width || height != texture.height)
+		{
+			if (texture.texture)
+				glDeleteTextures(1, &texture.texture);
+			texture.texture = 0;
+			texture.width = width;
+			texture.height = height;
+		}
+	}
+	if (texture.texture == 0)
+	{
+		glGenTextures(1, &texture.texture);
+		glBindTexture(GL_TEXTURE_2D, texture.texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.width, texture.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	texture.coloring = heapColoring;
+
+	// Age: Every allocation gets older with each new one. Repainted in full at most once a refresh period.
+	double time = ImGui::GetTime();
+	if (heapColoring == (int)HeapColoring::Age && allocations.nextSerial != texture.ageEpoch && time - texture.ageRefreshTime >= HeapTexture::ageRefreshSeconds)
+	{
+		texture.ageEpoch = allocations.nextSerial;
+		texture.ageRefreshTime = time;
+		full = true;
+	}
+	if (!full && texture.version == model.version)
+		return;
+	texture.version = model.version;
+
+	texture.current.clear();
+	for (const NodeModel& node : model.nodes)
+		texture.current.push_back(PaintedOf(node));
+
+	// Changed ranges: Painted and current chain walked side by side, overlaps with a different node are dirty
+	texture.dirty.clear();
+	if (full)
+	{
+		texture.pixels.resize((size_t)texture.width * texture.height);
+		texture.dirty.push_back({0, (uint64)texture.width * texture.height});
+	}
+	else
+	{
+		// Segment color keys: Used, + free node bin (Bin) or allocation serial (Age). A boundary on one side only changes
+		// the node pieces of its texels.
+		auto key = [](const PaintedNode& node) {
+			if (heapColoring == (int)HeapColoring::Age)
+				return node.used ? node.serial : ~0ull;
+			if (heapColoring == (int)HeapColoring::Bin && !node.used)
+				return (uint64)SmallFloat::uintToFloatRoundDown((Offset)node.size);
+			return node.used ? ~1ull : ~0ull;
+		};
+		size_t i = 0;
+		size_t j = 0;
+		uint64 position = 0;
+		while (i < texture.painted.size() && j < texture.current.size())
+		{
+			const PaintedNode& before = texture.painted[i];
+			const PaintedNode& after = texture.current[j];
+			uint64 beforeEnd = before.offset + before.size;
+			uint64 afterEnd = after.offset + after.size;
+			uint64 end = std::min(beforeEnd, afterEnd);
+			if (key(before) != key(after))
+				MarkHeapTexels(position, end);
+			if (beforeEnd != afterEnd)
+				MarkHeapTexels(end - 1, end + 1);
+			position = end;
+			i += beforeEnd == end;
+			j += afterEnd == end;
+		}
+		if (i < texture.painted.size() || j < texture.current.size())
+			MarkHeapTexels(position, heapSize);
+	}
+	std::swap(texture.painted, texture.current);
+
+	// Repaint, then upload the touched rows (rows of neighboring ranges merged)
+	texture.paintedTexels = 0;
+	glBindTexture(GL_TEXTURE_2D, texture.texture);
+	uint32 rowBegin = 0;
+	uint32 rowEnd = 0;
+	auto upload = [&]() {
+		if (rowEnd > rowBegin)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rowBegin, texture.width, rowEnd - rowBegin, GL_RGBA, GL_UNSIGNED_BYTE, texture.pixels.data() + (size_t)rowBegin * texture.width);
+	};
+	for (const auto& [begin, end] : texture.dirty)
+	{
+		PaintHeapTexels(begin, end);
+		texture.paintedTexels += end - begin;
+		uint32 first = (uint32)(begin / texture.width);
+		uint32 last = (uint32)((end + texture.width - 1) / texture.width);
+		if (first > rowEnd)
+		{
+			upload();
+			rowBegin = first;
+		}
+		rowEnd = std::max(rowEnd, last);
+	}
+	upload();
+}
+
+void ShowHeapTexture()
+{
+	ImGui::SetNextItemWidth(200);
+	ImGui::Combo("Coloring", &heapColoring, "Occupancy\0Free node bin\0Allocation age\0");
+	UpdateHeapTexture();
+	const HeapTexture& texture = heapTexture;
+	ImGui::SameLine();
+	ImGui::Text("%llu bytes per texel, %u x %u texels, %llu repainted", texture.bytesPerTexel, texture.width, texture.height, texture.paintedTexels);
+
+	ImGui::BeginChild("Heap texture", ImVec2(0, -ImGui::GetFrameHeightWithSpacing()));
+	float texelPixels = std::max(ImGui::GetContentRegionAvail().x / texture.width, 1.0f);
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImGui::Image((ImTextureID)(intptr_t)texture.texture, ImVec2(texture.width * texelPixels, texture.height * texelPixels));
+	if (ImGui::IsItemHovered())
+	{
+		ImVec2 mouse = ImGui::GetIO().MousePos - origin;
+		uint64 texel = (uint64)(mouse.y / texelPixels) * texture.width + (uint64)(mouse.x / texelPixels);
+		uint64 byte = texel * texture.bytesPerTexel;
+		auto node = FindNode(byte);
+		if (byte < texture.heapSize && node != model.nodes.end())
+		{
+			ImGui::SetTooltip("Bytes %llu - %llu\nNode %u, offset: %llu, size: %llu, %s", byte, std::min(byte + texture.bytesPerTexel, texture.heapSize) - 1,
+				node->index, node->offset, node->size, node->used ? "used" : "free");
+		}
+	}
+	ImGui::EndChild();
+
+	switch ((HeapColoring)heapColoring)
+	{
+		case HeapColoring::Occupancy: ImGui::TextDisabled("Shade = used fraction of the texel"); break;
+		case HeapColoring::Bin: ImGui::TextDisabled("Free bytes colored by the bin of their free node (hue = bin index), used bytes blue"); break;
+		case HeapColoring::Age: ImGui::TextDisabled("Allocations colored by age (yellow = newest, dark blue = oldest), refreshed once a second"); break;
+	}
+}
+
+// Visualization zoom level. 0-2: 16, 8 or 4 pixels per byte, every node drawn. Above: 4 pixel cells of 2^(level - 2) bytes shaded by occupancy.
+static int visualizationZoom = 0;
+
+void ShowVisualization()
+{
+	ImGui::Begin("Visualization");
+	if (!allocator)
+	{
+		ImGui::End();
+		return;
+	}
+
+	const float rowHeight = 16;
+	const float availableWidth = ImGui::GetContentRegionAvail().x;
+	const uint64 heapSize = allocator->m_size;
+	UpdateModel();
+
+	ImGui::Checkbox("Texture", &visualizationTexture);
+	ImGui::SameLine();
+	if (visualizationTexture)
+	{
+		ShowHeapTexture();
+		ImGui::End();
+		return;
+	}
+
+	auto cellBytesOf = [](int level) { return level <= 2 ? 1ull : 1ull << (level - 2); };
+	auto cellPixelsOf = [](int level) { return level <= 2 ? (float)(16 >> level) : 4.0f; };
+	auto rowBytesOf = [&](int level) { return std::max(1ull, (uint64)(availableWidth / cellPixelsOf(level))) * cellBytesOf(level); };
+	auto rowCountOf = [&](int level) { return (heapSize + rowBytesOf(level) - 1) / rowBytesOf(level); };
+
+	// Scroll height stays below 2^22 pixels: ImGui scroll positions are floats
+	int minZoom = 0;
+	while ((float)rowCountOf(minZoom) * rowHeight > (float)(1 << 22))
+		minZoom++;
+	int maxZoom = minZoom;
+	while (rowCountOf(maxZoom) > 1)
+		maxZoom++;
+
+	ImGui::SetNextItemWidth(200);
+	ImGui::SliderInt("Zoom (Ctrl + Wheel)", &visualizationZoom, minZoom, maxZoom, "%d", ImGuiSliderFlags_AlwaysClamp);
+	visualizationZoom = std::clamp(visualizationZoom, minZoom, maxZoom);
+	ImGui::SameLine();
+	if (visualizationZoom <= 2)
+		ImGui::Text("%.0f pixels per byte", cellPixelsOf(visualizationZoom));
+	else
+		ImGui::Text("%llu bytes per cell", cellBytesOf(visualizationZoom));
+
+	const int zoom = visualizationZoom;
+	const uint64 cellBytes = cellBytesOf(zoom);
+	const float cellPixels = cellPixelsOf(zoom);
+	const uint64 cellsPerRow = rowBytesOf(zoom) / cellBytes;
+	const uint64 rowBytes = rowBytesOf(zoom);
+	const uint64 rowCount = rowCountOf(zoom);
+
+	// Zoom keeps the first visible byte in place
+	static int lastZoom = 0;
+	static uint64 firstVisibleByte = 0;
+	if (zoom != lastZoom)
+		ImGui::SetNextWindowScroll(ImVec2(-1.0f, (float)(firstVisibleByte / rowBytes) * rowHeight));
+	lastZoom = zoom;
+
+	const ImGuiIO& io = ImGui::GetIO();
+	ImGui::BeginChild("Heap", ImVec2(0, -ImGui::GetFrameHeightWithSpacing()), false, io.KeyCtrl ? ImGuiWindowFlags_NoScrollWithMouse : 0);
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+
+	// Visible rows only
+	uint64 firstRow = rowCount;
+	uint64 lastRow = 0;
+	ImGuiListClipper clipper;
+	clipper.Begin((int)rowCount, rowHeight);
+	while (clipper.Step())
+	{
+		firstRow = std::min(firstRow, (uint64)clipper.DisplayStart);
+		lastRow = std::max(lastRow, (uint64)clipper.DisplayEnd);
+	}
+	clipper.End();
+
+	if (ImGui::IsWindowHovered() && io.KeyCtrl && io.MouseWheel != 0.0f)
+		visualizationZoom += io.MouseWheel > 0.0f ? -1 : 1;
+
+	if (firstRow >= lastRow)
+	{
+		ImGui::EndChild();
+		ImGui::End();
+		return;
+	}
+	firstVisibleByte = firstRow * rowBytes;
+	const uint64 visibleBegin = firstRow * rowBytes;
+	const uint64 visibleEnd = std::min(lastRow * rowBytes, heapSize);
+
+	uint64 hoveredByte = ~0ull;
+	if (ImGui::IsWindowHovered())
+	{
+		ImVec2 mouse = io.MousePos - origin;
+		uint64 column = (uint64)std::max(0.0f, mouse.x / cellPixels);
+		uint64 row = (uint64)std::max(0.0f, mouse.y / rowHeight);
+		if (mouse.x >= 0.0f && mouse.y >= 0.0f && column < cellsPerRow && row * rowBytes + column * cellBytes < heapSize)
+			hoveredByte = row * rowBytes + column * cellBytes;
+	}
+
+	auto cellStart = [&](uint64 byte) {
+		return origin + ImVec2((float)((byte % rowBytes) / cellBytes) * cellPixels, (float)(byte / rowBytes) * rowHeight);
+	};
+
+	// Nodes clipped to the visible range, one rectangle per row (zoom 0-2)
+	auto drawNode = [&](uint64 begin, uint64 end, ImU32 color, ImU32 outlineColor)
+	{
+		begin = std::max(begin, visibleBegin);
+		end = std::min(end, visibleEnd);
+		while (begin < end)
+		{
+			uint64 rowEnd = std::min(end, (begin / rowBytes + 1) * rowBytes);
+			ImVec2 start = cellStart(begin);
+			ImVec2 stop = start + ImVec2((float)(rowEnd - begin) * cellPixels, rowHeight);
+			drawList->AddRectFilled(start, stop, outlineColor, 2.0f);
+			drawList->AddRectFilled(start + ImVec2(1, 1), stop - ImVec2(1, 1), color, 2.0f);
+			begin = rowEnd;
+		}
+	};
+
+	// Used bytes per visible cell (zoom > 2)
+	static std::vector<uint64> cellUsage;
+	if (zoom > 2)
+		cellUsage.assign((visibleEnd - visibleBegin + cellBytes - 1) / cellBytes, 0);
+
+	NodeModel hoveredNode = {};
+	if (hoveredByte != ~0ull)
+	{
+		auto node = FindNode(hoveredByte);
+		if (node != model.nodes.end() && node->offset <= hoveredByte)
+			hoveredNode = *node;
+	}
+
+	// Nodes are in address order: Only the visible ones are visited
+	for (auto node = FindNode(visibleBegin); node != model.nodes.end() && node->offset < visibleEnd; ++node)
+	{
+		uint64 begin = node->offset;
+		uint64 end = begin + node->size;
+		if (zoom <= 2)
+		{
+			ImU32 color = node->used ? allocatedColor : deallocatedColor;
+			if (node->used && hoveredNode.size != 0 && node->index == hoveredNode.index)
+				color = allocatedOutlineColor;
+			drawNode(begin, end, color, node->used ? allocatedOutlineColor : deallocatedOutlineColor);
+		}
+		else if (node->used)
+		{
+			begin = std::max(begin, visibleBegin) - visibleBegin;
+			end = std::min(end, visibleEnd) - visibleBegin;
+			for (uint64 cell = begin / cellBytes; cell * cellBytes < end; cell++)
+				cellUsage[cell] += std::min(end, (cell + 1) * cellBytes) - std::max(begin, cell * cellBytes);
+		}
+	}
+
+	// Cells: 8 occupancy shades (any use / any free visible), runs of equal shade merged into one rectangle per row
+	if (zoom > 2)
+	{
+		auto shadeColor = [&](uint32 shade) {
+			ImVec4 free = ImGui::ColorConvertU32ToFloat4(deallocatedColor);
+			ImVec4 used = ImGui::ColorConvertU32ToFloat4(allocatedColor);
+			float t = shade / 8.0f;
+			return ImGui::ColorConvertFloat4ToU32(ImVec4(free.x + (used.x - free.x) * t, free.y + (used.y - free.y) * t, free.z + (used.z - free.z) * t, 1.0f));
+		};
+		auto shadeOf = [&](uint64 cell) {
+			uint64 bytes = std::min(cellBytes, visibleEnd - visibleBegin - cell * cellBytes);
+			uint64 used = cellUsage[cell];
+			if (used == 0) return 0u;
+			if (used == bytes) return 8u;
+			return (uint32)std::clamp<uint64>(used * 8 / bytes, 1, 7);
+		};
+
+		for (uint64 runStart = 0; runStart < cellUsage.size();)
+		{
+			uint32 shade = shadeOf(runStart);
+			uint64 rowEnd = std::min<uint64>(cellUsage.size(), (runStart / cellsPerRow + 1) * cellsPerRow);
+			uint64 runEnd = runStart + 1;
+			while (runEnd < rowEnd && shadeOf(runEnd) == shade)
+				runEnd++;
+
+			ImVec2 start = cellStart(visibleBegin + runStart * cellBytes);
+			drawList->AddRectFilled(start, start + ImVec2((float)(runEnd - runStart) * cellPixels, rowHeight - 1), shadeColor(shade));
+			runStart = runEnd;
+		}
+
+		if (hoveredByte != ~0ull)
+		{
+			ImVec2 start = cellStart(hoveredByte);
+			drawList->AddRect(start, start + ImVec2(cellPixels, rowHeight - 1), allocatedOutlineColor);
+		}
+	}
+
+	if (hoveredNode.size != 0)
+	{
+		if (zoom > 2 && hoveredByte >= visibleBegin && hoveredByte < visibleEnd)
+		{
+			uint64 cell = (hoveredByte - visibleBegin) / cellBytes;
+			ImGui::SetTooltip("Cell %llu - %llu: %.1f%% used\nNode %u, offset: %llu, size: %llu, %s", hoveredByte, std::min(hoveredByte + cellBytes, heapSize) - 1,
+				100.0 * cellUsage[cell] / std::min(cellBytes, heapSize - hoveredByte), hoveredNode.index, hoveredNode.offset, hoveredNode.size, hoveredNode.used ? "used" : "free");
+		}
+		else
+		{
+			ImGui::SetTooltip("Offset: %llu, size: %llu", hoveredNode.offset, hoveredNode.size);
+		}
+
+		if (hoveredNode.used && allocations.Find(hoveredNode.index) && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+			Free(hoveredNode.index);
+	}
+
+	ImGui::EndChild();
+
+	// Legend
+	auto legend = [&](ImU32 color, ImU32 outlineColor, const char* label)
+	{
+		ImVec2 start = ImGui::GetCursorScreenPos();
+		ImGui::GetWindowDrawList()->AddRectFilled(start, start + ImVec2(rowHeight, rowHeight), outlineColor, 2.0f);
+		ImGui::GetWindowDrawList()->AddRectFilled(start + ImVec2(1, 1), start + ImVec2(rowHeight - 1, rowHeight - 1), color, 2.0f);
+		ImGui::Dummy(ImVec2(rowHeight, rowHeight));
+		ImGui::SameLine();
+		ImGui::Text("%s", label);
+	};
+	legend(deallocatedColor, deallocatedOutlineColor, "Free block");
+	ImGui::SameLine();
+	legend(allocatedColor, allocatedOutlineColor, zoom > 2 ? "Allocated block (shade = used fraction of the cell)" : "Allocated block");
+
+	ImGui::End();
+}
 
-bool IsPressed(int key)
-{
-	if (GetKeyState(key) & 0x80 && !ImGui::GetIO().WantCaptureKeyboard)
-	{
-		bool wasDownLastFrame = keyDownLastFrame.contains(key);
-		keyDownLastFrame.insert(key);
-		return !wasDownLastFrame;
-	}
+// Timeline window: Scrubs the allocator through the recorded steps, plays them back at a fixed rate
+static bool timelinePlaying = false;
+static int timelineRate = 30;			// Steps per second
+static double timelinePending = 0.0;
 
-	keyDownLastFrame.erase(key);
-	return false;
+std::string FormatChange(uint64 before, uint64 after)
+{
+	return before == after ? Format("%llu", before) : Format("%llu -> %llu", before, after);
 }
 
-void Allocate(uint32_t bytes)
+std::string FormatLinkChange(NodeIndex before, NodeIndex after)
 {
-	auto allocation = allocator->allocate(bytes);
-	if (allocation.offset != Allocation::NO_SPACE)
-		allocations.emplace_back(allocation);
+	auto link = [](NodeIndex node) { return node == Allocator::Node::unused ? std::string("-") : Format("%u", node); };
+	return before == after ? link(before) : link(before) + " -> " + link(after);
 }
 
-void Free(uint32_t offset)
+void ShowTimeline()
 {
-	auto iter = std::find_if(allocations.begin(), allocations.end(), [offset](const Allocation& allocation) {
-		return allocation.offset == offset; 
-	});
+	ImGui::Begin("Timeline");
+	if (!allocator || timeline.steps.empty())
+	{
+		ImGui::End();
+		return;
+	}
 
-	assert(iter != allocations.end());
+	const uint32 lastStep = (uint32)timeline.steps.size() - 1;
+	if (timelinePlaying)
+	{
+		timelinePending += timelineRate * (double)ImGui::GetIO().DeltaTime;
+		uint32 count = (uint32)timelinePending;
+		timelinePending -= count;
+		if (count > 0)
+			SeekTimeline(std::min(timeline.position + count, lastStep));
+		timelinePlaying = timeline.position < lastStep;
+	}
 
-	allocator->free(*iter);
-	allocations.erase(iter);
-}
+	int step = (int)timeline.position;
+	if (ImGui::SliderInt("Step", &step, 0, (int)lastStep, "%d", ImGuiSliderFlags_AlwaysClamp))
+		SeekTimeline((uint32)step);
+	if (ImGui::Button("Start"))
+		SeekTimeline(0);
+	ImGui::SameLine();
+	if ((ImGui::Button("< (Left)") || IsPressed(ImGuiKey_LeftArrow)) && timeline.position > 0)
+		SeekTimeline(timeline.position - 1);
+	ImGui::SameLine();
+	if ((ImGui::Button("> (Right)") || IsPressed(ImGuiKey_RightArrow)) && timeline.position < lastStep)
+		SeekTimeline(timeline.position + 1);
+	ImGui::SameLine();
+	if (ImGui::Button("End"))
+		SeekTimeline(lastStep);
+	ImGui::SameLine();
+	if (ImGui::Button(timelinePlaying ? "Pause" : "Play"))
+	{
+		timelinePlaying = !timelinePlaying;
+		timelinePending = 0.0;
+		if (timelinePlaying && timeline.position == lastStep)
+			SeekTimeline(0);
+	}
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(100);
+	ImGui::InputInt("Steps / second", &timelineRate);
+	timelineRate = std::max(timelineRate, 1);
+
+	ImGui::Text("%zu node, %zu bin, %zu freelist, %zu fence deltas: %.1f MB", timeline.nodeDeltas.size(), timeline.binDeltas.size(),
+		timeline.freeListDeltas.size(), timeline.fenceDeltas.size(), timeline.memoryUsed() / (1024.0 * 1024.0));
+	ImGui::Checkbox("Verify recorded steps", &timelineVerify);
+	if (timelineError)
+	{
+		ImGui::SameLine();
+		ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Delta missed a change: %s", timelineError);
+	}
+	ImGui::TextDisabled("An operation at an earlier step discards the later steps (and stops a trace replay). Stats aren't rewound.");
 
-bool CreateDeviceWGL(HWND hWnd, WGL_WindowData* data);
-void CleanupDeviceWGL(HWND hWnd, WGL_WindowData* data);
-LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	const Timeline::Step& current = timeline.steps[timeline.position];
+	const TraceRecord& record = current.record;
+	if (timeline.position == 0)
+	{
+		ImGui::Text("Step 0: Start (%s)", TraceOpName(record.op));
+		ImGui::End();
+		return;
+	}
+	ImGui::Text("Step %u: %s (offset %llu, size %llu, node %u)", timeline.position, TraceOpName(record.op), record.offset, record.size, record.metadata);
+	if (current.operations > 1)
+	{
+		ImGui::SameLine();
+		ImGui::Text("+ %u operations", current.operations - 1);
+	}
 
-void DrawAllocatorNode(ImVec2 pos, uint32_t nodeIndex, uint32_t offset, uint32_t size, ImU32 lineColor, ImU32 boxColor, ImU32 textColor, ImVec2 boxSize, float rounding, float lineThickness, float margin)
-{
-	float lineHeight = ImGui::GetTextLineHeight();
-	auto drawList = ImGui::GetWindowDrawList();
-	drawList->AddRectFilled(pos, pos + boxSize, boxColor, rounding);
-	drawList->AddRect(pos, pos + boxSize, lineColor, rounding, 0, lineThickness);
-	std::string label = std::format("{}", nodeIndex);
-	ImVec2 textSize = ImGui::CalcTextSize(label.c_str());
-	ImVec2 textPos = pos + ImVec2((boxSize.x - textSize.x) / 2.0f, 0);
-	drawList->AddText(textPos, textColor, label.c_str());
-	pos.y += lineHeight + 2;
-	drawList->AddLine(pos, pos + ImVec2(boxSize.x, 0), lineColor, lineThickness);
-	pos.y += lineThickness;
-	drawList->AddText(pos + ImVec2(margin, 0), textColor, std::format("O: {}", offset).c_str());
-	pos.y += lineHeight;
-	drawList->AddText(pos + ImVec2(margin, 0), textColor, std::format("S: {}", size).c_str());
+	// Deltas of the current step
+	const Timeline::Step& previous = timeline.steps[timeline.position - 1];
+	for (uint32 i = previous.binEnd; i < current.binEnd; i++)
+	{
+		const Timeline::BinDelta& delta = timeline.binDeltas[i];
+		bool usedBefore = delta.headBefore != Allocator::Node::unused;
+		bool usedAfter = delta.headAfter != Allocator::Node::unused;
+		ImGui::Text("Bin %u (%llu): head %s, count %s%s", delta.binIndex, (uint64)SmallFloat::floatToUint(delta.binIndex), FormatLinkChange(delta.headBefore, delta.headAfter).c_str(),
+			FormatChange(delta.countBefore, delta.countAfter).c_str(), usedBefore == usedAfter ? "" : usedAfter ? ", mask bit set" : ", mask bit cleared");
+	}
+	if (current.freeListEnd > previous.freeListEnd)
+		ImGui::Text("Freelist: %u entries, top %s", current.freeListEnd - previous.freeListEnd, FormatChange(previous.header.freeOffset, current.header.freeOffset).c_str());
+
+	if (ImGui::BeginTable("Node deltas", 8, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+	{
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Node");
+		ImGui::TableSetupColumn("Offset");
+		ImGui::TableSetupColumn("Size");
+		ImGui::TableSetupColumn("Used");
+		ImGui::TableSetupColumn("Previous bin");
+		ImGui::TableSetupColumn("Next bin");
+		ImGui::TableSetupColumn("Previous neighbor");
+		ImGui::TableSetupColumn("Next neighbor");
+		ImGui::TableHeadersRow();
+
+		ImGuiListClipper clipper;
+		clipper.Begin((int)(current.nodeEnd - previous.nodeEnd));
+		while (clipper.Step())
+		{
+			for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+			{
+				const Timeline::NodeDelta& delta = timeline.nodeDeltas[previous.nodeEnd + row];
+				const Allocator::Node& before = delta.before;
+				const Allocator::Node& after = delta.after;
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", delta.index);
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(FormatChange(before.dataOffset, after.dataOffset).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(FormatChange(before.dataSize, after.dataSize).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(before.used == after.used ? (after.used ? "yes" : "no") : (after.used ? "no -> yes" : "yes -> no"));
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(FormatLinkChange(before.binListPrev, after.binListPrev).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(FormatLinkChange(before.binListNext, after.binListNext).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(FormatLinkChange(before.neighborPrev, after.neighborPrev).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(FormatLinkChange(before.neighborNext, after.neighborNext).c_str());
+			}
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
 }
 
 void ShowAllocatorExplorer()
 {
+	RunWorkload(ImGui::GetIO().DeltaTime);
+
 	ImGui::Begin("Offset Allocator Explorer");
 
 	if (allocator)
@@ -130,218 +1502,215 @@ void ShowAllocatorExplorer()
 		ImGui::InputInt("Size", &allocationSize);
 		ImGui::SameLine();
 
-		if (ImGui::Button("Allocate (A)") || IsPressed('A'))
+		if (ImGui::Button("Allocate (A)") || IsPressed(ImGuiKey_A))
 		{
 			Allocate(allocationSize);
 		}
-		
-		ImGui::NewLine();
-		if (ImGui::Button("Clear Allocations (C)") || IsPressed('C'))
+		ImGui::SameLine();
+		if (ImGui::Button("Allocate High (H)") || IsPressed(ImGuiKey_H))
 		{
-			allocations.clear();
-			allocator->reset();
+			Allocate(allocationSize, true);
 		}
+
+		static int allocationCount = 1000;
+		ImGui::InputInt("Count", &allocationCount);
 		ImGui::SameLine();
-		if (ImGui::Button("Destroy Allocator (D)") || IsPressed('D'))
+		if (ImGui::Button("Allocate Count"))
 		{
-			allocations.clear();
-			allocator.reset();
+			for (int i = 0; i < allocationCount; i++)
+				Allocate(allocationSize);
 		}
-	}
-	else
-	{
-		ImGui::InputInt("Size", &allocatorSize);
-		ImGui::InputInt("Max Allocations", &maxAllocs);
 
-		if (ImGui::Button("New Allocator (N)") || IsPressed('N'))
+		static int freeStride = 2;
+		ImGui::InputInt("N", &freeStride);
+		freeStride = std::max(freeStride, 1);
+		ImGui::SameLine();
+		if (ImGui::Button("Free Every Nth"))
 		{
-			allocator = std::make_unique<Allocator>(allocatorSize, maxAllocs);
+			FreeEveryNth((uint32)freeStride);
 		}
-	}
-
-	ImGui::End();
 
-	ImGui::Begin("Visualization");
-	ImDrawList* draw_list = ImGui::GetWindowDrawList();
-	float bytesPerBlock = 1;
-	float pixelsPerBlock = 16;
-	float windowWidth = pixelsPerBlock * static_cast<int>(ImGui::GetContentRegionAvail().x / pixelsPerBlock);
-	float pixelsPerByte = (pixelsPerBlock / bytesPerBlock);
-	//   p        by         p*bl     p
-	// ----    / ---   =>   ------ = ---
-	//   bl       bl         bl*by    by
-	
-	const ImVec2 cursorScreenPos = ImGui::GetCursorScreenPos();
-	float windowEnd = cursorScreenPos.x + windowWidth;
-
-	auto drawAllocation = [=](ImVec2 cursor, uint32_t offset, uint32_t bytes, ImU32 color, ImU32 outlineColor, ImU32 hoverColor, bool used)
-	{
-		while (bytes > 0)
-		{
-			auto pixels = (uint32_t)pixelsPerByte * offset;
-			auto row = pixels / (uint32_t)windowWidth;
-			auto col = pixels % (uint32_t)windowWidth;
-			ImVec2 start = cursor + ImVec2((float)col, row * pixelsPerBlock);
-
-			auto bytesRoomLeft = static_cast<uint32_t>((windowEnd - start.x) / pixelsPerByte);
-			auto bytesToDraw = std::min(bytes, bytesRoomLeft);
-			ImVec2 end = start;
-			end.x += pixelsPerByte * bytesToDraw;
-
-			if (ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(start, end + ImVec2(0, pixelsPerBlock)))
-			{
-				color = hoverColor;
-				ImGui::SetTooltip("Offset: %d, size: %d", offset, bytes);
+		static uint64 freeRange[2] = {0, 0};
+		ImGui::InputScalarN("Range", ImGuiDataType_U64, freeRange, 2);
+		ImGui::SameLine();
+		if (ImGui::Button("Free Range"))
+		{
+			FreeRange(freeRange[0], freeRange[1]);
+		}
 
-				if (used && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
-					Free(offset);
-			}
+		static int resizeNode = 0;
+		static int resizeSize = 1;
+		static const char* resizeResult = "";
+		ImGui::InputInt("Resize Node", &resizeNode);
+		ImGui::InputInt("New Size", &resizeSize);
+		resizeSize = std::max(resizeSize, 0);
+		ImGui::SameLine();
+		if (ImGui::Button("Try Grow"))
+		{
+			resizeResult = Resize((NodeIndex)resizeNode, (uint32)resizeSize, true) ? "Grown in place" : "Failed: Not live, or the next node is used / too small";
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Shrink"))
+		{
+			resizeResult = Resize((NodeIndex)resizeNode, (uint32)resizeSize, false) ? "Shrunk in place" : "Failed: Not live, or out of nodes";
+		}
+		ImGui::SameLine();
+		ImGui::TextUnformatted(resizeResult);
+		ImGui::Text("%zu live allocations", allocations.items.size());
 
-			draw_list->AddRectFilled(start, end + ImVec2(0, pixelsPerBlock), outlineColor, 2.0f);
-			draw_list->AddRectFilled(start + ImVec2(1, 1), end + ImVec2(-1, -1) + ImVec2(0, pixelsPerBlock), color, 2.0f);
-			bytes -= bytesToDraw;
-			offset += bytesToDraw;
+		ImGui::NewLine();
+		static int growBytes = 1024;
+		static int growAllocs = 256 * 1024;
+		static const char* growResult = "";
+		ImGui::InputInt("Grow Bytes", &growBytes);
+		growBytes = std::max(growBytes, 0);
+		ImGui::SameLine();
+		if (ImGui::Button("Grow Storage"))
+		{
+			growResult = GrowStorage((uint32)growBytes) ? "Storage grown" : "Failed: Out of nodes, or size overflow";
+		}
+		ImGui::InputInt("Grow Max Allocations", &growAllocs);
+		growAllocs = std::max(growAllocs, 1);
+		ImGui::SameLine();
+		if (ImGui::Button("Grow Nodes"))
+		{
+			growResult = GrowNodes((uint32)growAllocs) ? "Nodes grown" : "Failed";
+		}
+		ImGui::TextUnformatted(growResult);
+		
+		ImGui::NewLine();
+		if (ImGui::Button("Clear Allocations (C)") || IsPressed(ImGuiKey_C))
+		{
+			allocations.Clear();
+			allocator->reset();
+			AllocatorChanged();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Defragment (F)") || IsPressed(ImGuiKey_F))
+		{
+			Relocation relocations[64];
+			while (uint32 count = allocator->defragment(relocations))
+				RemapAllocations(std::span(relocations, count));
+			AllocatorChanged();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Destroy Allocator (D)") || IsPressed(ImGuiKey_D))
+		{
+			DestroyAllocator();
 		}
-	};
 
-	const auto allocatedColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.2f, 0.4f, 0.8f, 1.0f));
-	const auto allocatedOutlineColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.4f, 0.6f, 1.0f, 1.0f));
-	const auto deallocatedColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.6f, 0.6f, 0.6f, 1.0f));
-	const auto deallocatedOutlineColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.9f, 0.9f, 0.9f, 1.0f));
+		ImGui::NewLine();
+		ImGui::InputText("Trace file", tracePath, sizeof(tracePath));
+		if (ImGui::Button("Save Trace"))
+		{
+			saveTrace(tracePath, recordedTrace);
+		}
+		ImGui::SameLine();
+		ImGui::Text("%zu records recorded, %llu dropped", recordedTrace.size(), traceRing->dropped());
 
-	if (allocator)
-	{
-		auto drawAllocationChain = [=](uint32_t nodeIndex)
+		if (traceReplayer)
 		{
-			uint32_t i = nodeIndex;
-			while (i != Allocator::Node::unused)
+			if (ImGui::Button("Step (S)") || IsPressed(ImGuiKey_S))
+				StepTrace(1);
+			ImGui::SameLine();
+			if (ImGui::Button("Step 100"))
+				StepTrace(100);
+			ImGui::SameLine();
+			if (ImGui::Button("Run To End"))
+				StepTrace(~0u);
+
+			ImGui::Text("Record %zu / %zu", traceReplayer->position(), loadedTrace.size());
+			if (traceReplayer->lastRecordCount() > 0)
 			{
-				auto& node = allocator->m_nodes[i];
-
-				auto color = node.used ? allocatedColor : deallocatedColor;
-				auto outlineColor = node.used ? allocatedOutlineColor : deallocatedOutlineColor;
-				auto hoverColor = node.used ? allocatedOutlineColor : deallocatedColor;
-
-				drawAllocation(cursorScreenPos, node.dataOffset, node.dataSize, color, outlineColor, hoverColor, node.used);
-
-				i = node.neighborPrev;
+				const TraceRecord& record = traceReplayer->lastRecords()[0];
+				ImGui::Text("Last: %s (offset %llu, size %llu, node %u)", TraceOpName(record.op), record.offset, record.size, record.metadata);
 			}
+			if (traceReplayer->diverged())
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Replay diverged from the trace");
+		}
+	}
+	else
+	{
+		ImGui::InputInt("Size", &allocatorSize);
+		ImGui::InputInt("Max Allocations", &maxAllocs);
 
-			i = allocator->m_nodes[nodeIndex].neighborNext;
-			while (i != Allocator::Node::unused)
-			{
-				auto& node = allocator->m_nodes[i];
-
-				auto color = node.used ? allocatedColor : deallocatedColor;
-				auto outlineColor = node.used ? allocatedOutlineColor : deallocatedOutlineColor;
-				auto hoverColor = node.used ? allocatedOutlineColor : deallocatedColor;
-
-				drawAllocation(cursorScreenPos, node.dataOffset, node.dataSize, color, outlineColor, hoverColor, node.used);
-
-				i = node.neighborNext;
-			}
-		};
+		if (ImGui::Button("New Allocator (N)") || IsPressed(ImGuiKey_N))
+		{
+			CreateAllocator(allocatorSize, maxAllocs);
+		}
 
-		for (int i = 0; i < 32; ++i)
+		ImGui::NewLine();
+		ImGui::InputText("Trace file", tracePath, sizeof(tracePath));
+		if (ImGui::Button("Load Trace (L)") || IsPressed(ImGuiKey_L))
 		{
-			if (allocator->m_usedBinsTop & (1 << i))
+			// Allocator geometry comes from the trace Begin record
+			if (loadTrace(tracePath, loadedTrace))
 			{
-				const auto leafBins = allocator->m_usedBins[i];
-				for (int j = 0; j < 32; ++j)
-				{
-					if (leafBins & (1 << j))
-					{
-						uint32 binIndex = (i << TOP_BINS_INDEX_SHIFT) | j;
-						uint32 nodeIndex = allocator->m_binIndices[binIndex];
-
-						if(nodeIndex != Allocator::Node::unused)
-							drawAllocationChain(nodeIndex);
-					}
-				}
+				traceReplayer = std::make_unique<TraceReplayer>(loadedTrace);
+				if (traceReplayer->maxAllocs() != 0)
+					CreateAllocator(traceReplayer->storageSize(), traceReplayer->maxAllocs());
+				else
+					traceReplayer.reset();
 			}
 		}
-
-		auto windowHeight = pixelsPerBlock * (pixelsPerByte * allocatorSize / windowWidth);
-
-		ImGui::Dummy(ImVec2(windowWidth, windowHeight));
-
-		ImGui::NewLine();
-		drawAllocation(ImGui::GetCursorScreenPos(), 0, 1, deallocatedColor, deallocatedOutlineColor, deallocatedColor, false);
-		ImGui::Dummy(ImVec2(pixelsPerBlock, pixelsPerBlock));
-		ImGui::SameLine();
-		ImGui::Text("Free block");
-		drawAllocation(ImGui::GetCursorScreenPos(), 0, 1, allocatedColor, allocatedOutlineColor, allocatedColor, false);
-		ImGui::Dummy(ImVec2(pixelsPerBlock, pixelsPerBlock));
-		ImGui::SameLine();
-		ImGui::Text("Allocated block");
 	}
 
 	ImGui::End();
 
+	ShowWorkload();
+	ShowVisualization();
+	ShowTimeline();
+
+	UpdateModel();
+
 	ImGui::Begin("Metadata");
 
 	if (allocator)
 	{
-		auto topLevelReport = allocator->storageReport();
-		ImGui::Text("Size: %d", allocator->m_size);
+		ImGui::Text("Size: %llu", (uint64)allocator->m_size);
 		ImGui::Text("Max allocs: %d", allocator->m_maxAllocs);
-		ImGui::Text("Total free space: %d", topLevelReport.totalFreeSpace);
-		ImGui::Text("Largest free region: %d", topLevelReport.largestFreeRegion);
+		ImGui::Text("Total free space: %llu", (uint64)model.report.totalFreeSpace);
+		ImGui::Text("Largest free region: %llu", (uint64)model.report.largestFreeRegion);
+		ImGui::Text("Fragmentation: %.1f%%", model.report.fragmentation() * 100.0f);
+		ImGui::Text("Nodes: %zu", model.nodes.size());
 		ImGui::NewLine();
 
-		std::set<NodeIndex> nodes;
-		std::function<void(NodeIndex)> visitForward = [&](NodeIndex nodeIndex)
+		if (ImGui::BeginTable("Nodes", 6, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
 		{
-			nodes.insert(nodeIndex);
-			const auto& node = allocator->m_nodes[nodeIndex];
-			if (node.neighborNext != Allocator::Node::unused)
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Node");
+			ImGui::TableSetupColumn("Offset");
+			ImGui::TableSetupColumn("Size");
+			ImGui::TableSetupColumn("Used");
+			ImGui::TableSetupColumn("Previous bin");
+			ImGui::TableSetupColumn("Next bin");
+			ImGui::TableHeadersRow();
+
+			ImGuiListClipper clipper;
+			clipper.Begin((int)model.nodes.size());
+			while (clipper.Step())
 			{
-				visitForward(node.neighborNext);
-			}
-		};
-
-		std::function<void(NodeIndex)> visitBackward = [&](NodeIndex nodeIndex)
-		{
-			nodes.insert(nodeIndex);
-			const auto& node = allocator->m_nodes[nodeIndex];
-			if (node.neighborPrev != Allocator::Node::unused)
-			{
-				visitBackward(node.neighborPrev);
-			}
-		};
-
-		for (int i = 0; i < 32; ++i)
-		{
-			if (allocator->m_usedBinsTop & (1 << i))
-			{
-				const auto leafBins = allocator->m_usedBins[i];
-				for (int j = 0; j < 32; ++j)
+				for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
 				{
-					if (leafBins & (1 << j))
-					{
-						uint32 binIndex = (i << TOP_BINS_INDEX_SHIFT) | j;
-						uint32 nodeIndex = allocator->m_binIndices[binIndex];
-						visitForward(nodeIndex);
-						visitBackward(nodeIndex);
-					}
+					const NodeModel& node = model.nodes[row];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::Text("%u", node.index);
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", node.offset);
+					ImGui::TableNextColumn();
+					ImGui::Text("%llu", node.size);
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(node.used ? "yes" : "no");
+					ImGui::TableNextColumn();
+					if (node.binListPrev != Allocator::Node::unused)
+						ImGui::Text("%u", node.binListPrev);
+					ImGui::TableNextColumn();
+					if (node.binListNext != Allocator::Node::unused)
+						ImGui::Text("%u", node.binListNext);
 				}
 			}
-		}
-
-		for (NodeIndex nodeIndex : nodes)
-		{
-			const auto& node = allocator->m_nodes[nodeIndex];
-			ImGui::SetNextItemOpen(true, ImGuiCond_Always);
-			if (ImGui::TreeNode((void*)(intptr_t)nodeIndex, "Node: %d", nodeIndex))
-			{
-				if (node.binListPrev != Allocator::Node::unused)
-					ImGui::Text("Previous bin: %d", node.binListPrev);
-
-				if (node.binListNext != Allocator::Node::unused)
-					ImGui::Text("Next bin: %d", node.binListNext);
-
-				ImGui::TreePop();
-			}
+			ImGui::EndTable();
 		}
 	}
 	ImGui::End();
@@ -356,42 +1725,34 @@ void ShowAllocatorExplorer()
 		float lineThickness = 2.0f;
 		float margin = 4.0f;
 		float rounding = 4.0f;
-		ImVec2 size(ImGui::CalcTextSize(std::format("O: {}", allocatorSize).c_str()).x + 2 * margin, 48);
+		ImVec2 size(ImGui::CalcTextSize(Format("O: %d", allocatorSize).c_str()).x + 2 * margin, 48);
 		ImVec2 cursorScreenPos = ImGui::GetCursorScreenPos();
-		ImVec2 pos = cursorScreenPos;
+		ImVec2 clipMin = ImGui::GetWindowDrawList()->GetClipRectMin();
+		ImVec2 clipMax = ImGui::GetWindowDrawList()->GetClipRectMax();
+		float stride = size.y + 10;
 		ImVec2 contentSize;
-		for (int i = 0; i < 32; ++i)
+
+		// One column per used bin, only the visible boxes are drawn
+		ImVec2 pos = cursorScreenPos;
+		for (const BinModel& bin : model.bins)
 		{
-			if (allocator->m_usedBinsTop & (1 << i))
+			float top = pos.y + ImGui::GetTextLineHeight();
+			if (pos.x + size.x >= clipMin.x && pos.x <= clipMax.x)
 			{
-				const auto leafBins = allocator->m_usedBins[i];
-				for (int j = 0; j < 32; ++j)
+				ImGui::GetWindowDrawList()->AddText(pos, textColor, Format("%llu (%u)", bin.binSize, bin.binIndex).c_str());
+				size_t first = (size_t)std::max(0.0f, (clipMin.y - top) / stride);
+				size_t last = std::min(bin.nodes.size(), (size_t)std::max(0.0f, (clipMax.y - top) / stride + 1));
+				for (size_t i = first; i < last; i++)
 				{
-					if (leafBins & (1 << j))
-					{
-						uint32 binIndex = (i << TOP_BINS_INDEX_SHIFT) | j;
-						uint32 binSize = OffsetAllocator::SmallFloat::floatToUint(binIndex);
-						
-						ImGui::GetWindowDrawList()->AddText(pos, textColor, std::format("{} ({})", binSize, binIndex).c_str());
-						pos.y += ImGui::GetTextLineHeight();
-						uint32 nodeIndex = allocator->m_binIndices[binIndex];
-						while (nodeIndex != Allocator::Node::unused)
-						{
-							const auto& node = allocator->m_nodes[nodeIndex];
-							auto color = node.used ? boxColorUsed : boxColorUnused;
-							DrawAllocatorNode(pos, nodeIndex, node.dataOffset, node.dataSize, lineColor, color, textColor, size, rounding, lineThickness, margin);
-							nodeIndex = node.neighborPrev;
-							pos.y += size.y + 10;
-						}
-
-						pos.x += size.x + 10;
-						contentSize.x += size.x + 10;
-						contentSize.y = std::max(contentSize.y, pos.y - cursorScreenPos.y);
-						pos.y = cursorScreenPos.y;
-					}
+					const NodeModel& node = model.nodes[bin.nodes[i]];
+					auto color = node.used ? boxColorUsed : boxColorUnused;
+					DrawAllocatorNode(ImVec2(pos.x, top + i * stride), node.index, (uint32_t)node.offset, (uint32_t)node.size, lineColor, color, textColor, size, rounding, lineThickness, margin);
 				}
-
 			}
+
+			pos.x += size.x + 10;
+			contentSize.x += size.x + 10;
+			contentSize.y = std::max(contentSize.y, top + bin.nodes.size() * stride - cursorScreenPos.y);
 		}
 		ImGui::Dummy(contentSize);
 	}
@@ -400,50 +1761,260 @@ void ShowAllocatorExplorer()
 	ImGui::Begin("Bitmasks");
 	if (allocator)
 	{
+		// Fill = heatmap of the selected counter (log scale), outline = mask bit set
+		static int heatmapMetric = 0;
+		ImGui::SetNextItemWidth(200);
+		ImGui::Combo("Heatmap", &heatmapMetric, "Allocations served\0Free node inserts\0Free list depth\0Peak free list depth\0");
+		ImGui::SameLine();
+		if (ImGui::Button("Reset Stats"))
+		{
+			allocator->resetStats();
+			allocateLatency = {};
+			freeLatency = {};
+			allocatorVersion++;
+		}
+
+		const AllocatorStats& stats = model.stats;
+		auto binMetric = [&](uint32 binIndex) -> uint64
+		{
+			switch (heatmapMetric)
+			{
+				case 1: return stats.binInserts[binIndex];
+				case 2: return model.binCounts[binIndex];
+				case 3: return stats.binPeakDepth[binIndex];
+				default: return stats.binAllocations[binIndex];
+			}
+		};
+		uint64 maxMetric = 1;
+		for (uint32 binIndex = 0; binIndex < NUM_LEAF_BINS; ++binIndex)
+			maxMetric = std::max(maxMetric, binMetric(binIndex));
+		auto heatColor = [&](uint64 value)
+		{
+			float t = logf(1.0f + (float)value) / logf(1.0f + (float)maxMetric);
+			return ImGui::ColorConvertFloat4ToU32(ImVec4(0.15f + 0.85f * t, 0.15f + 0.35f * (1.0f - t), 0.4f * (1.0f - t), 1.0f));
+		};
+
 		auto drawList = ImGui::GetWindowDrawList();
 		auto cursor = ImGui::GetCursorScreenPos();
 		auto pos = cursor;
 		ImU32 textColor = 0xFFFFFFFF;
 		ImU32 boxColor = ImGui::ColorConvertFloat4ToU32(ImVec4(0.4f, 0.6f, 1.0f, 1.0f));
 		ImVec2 boxSize(20, 20);
-		for (uint32_t i = 0; i < 32; ++i)
+		for (uint32_t i = 0; i < NUM_TOP_BINS; ++i)
 		{
-			bool isBitSet = (allocator->m_usedBinsTop & (1 << i));
+			bool isBitSet = (model.usedBinsTop & ((TopBinMask)1 << i));
 			if(isBitSet)
 				drawList->AddRect(pos, pos + boxSize, boxColor);
 
-			std::string label = std::format("{} ", i);
+			std::string label = Format("%u ", i);
 			ImVec2 textSize = ImGui::CalcTextSize(label.c_str());
 			ImVec2 finalPos = pos + 0.5f*(boxSize - textSize);
 			drawList->AddText(finalPos, textColor, label.c_str());
 
 			if (ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(pos, pos + boxSize))
-				ImGui::SetTooltip("%d bytes", (1 << i));
+				ImGui::SetTooltip("%llu bytes", (uint64)1 << i);
 
-			if (allocator->m_usedBins[i] != 0)
+			for (uint32 j = 0; j < BINS_PER_LEAF; ++j)
 			{
-				for (int j = 0; j < 8; ++j)
+				uint32 binIndex = (i << TOP_BINS_INDEX_SHIFT) | j;
+				finalPos.y += ImGui::GetTextLineHeight() + 5;
+				if (uint64 value = binMetric(binIndex))
+					drawList->AddRectFilled(finalPos, finalPos + boxSize, heatColor(value));
+				if (model.usedBins[i] & ((LeafBinMask)1 << j))
+					drawList->AddRect(finalPos, finalPos + boxSize, boxColor);
+
+				if (ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(finalPos, finalPos + boxSize))
 				{
-					finalPos.y += ImGui::GetTextLineHeight() + 5;
-					if (allocator->m_usedBins[i] & (1 << j))
-						drawList->AddRect(finalPos, finalPos + boxSize, boxColor);
-
-					if (ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(finalPos, finalPos + boxSize))
-						ImGui::SetTooltip("%d bytes", SmallFloat::floatToUint((i << TOP_BINS_INDEX_SHIFT) | j));
-
-					drawList->AddText(finalPos, textColor, std::format("{}", j).c_str());
+					ImGui::SetTooltip("%llu bytes (bin %u)\nAllocations served: %llu\nFree node inserts: %llu\nFree list depth: %u (peak %u)",
+						(uint64)SmallFloat::floatToUint(binIndex), binIndex, stats.binAllocations[binIndex], stats.binInserts[binIndex],
+						model.binCounts[binIndex], stats.binPeakDepth[binIndex]);
 				}
+
+				drawList->AddText(finalPos, textColor, Format("%u", j).c_str());
 			}
 
 			pos.x += boxSize.x + 10;
 			pos.y = cursor.y;
 		}
 
-		ImGui::Dummy(ImVec2(cursor.x - pos.x, cursor.y - pos.y));
+		ImGui::Dummy(ImVec2(pos.x - cursor.x, boxSize.y + BINS_PER_LEAF * (ImGui::GetTextLineHeight() + 5)));
+
+		uint64 searches = 0;
+		for (uint64 count : stats.binAllocations)
+			searches += count;
+		ImGui::Text("Allocations %llu (%llu failed), frees %llu, splits %llu, merges %llu", stats.allocations, stats.failedAllocations, stats.frees, stats.splits, stats.merges);
+		ImGui::Text("Top bin fallbacks %llu (%.1f%% of bin searches)", stats.topBinFallbacks, searches ? 100.0 * stats.topBinFallbacks / searches : 0.0);
+		ImGui::Text("Own bin hits %llu, bin cache hits %llu", stats.minBinHits, stats.binCacheHits);
+
+		// Bucket i = [2^(i-1), 2^i) ns, steady_clock overhead included
+		auto latencyHistogram = [](const char* label, const LatencyHistogram& histogram)
+		{
+			std::string overlay = Format("%llu samples, log2 ns buckets", histogram.samples);
+			ImGui::PlotHistogram(label, histogram.buckets, LatencyHistogram::bucketCount, 0, overlay.c_str(), 0.0f, FLT_MAX, ImVec2(0, 80));
+			if (ImGui::IsItemHovered() && histogram.samples)
+			{
+				int bucket = (int)std::clamp((ImGui::GetIO().MousePos.x - ImGui::GetItemRectMin().x) / ImGui::GetItemRectSize().x * LatencyHistogram::bucketCount, 0.0f, LatencyHistogram::bucketCount - 1.0f);
+				ImGui::SetTooltip("%llu - %llu ns: %.0f (%.1f%%)", bucket ? 1ull << (bucket - 1) : 0ull, (1ull << bucket) - 1, histogram.buckets[bucket], 100.0f * histogram.buckets[bucket] / histogram.samples);
+			}
+		};
+		latencyHistogram("Allocate latency", allocateLatency);
+		latencyHistogram("Free latency", freeLatency);
 	}
 	ImGui::End();
 }
 
+// Platform NewFrame calls come first
+void RenderFrame(int width, int height)
+{
+	ImGui::NewFrame();
+	ShowAllocatorExplorer();
+	ImGui::Render();
+
+	ImVec4 clearColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+	glViewport(0, 0, width, height);
+	glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+	glClear(GL_COLOR_BUFFER_BIT);
+	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
+
+#if defined(OFFSET_ALLOCATOR_EXPLORER_GLFW)
+
+static void GlfwErrorCallback(int error, const char* description)
+{
+	fprintf(stderr, "GLFW error %d: %s\n", error, description);
+}
+
+int main(int, char**)
+{
+	glfwSetErrorCallback(GlfwErrorCallback);
+	if (!glfwInit())
+		return 1;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+	GLFWwindow* window = glfwCreateWindow(1400, 800, "OffsetAllocator Explorer", NULL, NULL);
+	if (!window)
+	{
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(1);
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGui::StyleColorsDark();
+
+	ImGui_ImplGlfw_InitForOpenGL(window, true);
+	ImGui_ImplOpenGL3_Init("#version 130");
+
+	while (!glfwWindowShouldClose(window))
+	{
+		glfwPollEvents();
+		if (ImGui::IsKeyPressed(ImGuiKey_Escape, false))
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		RenderFrame(width, height);
+
+		glfwSwapBuffers(window);
+	}
+
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplGlfw_Shutdown();
+	ImGui::DestroyContext();
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	return 0;
+}
+
+#elif defined(OFFSET_ALLOCATOR_EXPLORER_SDL2)
+
+int main(int, char**)
+{
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0)
+	{
+		fprintf(stderr, "SDL error: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_Window* window = SDL_CreateWindow("OffsetAllocator Explorer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1400, 800,
+		(SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI));
+	if (!window)
+	{
+		fprintf(stderr, "SDL error: %s\n", SDL_GetError());
+		SDL_Quit();
+		return 1;
+	}
+	SDL_GLContext glContext = SDL_GL_CreateContext(window);
+	SDL_GL_MakeCurrent(window, glContext);
+	SDL_GL_SetSwapInterval(1);
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGui::StyleColorsDark();
+
+	ImGui_ImplSDL2_InitForOpenGL(window, glContext);
+	ImGui_ImplOpenGL3_Init("#version 130");
+
+	bool done = false;
+	while (!done)
+	{
+		SDL_Event event;
+		while (SDL_PollEvent(&event))
+		{
+			ImGui_ImplSDL2_ProcessEvent(&event);
+			if (event.type == SDL_QUIT)
+				done = true;
+			if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
+				done = true;
+		}
+		if (ImGui::IsKeyPressed(ImGuiKey_Escape, false))
+			done = true;
+
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplSDL2_NewFrame();
+
+		int width, height;
+		SDL_GL_GetDrawableSize(window, &width, &height);
+		RenderFrame(width, height);
+
+		SDL_GL_SwapWindow(window);
+	}
+
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplSDL2_Shutdown();
+	ImGui::DestroyContext();
+
+	SDL_GL_DeleteContext(glContext);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	return 0;
+}
+
+#else
+
+struct WGL_WindowData { HDC hDC; };
+
+static HGLRC g_hRC;
+static WGL_WindowData g_MainWindow;
+static int g_Width;
+static int g_Height;
+
+bool CreateDeviceWGL(HWND hWnd, WGL_WindowData* data);
+void CleanupDeviceWGL(HWND hWnd, WGL_WindowData* data);
+LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
 int main(int, char**)
 {
 	WNDCLASSEXW wc = {sizeof(wc), CS_OWNDC, WndProc, 0L, 0L, GetModuleHandle(NULL), NULL, NULL, NULL, NULL, L"ImGui Example", NULL};
@@ -469,8 +2040,6 @@ int main(int, char**)
 	ImGui_ImplWin32_InitForOpenGL(hwnd);
 	ImGui_ImplOpenGL3_Init();
 
-	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
-
 	bool done = false;
 	while (!done)
 	{
@@ -487,15 +2056,7 @@ int main(int, char**)
 
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplWin32_NewFrame();
-		ImGui::NewFrame();
-
-		ShowAllocatorExplorer();
-
-		ImGui::Render();
-		glViewport(0, 0, g_Width, g_Height);
-		glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
-		glClear(GL_COLOR_BUFFER_BIT);
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		RenderFrame(g_Width, g_Height);
 
 		::SwapBuffers(g_MainWindow.hDC);
 	}
@@ -573,3 +2134,5 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	}
 	return ::DefWindowProc(hWnd, msg, wParam, lParam);
 }
+
+#endif
@@ -0,0 +1,24 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/OffsetAllocator/offsetAllocator.cpp" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocator.cpp.o" "gcc" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocator.cpp.o.d"
+  "/root/repo/OffsetAllocator/offsetAllocatorConcurrent.cpp" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorConcurrent.cpp.o" "gcc" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorConcurrent.cpp.o.d"
+  "/root/repo/OffsetAllocator/offsetAllocatorPartitioned.cpp" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorPartitioned.cpp.o" "gcc" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorPartitioned.cpp.o.d"
+  "/root/repo/OffsetAllocator/offsetAllocatorPool.cpp" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorPool.cpp.o" "gcc" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorPool.cpp.o.d"
+  "/root/repo/OffsetAllocator/offsetAllocatorSlab.cpp" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorSlab.cpp.o" "gcc" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorSlab.cpp.o.d"
+  "/root/repo/OffsetAllocator/offsetAllocatorTrace.cpp" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorTrace.cpp.o" "gcc" "OffsetAllocator/CMakeFiles/offsetAllocator.dir/offsetAllocatorTrace.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
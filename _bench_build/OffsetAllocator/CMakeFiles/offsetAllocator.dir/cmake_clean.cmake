@@ -0,0 +1,21 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/offsetAllocator.dir/offsetAllocator.cpp.o"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocator.cpp.o.d"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorConcurrent.cpp.o"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorConcurrent.cpp.o.d"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorPartitioned.cpp.o"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorPartitioned.cpp.o.d"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorPool.cpp.o"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorPool.cpp.o.d"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorSlab.cpp.o"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorSlab.cpp.o.d"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorTrace.cpp.o"
+  "CMakeFiles/offsetAllocator.dir/offsetAllocatorTrace.cpp.o.d"
+  "liboffsetAllocator.a"
+  "liboffsetAllocator.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/offsetAllocator.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
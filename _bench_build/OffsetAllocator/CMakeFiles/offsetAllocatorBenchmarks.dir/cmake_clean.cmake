@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/offsetAllocatorBenchmarks.dir/offsetAllocatorBenchmarks.cpp.o"
+  "CMakeFiles/offsetAllocatorBenchmarks.dir/offsetAllocatorBenchmarks.cpp.o.d"
+  "offsetAllocatorBenchmarks"
+  "offsetAllocatorBenchmarks.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/offsetAllocatorBenchmarks.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
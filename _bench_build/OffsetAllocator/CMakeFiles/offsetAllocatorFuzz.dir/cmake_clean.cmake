@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/offsetAllocatorFuzz.dir/offsetAllocator.cpp.o"
+  "CMakeFiles/offsetAllocatorFuzz.dir/offsetAllocator.cpp.o.d"
+  "CMakeFiles/offsetAllocatorFuzz.dir/offsetAllocatorFuzz.cpp.o"
+  "CMakeFiles/offsetAllocatorFuzz.dir/offsetAllocatorFuzz.cpp.o.d"
+  "offsetAllocatorFuzz"
+  "offsetAllocatorFuzz.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/offsetAllocatorFuzz.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/offsetAllocatorStress.dir/offsetAllocatorStress.cpp.o"
+  "CMakeFiles/offsetAllocatorStress.dir/offsetAllocatorStress.cpp.o.d"
+  "offsetAllocatorStress"
+  "offsetAllocatorStress.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/offsetAllocatorStress.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
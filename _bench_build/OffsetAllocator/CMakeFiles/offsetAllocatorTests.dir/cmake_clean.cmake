@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/offsetAllocatorTests.dir/offsetAllocatorTests.cpp.o"
+  "CMakeFiles/offsetAllocatorTests.dir/offsetAllocatorTests.cpp.o.d"
+  "offsetAllocatorTests"
+  "offsetAllocatorTests.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/offsetAllocatorTests.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,10 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/OffsetAllocator
+# Build directory: /root/repo/_bench_build/OffsetAllocator
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(offsetAllocatorTests "/root/repo/_bench_build/OffsetAllocator/offsetAllocatorTests")
+set_tests_properties(offsetAllocatorTests PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/OffsetAllocator/CMakeLists.txt;57;add_test;/root/repo/OffsetAllocator/CMakeLists.txt;0;")
+add_test(offsetAllocatorFuzz "/root/repo/_bench_build/OffsetAllocator/offsetAllocatorFuzz" "--runs" "1000")
+set_tests_properties(offsetAllocatorFuzz PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/OffsetAllocator/CMakeLists.txt;73;add_test;/root/repo/OffsetAllocator/CMakeLists.txt;0;")